@@ -9,6 +9,9 @@ AC_ARG_ENABLE([$1],
    AC_HELP_STRING([--enable-$1], [$3 (default=$2)]),
    [enable_module=$enableval],
    [enable_module=$2])
+if test "x$enable_module" = "xyes" && test "x$enable_builtin_plugins" = "xyes" ; then
+	enable_module=static
+fi
 AC_MSG_RESULT($enable_module)
 
 AM_CONDITIONAL(ENABLE_[]UP[]_MODULE, test "x$enable_module" = "xyes")
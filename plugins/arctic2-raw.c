@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-event.h"
 
 struct arctic2_ts_event { /* Used in the IBM Arctic II */
 	signed short pressure;
@@ -13,51 +14,18 @@ struct arctic2_ts_event { /* Used in the IBM Arctic II */
 	int flags;
 };
 
-static int arctic2_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
-{
-	struct tsdev *ts = inf->dev;
-	struct arctic2_ts_event *arctic2_evt;
-	int ret;
-	int total = 0;
-	arctic2_evt = alloca(sizeof(*arctic2_evt) * nr);
-	ret = read(ts->fd, arctic2_evt, sizeof(*arctic2_evt) * nr);
-	if(ret > 0) {
-		int nr = ret / sizeof(*arctic2_evt);
-		while(ret >= (int)sizeof(*arctic2_evt)) {
-			samp->x = (short)arctic2_evt->x;
-			samp->y = (short)arctic2_evt->y;
-			samp->pressure = arctic2_evt->pressure;
-#ifdef DEBUG
-        fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
-#endif /*DEBUG*/
-			gettimeofday(&samp->tv,NULL);
-			samp++;
-			arctic2_evt++;
-			ret -= sizeof(*arctic2_evt);
-		}
-	} else {
-		return -1;
-	}
-
-	ret = nr;
-	return ret;
-}
-
-static const struct tslib_ops arctic2_ops =
-{
-	.read	= arctic2_read,
+/* coordinates are 16 bit signed; millisecs is not used */
+static const struct ts_event_layout arctic2_layout = {
+	.size		= sizeof(struct arctic2_ts_event),
+	.x		= TS_EVENT_FIELD_AS(struct arctic2_ts_event, x, 16, 1),
+	.y		= TS_EVENT_FIELD_AS(struct arctic2_ts_event, y, 16, 1),
+	.pressure	= TS_EVENT_FIELD(struct arctic2_ts_event, pressure),
+	.time_kind	= TS_EVENT_TIME_NOW,
 };
 
 TSAPI struct tslib_module_info *arctic2_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
-
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
-		return NULL;
-
-	m->ops = &arctic2_ops;
-	return m;
+	return ts_event_raw_init(dev, &arctic2_layout);
 }
 
 #ifndef TSLIB_STATIC_ARCTIC2_MODULE
@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-event.h"
 
 struct collie_ts_event { /* Used in the Sharp Zaurus SL-5000d and SL-5500 */
 	long y;
@@ -12,52 +13,18 @@ struct collie_ts_event { /* Used in the Sharp Zaurus SL-5000d and SL-5500 */
 	long long millisecs;
 };
 
-static int collie_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
-{
-	struct tsdev *ts = inf->dev;
-	struct collie_ts_event *collie_evt;
-	int ret;
-	int total = 0;
-	collie_evt = alloca(sizeof(*collie_evt) * nr);
-	ret = read(ts->fd, collie_evt, sizeof(*collie_evt) * nr);
-	if(ret > 0) {
-		int nr = ret / sizeof(*collie_evt);
-		while(ret >= (int)sizeof(*collie_evt)) {
-			samp->x = collie_evt->x;
-			samp->y = collie_evt->y;
-			samp->pressure = collie_evt->pressure;
-#ifdef DEBUG
-        fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
-#endif /*DEBUG*/
-			samp->tv.tv_usec = (collie_evt->millisecs % 1000) * 1000;
-			samp->tv.tv_sec = collie_evt->millisecs / 1000;
-			samp++;
-			collie_evt++;
-			ret -= sizeof(*collie_evt);
-		}
-	} else {
-		return -1;
-	}
-
-	ret = nr;
-	return ret;
-}
-
-static const struct tslib_ops collie_ops =
-{
-	.read	= collie_read,
+static const struct ts_event_layout collie_layout = {
+	.size		= sizeof(struct collie_ts_event),
+	.x		= TS_EVENT_FIELD(struct collie_ts_event, x),
+	.y		= TS_EVENT_FIELD(struct collie_ts_event, y),
+	.pressure	= TS_EVENT_FIELD(struct collie_ts_event, pressure),
+	.time_kind	= TS_EVENT_TIME_MS,
+	.time		= TS_EVENT_FIELD(struct collie_ts_event, millisecs),
 };
 
 TSAPI struct tslib_module_info *collie_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
-
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
-		return NULL;
-
-	m->ops = &collie_ops;
-	return m;
+	return ts_event_raw_init(dev, &collie_layout);
 }
 
 #ifndef TSLIB_STATIC_COLLIE_MODULE
@@ -28,6 +28,7 @@
 #include "config.h"
 #include "tslib-private.h"
 #include "tslib-filter.h"
+#include "tslib-frame.h"
 
 #define SCREEN_WIDTH   319
 #define SCREEN_HEIGHT  527
@@ -46,11 +47,13 @@
 #define DEFAULT_SENSOR_DELTA_Y (SCREEN_HEIGHT / (V_FIELDS - DEFAULT_GESTURE_HEIGHT))
 #define DEFAULT_SENSOR_OFFSET_X (DEFAULT_SENSOR_DELTA_X / 2)
 #define DEFAULT_SENSOR_OFFSET_Y (DEFAULT_SENSOR_DELTA_Y / 2)
+#define DEFAULT_BASELINE_DECAY 10
 
 #define MIN_VALUE 700
 #define MAX_VALUE 1500
-#define ASLEEP_SCANRATE 5
-#define DISCARD_FRAMES 5
+#define DISCARD_FRAMES 5		/* after a bad frame or waking up */
+
+#define N_FIELDS (H_FIELDS * V_FIELDS)
 
 #define field_nr(x, y) (y * H_FIELDS + (H_FIELDS - x) - 1)
 
@@ -72,8 +75,8 @@ struct cy8mrln_palmpre_input
 
 struct tslib_cy8mrln_palmpre 
 {
-	struct tslib_module_info	module;
-	uint16_t			references[H_FIELDS * V_FIELDS];
+	struct tslib_frame_module	frame;
+	struct cy8mrln_palmpre_input	input;		/* the last frame read */
 	int				scanrate;
 	int				verbose;
 	int				wot_threshold;
@@ -81,16 +84,14 @@ struct tslib_cy8mrln_palmpre
 	int				wot_scanrate;
 	int				timestamp_mode;
 	int				gesture_height;
-	int				noise;
 	int				pressure;
-	int				sensor_offset_x;
-	int				sensor_offset_y;
-	int				sensor_delta_x;
-	int				sensor_delta_y;
-	int				last_n_valid_samples;
-	struct ts_sample*		last_valid_samples;
+	/* the clock read the frame timestamps count from */
+	int				anchored;
+	int				anchor_rate;
+	unsigned long			anchor_frame;
+	unsigned long			last_frame;
+	struct timeval			anchor_tv;
 	int 			discard_frames;
-	int 			old_scanrate;
 };
 
 static int cy8mrln_palmpre_set_scanrate (struct tslib_cy8mrln_palmpre* info, int rate);
@@ -106,6 +107,7 @@ static int cy8mrln_palmpre_set_sensor_offset_x (struct tslib_cy8mrln_palmpre* in
 static int cy8mrln_palmpre_set_sensor_offset_y (struct tslib_cy8mrln_palmpre* info, int n);
 static int cy8mrln_palmpre_set_sensor_delta_x (struct tslib_cy8mrln_palmpre* info, int n);
 static int cy8mrln_palmpre_set_sensor_delta_y (struct tslib_cy8mrln_palmpre* info, int n);
+static int cy8mrln_palmpre_set_baseline_decay (struct tslib_cy8mrln_palmpre* info, int n);
 static int parse_scanrate (struct tslib_module_info *info, char *str, void *data);
 static int parse_verbose (struct tslib_module_info *info, char *str, void *data);
 static int parse_wot_scanrate (struct tslib_module_info *info, char *str, void *data);
@@ -119,18 +121,22 @@ static int parse_sensor_offset_x(struct tslib_module_info *info, char *str, void
 static int parse_sensor_offset_y(struct tslib_module_info *info, char *str, void *data);
 static int parse_sensor_delta_x(struct tslib_module_info *info, char *str, void *data);
 static int parse_sensor_delta_y(struct tslib_module_info *info, char *str, void *data);
-static int cy8mrln_palmpre_update_references (uint16_t references[H_FIELDS * V_FIELDS], uint16_t field[H_FIELDS * V_FIELDS]);
-static void cy8mrln_palmpre_interpolate (struct tslib_cy8mrln_palmpre* info, uint16_t field[H_FIELDS * V_FIELDS], int x, int y, struct ts_sample *out);
+static int parse_baseline_decay(struct tslib_module_info *info, char *str, void *data);
+static int cy8mrln_palmpre_read_frame (struct tslib_frame_module *fm, struct ts_frame *frame);
+static void cy8mrln_palmpre_bad_frame (struct tslib_frame_module *fm);
+static int cy8mrln_palmpre_keep_frame (struct tslib_frame_module *fm);
+static int cy8mrln_palmpre_set_rate (struct tslib_module_info *info, int hz);
+static int cy8mrln_palmpre_set_idle (struct tslib_module_info *info, int idle);
 static int cy8mrln_palmpre_fini (struct tslib_module_info *info);
-static int cy8mrln_palmpre_read (struct tslib_module_info *info, struct ts_sample *samp, int nr);
 TSAPI struct tslib_module_info *cy8mrln_palmpre_mod_init (struct tsdev *dev, const char *params);
 
 static int cy8mrln_palmpre_set_scanrate(struct tslib_cy8mrln_palmpre* info, int rate)
 {
-	if (info == NULL || info->module.dev == NULL || ioctl(info->module.dev->fd,CY8MRLN_IOCTL_SET_SCANRATE,&rate) < 0)
+	if (info == NULL || info->frame.module.dev == NULL || ioctl(info->frame.module.dev->fd,CY8MRLN_IOCTL_SET_SCANRATE,&rate) < 0)
 		goto error;
 		
 	info->scanrate = rate;
+	info->frame.period_ns = rate > 0 ? 1000000000UL / rate : 0;
 	return 0;
 	
 error:
@@ -140,7 +146,7 @@ error:
 
 static int cy8mrln_palmpre_set_verbose(struct tslib_cy8mrln_palmpre* info, int v)
 {
-	if (info == NULL || info->module.dev == NULL || ioctl(info->module.dev->fd,CY8MRLN_IOCTL_SET_VERBOSE_MODE,&v) < 0)
+	if (info == NULL || info->frame.module.dev == NULL || ioctl(info->frame.module.dev->fd,CY8MRLN_IOCTL_SET_VERBOSE_MODE,&v) < 0)
 		goto error;
 	
 	info->verbose = v;
@@ -153,7 +159,7 @@ error:
 
 static int cy8mrln_palmpre_set_sleepmode(struct tslib_cy8mrln_palmpre* info, int mode)
 {
-	if (info == NULL || info->module.dev == NULL || ioctl(info->module.dev->fd,CY8MRLN_IOCTL_SET_SLEEPMODE,&mode) < 0)
+	if (info == NULL || info->frame.module.dev == NULL || ioctl(info->frame.module.dev->fd,CY8MRLN_IOCTL_SET_SLEEPMODE,&mode) < 0)
 		goto error;
 
 	info->sleepmode = mode;
@@ -166,7 +172,7 @@ error:
 
 static int cy8mrln_palmpre_set_wot_scanrate(struct tslib_cy8mrln_palmpre* info, int rate)
 {
-	if (info == NULL || info->module.dev == NULL || ioctl(info->module.dev->fd,CY8MRLN_IOCTL_SET_WOT_SCANRATE,&rate) < 0)
+	if (info == NULL || info->frame.module.dev == NULL || ioctl(info->frame.module.dev->fd,CY8MRLN_IOCTL_SET_WOT_SCANRATE,&rate) < 0)
 		goto error;
 
 	info->wot_scanrate = rate;
@@ -179,11 +185,11 @@ error:
 
 static int cy8mrln_palmpre_set_wot_threshold(struct tslib_cy8mrln_palmpre* info, int v)
 {
-	if (info == NULL || info->module.dev == NULL) 
+	if (info == NULL || info->frame.module.dev == NULL) 
 		goto error;
 	if(v < WOT_THRESHOLD_MIN || v > WOT_THRESHOLD_MAX)
 		goto error;
-	if(ioctl(info->module.dev->fd,CY8MRLN_IOCTL_SET_WOT_THRESHOLD,&v) < 0)
+	if(ioctl(info->frame.module.dev->fd,CY8MRLN_IOCTL_SET_WOT_THRESHOLD,&v) < 0)
 		goto error;
 		
 	info->wot_threshold = v;
@@ -197,7 +203,7 @@ error:
 static int cy8mrln_palmpre_set_timestamp_mode(struct tslib_cy8mrln_palmpre* info, int v)
 {
 	v = v ? 1 : 0;
-	if(info == NULL || info->module.dev == NULL || ioctl(info->module.dev->fd,CY8MRLN_IOCTL_SET_TIMESTAMP_MODE,&v) < 0)
+	if(info == NULL || info->frame.module.dev == NULL || ioctl(info->frame.module.dev->fd,CY8MRLN_IOCTL_SET_TIMESTAMP_MODE,&v) < 0)
 	     goto error;
 	info->timestamp_mode = v;
 	return 0;
@@ -226,7 +232,7 @@ static int cy8mrln_palmpre_set_noise (struct tslib_cy8mrln_palmpre* info, int n)
 		return -1;
 	}
 
-	info->noise = n;
+	info->frame.proc.noise = n;
 
 	return 0;
 }
@@ -252,7 +258,7 @@ static int cy8mrln_palmpre_set_sensor_offset_x (struct tslib_cy8mrln_palmpre* in
 	printf("sensor_offset_x: %i\n", n);
 #endif
 	
-	info->sensor_offset_x = n;
+	info->frame.proc.offset_x = n;
 	return 0;
 }
 
@@ -265,7 +271,7 @@ static int cy8mrln_palmpre_set_sensor_offset_y (struct tslib_cy8mrln_palmpre* in
 	printf("sensor_offset_y: %i\n", n);
 #endif
 	
-	info->sensor_offset_y = n;
+	info->frame.proc.offset_y = n;
 	return 0;
 }
 
@@ -278,7 +284,7 @@ static int cy8mrln_palmpre_set_sensor_delta_x (struct tslib_cy8mrln_palmpre* inf
 	printf("sensor_delta_x: %i\n", n);
 #endif
 
-	info->sensor_delta_x = n;
+	info->frame.proc.pitch_x = n;
 	return 0;
 }
 
@@ -291,14 +297,23 @@ static int cy8mrln_palmpre_set_sensor_delta_y (struct tslib_cy8mrln_palmpre* inf
 	printf("sensor_delta_y: %i\n", n);
 #endif
 
-	info->sensor_delta_y = n;
+	info->frame.proc.pitch_y = n;
+	return 0;
+}
+
+static int cy8mrln_palmpre_set_baseline_decay (struct tslib_cy8mrln_palmpre* info, int n)
+{
+	if (info == NULL || n < 0 || n >= TS_FRAME_SHIFT)
+		return -1;
+
+	info->frame.proc.decay = n;
 	return 0;
 }
 
 static int parse_scanrate(struct tslib_module_info *info, char *str, void *data)
 {
 	(void)data;
-	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, module);
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 	unsigned long rate = strtoul(str, NULL, 0);
 
 	if(rate == ULONG_MAX && errno == ERANGE)
@@ -310,7 +325,7 @@ static int parse_scanrate(struct tslib_module_info *info, char *str, void *data)
 static int parse_verbose(struct tslib_module_info *info, char *str, void *data)
 {
 	(void)data;
-	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, module);
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 	unsigned long v = strtoul(str, NULL, 0);
 
 	if(v == ULONG_MAX && errno == ERANGE)
@@ -322,7 +337,7 @@ static int parse_verbose(struct tslib_module_info *info, char *str, void *data)
 static int parse_wot_scanrate(struct tslib_module_info *info, char *str, void *data)
 {
 	(void)data;
-	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, module);
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 	unsigned long rate = strtoul(str, NULL, 0);
 
 	return cy8mrln_palmpre_set_wot_scanrate(i, rate);
@@ -331,7 +346,7 @@ static int parse_wot_scanrate(struct tslib_module_info *info, char *str, void *d
 static int parse_wot_threshold(struct tslib_module_info *info, char *str, void *data)
 {
 	(void)data;
-	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, module);
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 	unsigned long threshold = strtoul(str, NULL, 0);
 
 	return cy8mrln_palmpre_set_wot_threshold(i, threshold);
@@ -340,7 +355,7 @@ static int parse_wot_threshold(struct tslib_module_info *info, char *str, void *
 static int parse_sleepmode(struct tslib_module_info *info, char *str, void *data)
 {
 	(void)data;
-	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, module);
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 	unsigned long sleep = strtoul(str, NULL, 0);
 
 	return cy8mrln_palmpre_set_sleepmode(i, sleep);
@@ -442,192 +457,125 @@ static int parse_sensor_delta_y(struct tslib_module_info *info, char *str, void
 	return cy8mrln_palmpre_set_sensor_delta_y (i, y);
 }
 
+static int parse_baseline_decay(struct tslib_module_info *info, char *str, void *data)
+{
+	(void)data;
+	struct tslib_cy8mrln_palmpre *i = (struct tslib_cy8mrln_palmpre*) info;
+	unsigned long n = strtoul (str, NULL, 0);
+
+	if(n == ULONG_MAX && errno == ERANGE)
+		return -1;
+
+	return cy8mrln_palmpre_set_baseline_decay (i, n);
+}
+
 #define NR_VARS (sizeof(cy8mrln_palmpre_vars) / sizeof(cy8mrln_palmpre_vars[0]))
 
 /*
-*     y1
-* x1 (xy) x3
-*     y3
-*/
-
-static void cy8mrln_palmpre_interpolate(struct tslib_cy8mrln_palmpre* info, uint16_t field[H_FIELDS * V_FIELDS], int x, int y, struct ts_sample *out)
+ * When the frame was scanned.  The sensor numbers its frames, seq_nr0
+ * counting them through [0:scanrate] and seq_nr2:seq_nr1 the wraps, so
+ * the time is that of one clock read plus a scan period for every frame
+ * since.  The clock is read again when the scan rate changed or frames
+ * went missing for a second or more, as they do while it sleeps.
+ */
+static void cy8mrln_palmpre_frame_time(struct tslib_cy8mrln_palmpre* info, const struct cy8mrln_palmpre_input *in, struct timeval *tv)
 {
-	float fx, fy;
-	int tmpxy, tmpx1, tmpx3, tmpy1, tmpy3;
-	int posx = info->sensor_delta_x * x + info->sensor_offset_x;
-	int posy = info->sensor_delta_y * y + info->sensor_offset_y;
-
-	tmpxy = field[field_nr(x, y)];
+	unsigned long frame;
+	unsigned long long usec;	/* a 32 bit long wraps in 72 minutes */
 
-	if (x == (H_FIELDS - 1)) {
-		tmpx3 = info->pressure - tmpxy;
-	} else {
-		tmpx3 = field[field_nr(x, y) - 1];
+	if (info->scanrate <= 0) {
+		gettimeofday(tv, NULL);
+		return;
 	}
-	if (x == 0)
-		tmpx1 = info->pressure - tmpxy;
-	else
-		tmpx1 = field[field_nr(x, y) + 1];
-
-	if (y == (V_FIELDS - 1)) {
-		tmpy3 = info->pressure - tmpxy;
-	} else {
-		tmpy3 = field[field_nr(x, y) + H_FIELDS];
+
+	frame = (((unsigned long)in->seq_nr2 << 8) | in->seq_nr1) * (info->scanrate + 1) + in->seq_nr0;
+	if (!info->anchored || info->anchor_rate != info->scanrate ||
+	    frame < info->last_frame || frame - info->last_frame > (unsigned long)info->scanrate) {
+		gettimeofday(&info->anchor_tv, NULL);
+		info->anchor_frame = frame;
+		info->anchor_rate = info->scanrate;
+		info->anchored = 1;
 	}
-	if (y == 0)
-		tmpy1 = info->pressure - tmpxy;
-	else
-		tmpy1 = field[field_nr(x, y) - H_FIELDS];
+	info->last_frame = frame;
 
-	fx = (float)(tmpx3 - tmpx1) / ((float)tmpxy * 1.5);
-	fy = (float)(tmpy3 - tmpy1) / ((float)tmpxy * 1.5);
+	usec = (unsigned long long)(frame - info->anchor_frame) * 1000000 / info->scanrate +
+	       info->anchor_tv.tv_usec;
+	tv->tv_sec = info->anchor_tv.tv_sec + usec / 1000000;
+	tv->tv_usec = usec % 1000000;
+}
 
-	out->x = posx + fx * info->sensor_delta_x;
-	out->y = posy + fy * info->sensor_delta_y;
+static int cy8mrln_palmpre_read_frame(struct tslib_frame_module *fm, struct ts_frame *frame)
+{
+	//We can only read one input struct at once
+	struct tslib_cy8mrln_palmpre *cy8mrln_info = container_of(fm, struct tslib_cy8mrln_palmpre, frame);
+	int ret;
 
-#ifdef DEBUG
-	fprintf (stderr, "fx: %f, fy: %f\n", fx, fy);
-#endif /*DEBUG*/
+	ret = read(fm->module.dev->fd, &cy8mrln_info->input, sizeof(cy8mrln_info->input));
+	if (ret <= 0)
+		return -1;
+
+	frame->cells = cy8mrln_info->input.field;
+	cy8mrln_palmpre_frame_time(cy8mrln_info, &cy8mrln_info->input, &frame->tv);
+	return 1;
 }
 
-static int cy8mrln_palmpre_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+static void cy8mrln_palmpre_bad_frame(struct tslib_frame_module *fm)
 {
-	struct tsdev *ts = info->dev;
-	//We can only read one input struct at once
-	struct cy8mrln_palmpre_input cy8mrln_evt;
-	struct tslib_cy8mrln_palmpre *cy8mrln_info;
-	int max_x = 0, max_y = 0, max_value = 0, x, y;
-	uint16_t tmp_value;
-	int ret, valid_samples = 0;
-	struct ts_sample *p = samp;
-	
-	/* initalize all samples with proper values */
-	memset(p, '\0', nr * sizeof (*p));
-	
-	cy8mrln_info = container_of(info, struct tslib_cy8mrln_palmpre, module);
-	
-	ret = read(ts->fd, &cy8mrln_evt, sizeof(cy8mrln_evt));
-	if (ret > 0) {
-		if (cy8mrln_palmpre_update_references (cy8mrln_info->references, cy8mrln_evt.field)) {
-			if (cy8mrln_info->discard_frames == 0) {
-				//backup current scanrate
-				cy8mrln_info->old_scanrate = cy8mrln_info->scanrate;
-				cy8mrln_palmpre_set_scanrate (cy8mrln_info, ASLEEP_SCANRATE);
-				cy8mrln_info->discard_frames = DISCARD_FRAMES;
-#ifdef DEBUG
-				fprintf (stderr, "go to sleep\n");
-#endif
-			}
+	struct tslib_cy8mrln_palmpre *cy8mrln_info = container_of(fm, struct tslib_cy8mrln_palmpre, frame);
 
-			return 0;
-		}
+	//let the sensor settle before trusting it again
+	if (cy8mrln_info->discard_frames == 0)
+		cy8mrln_info->discard_frames = DISCARD_FRAMES;
+}
 
-		//reset scanrate after waking up
-		if (cy8mrln_info->discard_frames == DISCARD_FRAMES) {
-			cy8mrln_palmpre_set_scanrate (cy8mrln_info, cy8mrln_info->old_scanrate);
+static int cy8mrln_palmpre_keep_frame(struct tslib_frame_module *fm)
+{
+	struct tslib_cy8mrln_palmpre *cy8mrln_info = container_of(fm, struct tslib_cy8mrln_palmpre, frame);
 #ifdef DEBUG
-			fprintf (stderr, "woke up\n");
+	int x;
 #endif
-		}
 
-		if (cy8mrln_info->discard_frames) {
+	if (cy8mrln_info->discard_frames) {
 #ifdef DEBUG
-			fprintf (stderr, "cy8mrln_palmpre: discarded frames %i\n", cy8mrln_info->discard_frames);
-			for (y = 0; y < V_FIELDS; y ++) {
-				for (x = 0; x < H_FIELDS; x++) {
-					fprintf (stderr, "%3i", cy8mrln_evt.field[field_nr(x, y)]);
-				}
+		fprintf (stderr, "cy8mrln_palmpre: discarded frames %i\n", cy8mrln_info->discard_frames);
+		for (x = 0; x < N_FIELDS; x++) {
+			fprintf (stderr, "%3i", fm->proc.delta[field_nr(x % H_FIELDS, x / H_FIELDS)]);
+			if (x % H_FIELDS == H_FIELDS - 1)
 				fprintf (stderr, "\n");
-			}
-#endif
-			cy8mrln_info->discard_frames --;
-			//discard frame
-			return 0;
-		}
-
-		max_x = 0;
-		max_y = 0;
-		max_value = 0;
-		for (y = 0; y < V_FIELDS; y ++) {
-			for (x = 0; x < H_FIELDS; x++) {
-				tmp_value = cy8mrln_evt.field[field_nr(x, y)];
-
-				/* check for the maximum value */
-				if (tmp_value > max_value) {
-					max_value = tmp_value;
-					max_x = x;
-					max_y = y;
-				}
-			}
 		}
-
-		/* only caluclate events that are not noise */
-		if (max_value > cy8mrln_info->noise) {
-			cy8mrln_palmpre_interpolate(cy8mrln_info, cy8mrln_evt.field, max_x, max_y, &samp[valid_samples]);
-			samp->pressure = max_value;
-			gettimeofday(&samp->tv,NULL);
-			valid_samples++;
-			if (cy8mrln_info->last_valid_samples == NULL) {
-				cy8mrln_info->last_valid_samples = malloc (sizeof (struct ts_sample) * valid_samples);
-			} else if (cy8mrln_info->last_n_valid_samples != valid_samples) {
-				cy8mrln_info->last_valid_samples = realloc (cy8mrln_info->last_valid_samples, sizeof (struct ts_sample) * valid_samples);
-			}
-			memcpy (cy8mrln_info->last_valid_samples, samp, sizeof (struct ts_sample) * valid_samples);
-			cy8mrln_info->last_n_valid_samples = valid_samples;
-		} else {
-			//return last samples with pressure = 0 to show a mouse up
-			if (cy8mrln_info->last_valid_samples != NULL) {
-				valid_samples = cy8mrln_info->last_n_valid_samples;
-				memcpy (samp, cy8mrln_info->last_valid_samples, sizeof (struct ts_sample) * valid_samples);
-				for (x = 0; x < valid_samples; x++) {
-					samp[x].pressure = 0;
-				}
-				cy8mrln_info->last_n_valid_samples = 0;
-				free (cy8mrln_info->last_valid_samples);
-				cy8mrln_info->last_valid_samples = NULL;
-#ifdef DEBUG
-				fprintf (stderr, "cy8mrln_palmpre: Returning %i old values with 0 pressure\n", valid_samples);
 #endif
-			}
-		}
-	} else {
-		return -1;
+		cy8mrln_info->discard_frames --;
+		//discard frame
+		return 0;
 	}
 
-	return valid_samples;
+	return 1;
 }
 
-static int cy8mrln_palmpre_update_references(uint16_t references[H_FIELDS * V_FIELDS], uint16_t field[H_FIELDS * V_FIELDS])
+static int cy8mrln_palmpre_set_rate(struct tslib_module_info *info, int hz)
 {
-	int x, y;
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 
-	for (y = 0; y < V_FIELDS; y ++) {
-		for (x = 0; x < H_FIELDS; x++) {
-			if (field[y * H_FIELDS + x] < MIN_VALUE || field[y * H_FIELDS + x] > MAX_VALUE) {
-#ifdef DEBUG
-				fprintf(stderr, "Discrading frame with %i at[%i/%i]\n", field[y * H_FIELDS + x], x, y);
-#endif
-				return 1;
-			}
-
-			if (field[y * H_FIELDS + x] > references[y * H_FIELDS + x]) {
-				references [y * H_FIELDS + x] = field [y * H_FIELDS + x];
-				field [y * H_FIELDS + x] = 0;
-			} else {
-				field [y * H_FIELDS + x] = references [y * H_FIELDS + x] - field [y * H_FIELDS + x];
-			}
-		}
-	}
+	if (hz == i->scanrate)
+		return 0;
+	return cy8mrln_palmpre_set_scanrate(i, hz);
+}
 
+/* Sleeps until the wake on touch threshold is crossed */
+static int cy8mrln_palmpre_set_idle(struct tslib_module_info *info, int idle)
+{
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
+
+	if (cy8mrln_palmpre_set_sleepmode(i, idle ? CY8MRLN_IDLE_STATE : CY8MRLN_ON_STATE))
+		return -1;
+	if (!idle)
+		i->discard_frames = DISCARD_FRAMES;
 	return 0;
 }
 
 static int cy8mrln_palmpre_fini(struct tslib_module_info *info)
 {
-	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, module);
-	if (i->last_valid_samples != NULL) {
-		free (i->last_valid_samples);
-	}
+	struct tslib_cy8mrln_palmpre *i = container_of(info, struct tslib_cy8mrln_palmpre, frame.module);
 	free (i);
 #ifdef DEBUG
 	fprintf (stderr, "finishing cy8mrln_palmpre");
@@ -650,28 +598,42 @@ static const struct tslib_vars cy8mrln_palmpre_vars[] =
 	{ "sensor_offset_y",		NULL, parse_sensor_offset_y},
 	{ "sensor_delta_x",		NULL, parse_sensor_delta_x},
 	{ "sensor_delta_y",		NULL, parse_sensor_delta_y},
+	{ "baseline_decay",		NULL, parse_baseline_decay},
+};
+
+static const struct tslib_frame_ops cy8mrln_palmpre_frame_ops =
+{
+	.read_frame = cy8mrln_palmpre_read_frame,
+	.bad_frame = cy8mrln_palmpre_bad_frame,
+	.keep_frame = cy8mrln_palmpre_keep_frame,
 };
 
 static const struct tslib_ops cy8mrln_palmpre_ops = 
 {
-	.read = cy8mrln_palmpre_read,
+	.read = ts_frame_read,
 	.fini = cy8mrln_palmpre_fini,
+	.set_rate = cy8mrln_palmpre_set_rate,
+	.set_idle = cy8mrln_palmpre_set_idle,
 };
 
 TSAPI struct tslib_module_info *cy8mrln_palmpre_mod_init(struct tsdev *dev, const char *params)
 {
 	struct tslib_cy8mrln_palmpre *info;
-	struct cy8mrln_palmpre_input input;
 	int ret = 0;
 	
 	info = malloc(sizeof(struct tslib_cy8mrln_palmpre));
 	if(info == NULL)
 	     return NULL;
-	info->module.ops = &cy8mrln_palmpre_ops;
+	memset(info, 0, sizeof(*info));
+	info->frame.module.ops = &cy8mrln_palmpre_ops;
         //required to set the default valuse
-        info->module.dev = dev;
-	info->last_valid_samples = NULL;
-	info->last_n_valid_samples = 0;
+        info->frame.module.dev = dev;
+	info->frame.frame_ops = &cy8mrln_palmpre_frame_ops;
+	info->frame.proc.width = H_FIELDS;
+	info->frame.proc.height = V_FIELDS;
+	info->frame.proc.mirror_x = 1;		/* see field_nr() */
+	info->frame.proc.min_value = MIN_VALUE;
+	info->frame.proc.max_value = MAX_VALUE;
 
 	cy8mrln_palmpre_set_verbose(info, DEFAULT_VERBOSE);
 	cy8mrln_palmpre_set_scanrate(info, DEFAULT_SCANRATE);
@@ -686,11 +648,12 @@ TSAPI struct tslib_module_info *cy8mrln_palmpre_mod_init(struct tsdev *dev, cons
 	cy8mrln_palmpre_set_sensor_offset_y (info, DEFAULT_SENSOR_OFFSET_Y);
 	cy8mrln_palmpre_set_sensor_delta_x (info, DEFAULT_SENSOR_DELTA_X);
 	cy8mrln_palmpre_set_sensor_delta_y (info, DEFAULT_SENSOR_DELTA_Y);
+	cy8mrln_palmpre_set_baseline_decay (info, DEFAULT_BASELINE_DECAY);
 
 	info->discard_frames = 0;
 
 
-	if (tslib_parse_vars(&info->module, cy8mrln_palmpre_vars, NR_VARS, params)) {
+	if (tslib_parse_vars(&info->frame.module, cy8mrln_palmpre_vars, NR_VARS, params)) {
 		free(info);
 		return NULL;
 	}
@@ -698,14 +661,14 @@ TSAPI struct tslib_module_info *cy8mrln_palmpre_mod_init(struct tsdev *dev, cons
 	/* We need the intial values the touchscreen repots with no touch input for
 	 * later use */
 	do {
-		ret = read(dev->fd, &input, sizeof(input));
+		ret = read(dev->fd, &info->input, sizeof(info->input));
 	}
 	while (ret <= 0);
-	memcpy(info->references, input.field, H_FIELDS * V_FIELDS * sizeof(uint16_t));
+	ts_frame_reset(&info->frame.proc, info->input.field);
 
-	return &(info->module);
+	return &(info->frame.module);
 }
-#ifndef TSLIB_STATIC_CY8MRLN_MODULE
+#ifndef TSLIB_STATIC_CY8MRLN_PALMPRE_MODULE
 	TSLIB_MODULE_INIT(cy8mrln_palmpre_mod_init);
 #endif
 
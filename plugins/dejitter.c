@@ -55,21 +55,18 @@ static const unsigned char weight [NR_SAMPHISTLEN - 1][NR_SAMPHISTLEN + 1] =
 	{ 6, 4, 3, 3, 4 },	/* When we have 4 samples ... */
 };
 
-struct ts_hist {
-	int x;
-	int y;
-	unsigned int p;
-};
-
+/*
+ * The history of each contact, by its id; contacts without one, as with
+ * ts_read(), all use the first.
+ */
 struct tslib_dejitter {
 	struct tslib_module_info module;
 	int delta;
-	int x;
-	int y;
-	int down;
-	int nr;
-	int head;
-	struct ts_hist hist[NR_SAMPHISTLEN];
+	int nr[TS_MAX_CONTACTS];
+	int head[TS_MAX_CONTACTS];
+	int x[TS_MAX_CONTACTS][NR_SAMPHISTLEN];
+	int y[TS_MAX_CONTACTS][NR_SAMPHISTLEN];
+	unsigned int p[TS_MAX_CONTACTS][NR_SAMPHISTLEN];
 };
 
 static int sqr (int x)
@@ -77,19 +74,19 @@ static int sqr (int x)
 	return x * x;
 }
 
-static void average (struct tslib_dejitter *djt, struct ts_sample *samp)
+static void average (struct tslib_dejitter *djt, int id, struct ts_sample *samp)
 {
 	const unsigned char *w;
-	int sn = djt->head;
+	int sn = djt->head [id];
 	int i, x = 0, y = 0;
 	unsigned int p = 0;
 
-        w = weight [djt->nr - 2];
+        w = weight [djt->nr [id] - 2];
 
-	for (i = 0; i < djt->nr; i++) {
-		x += djt->hist [sn].x * w [i];
-		y += djt->hist [sn].y * w [i];
-		p += djt->hist [sn].p * w [i];
+	for (i = 0; i < djt->nr [id]; i++) {
+		x += djt->x [id][sn] * w [i];
+		y += djt->y [id][sn] * w [i];
+		p += djt->p [id][sn] * w [i];
 		sn = (sn - 1) & (NR_SAMPHISTLEN - 1);
 	}
 
@@ -102,57 +99,68 @@ static void average (struct tslib_dejitter *djt, struct ts_sample *samp)
 #endif
 }
 
-static int dejitter_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+/* Smooths s, in place, with the history of contact id */
+static void dejitter_sample(struct tslib_dejitter *djt, int id, struct ts_sample *s)
 {
-        struct tslib_dejitter *djt = (struct tslib_dejitter *)info;
-	struct ts_sample *s;
-	int count = 0, ret;
-
-	ret = info->next->ops->read(info->next, samp, nr);
-	for (s = samp; ret > 0; s++, ret--) {
-		if (s->pressure == 0) {
-			/*
-			 * Pen was released. Reset the state and
-			 * forget all history events.
-			 */
-			djt->nr = 0;
-			samp [count++] = *s;
-                        continue;
-		}
+	if (s->pressure == 0) {
+		/*
+		 * Pen was released. Reset the state and
+		 * forget all history events.
+		 */
+		djt->nr [id] = 0;
+		return;
+	}
 
-                /* If the pen moves too fast, reset the backlog. */
-		if (djt->nr) {
-			int prev = (djt->head - 1) & (NR_SAMPHISTLEN - 1);
-			if (sqr (s->x - djt->hist [prev].x) +
-			    sqr (s->y - djt->hist [prev].y) > djt->delta) {
+        /* If the pen moves too fast, reset the backlog. */
+	if (djt->nr [id]) {
+		int prev = (djt->head [id] - 1) & (NR_SAMPHISTLEN - 1);
+		if (sqr (s->x - djt->x [id][prev]) +
+		    sqr (s->y - djt->y [id][prev]) > djt->delta) {
 #ifdef DEBUG
-				fprintf (stderr, "DEJITTER: pen movement exceeds threshold\n");
+			fprintf (stderr, "DEJITTER: pen movement exceeds threshold\n");
 #endif
-                                djt->nr = 0;
-			}
+                        djt->nr [id] = 0;
 		}
+	}
 
-		djt->hist[djt->head].x = s->x;
-		djt->hist[djt->head].y = s->y;
-		djt->hist[djt->head].p = s->pressure;
-		if (djt->nr < NR_SAMPHISTLEN)
-			djt->nr++;
+	djt->x [id][djt->head [id]] = s->x;
+	djt->y [id][djt->head [id]] = s->y;
+	djt->p [id][djt->head [id]] = s->pressure;
+	if (djt->nr [id] < NR_SAMPHISTLEN)
+		djt->nr [id]++;
 
-		/* We'll pass through the very first sample since
-		 * we can't average it (no history yet).
-		 */
-		if (djt->nr == 1)
-			samp [count] = *s;
-		else {
-			average (djt, samp + count);
-			samp [count].tv = s->tv;
-		}
-		count++;
+	/* We'll pass through the very first sample since
+	 * we can't average it (no history yet).
+	 */
+	if (djt->nr [id] > 1)
+		average (djt, id, s);
 
-		djt->head = (djt->head + 1) & (NR_SAMPHISTLEN - 1);
-	}
+	djt->head [id] = (djt->head [id] + 1) & (NR_SAMPHISTLEN - 1);
+}
+
+static int dejitter_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+{
+        struct tslib_dejitter *djt = (struct tslib_dejitter *)info;
+	int i, ret;
+
+	ret = info->next->ops->read(info->next, samp, nr);
+	for (i = 0; i < ret; i++)
+		dejitter_sample(djt, 0, samp + i);
+
+	return ret;
+}
+
+static int dejitter_read_mt(struct tslib_module_info *info, struct ts_contact *c, int nr)
+{
+        struct tslib_dejitter *djt = (struct tslib_dejitter *)info;
+	int i, ret;
+
+	ret = tslib_read_mt(info->next, c, nr);
+	for (i = 0; i < ret; i++)
+		dejitter_sample(djt, c[i].id >= 0 && c[i].id < TS_MAX_CONTACTS ?
+				c[i].id : 0, &c[i].samp);
 
-	return count;
+	return ret;
 }
 
 static int dejitter_fini(struct tslib_module_info *info)
@@ -163,8 +171,9 @@ static int dejitter_fini(struct tslib_module_info *info)
 
 static const struct tslib_ops dejitter_ops =
 {
-	.read	= dejitter_read,
-	.fini	= dejitter_fini,
+	.read		= dejitter_read,
+	.fini		= dejitter_fini,
+	.read_mt	= dejitter_read_mt,
 };
 
 static int dejitter_limit(struct tslib_module_info *inf, char *str, void *data)
@@ -209,7 +218,6 @@ TSAPI struct tslib_module_info *dejitter_mod_init(struct tsdev *dev, const char
 	djt->module.ops = &dejitter_ops;
 
 	djt->delta = 100;
-        djt->head = 0;
 
 	if (tslib_parse_vars(&djt->module, dejitter_vars, NR_VARS, params)) {
 		free(djt);
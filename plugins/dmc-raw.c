@@ -16,16 +16,28 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-serial.h"
+
+enum {
+	DMC_RELEASE,
+	DMC_TOUCH,
+};
+
+/* a release is one byte, a touch is followed by big endian x and y */
+static const struct ts_serial_packet dmc_packets[] = {
+	[DMC_RELEASE]	= { 0xff, 0x10, 1, 0 },
+	[DMC_TOUCH]	= { 0xff, 0x11, 5, 0 },
+};
 
 struct tslib_dmc {
 	struct tslib_module_info module;
 
 	int	current_x;
 	int	current_y;
-	int	sane_fd;
+	struct ts_serial serial;
 };
 
-int dmc_init_device(struct tsdev *dev)
+static int dmc_init_device(struct tsdev *dev)
 {
 	int fd = dev->fd;
 	struct termios t;
@@ -81,49 +93,54 @@ static int dmc_read(struct tslib_module_info *inf, struct ts_sample *samp, int n
 {
 	struct tslib_dmc *dmc = (struct tslib_dmc*)inf;
 	struct tsdev *ts = inf->dev;
-	uint8_t buf[5];
-	int ret;
-	int i;
-
-	for (i = 0; i < nr; ++i) {
-		if ((ret = read(ts->fd, buf, 1)) != 1) {
-			--i;
-			break;
+	const uint8_t *buf;
+	int type;
+	int i = 0;
+
+	while (i < nr) {
+		buf = ts_serial_next(&dmc->serial, &type);
+		if (!buf) {
+			/* only wait for bytes while there is nothing to return */
+			if (i)
+				break;
+			if (ts_serial_fill(&dmc->serial, ts->fd) <= 0)
+				return -1;
+			continue;
 		}
-		if (buf[0] == 0x10) {
+
+		if (type == DMC_RELEASE) {
 			/* release. No coords follow. Use old values */
 			samp->x = dmc->current_x;
 			samp->y = dmc->current_y;
 			samp->pressure = 0;
-		}
-		else if (buf[0] == 0x11) {
-			/* read coords */
-			if ((ret = read(ts->fd, buf, 4)) != 4) {
-				/* must have 4 bytes */
-				--i;
-				break;
-			}
-			samp->x = dmc->current_x = (int)((buf[0] << 8) + buf[1]);
-			samp->y = dmc->current_y = (int)((buf[2] << 8) + buf[3]);
+		} else {
+			samp->x = dmc->current_x = (int)((buf[1] << 8) + buf[2]);
+			samp->y = dmc->current_y = (int)((buf[3] << 8) + buf[4]);
 			samp->pressure = 100;
 		}
-		else
-			continue;
 #ifdef DEBUG
 		fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
 #endif /*DEBUG*/
 		gettimeofday(&samp->tv,NULL);
 		++samp;
+		++i;
 	}
 	return i;
 }
 
+static int dmc_fini(struct tslib_module_info *inf)
+{
+	free(inf);
+	return 0;
+}
+
 static const struct tslib_ops dmc_ops =
 {
 	.read	= dmc_read,
+	.fini	= dmc_fini,
 };
 
-TSAPI struct tslib_module_info *mod_init(struct tsdev *dev, const char *params)
+TSAPI struct tslib_module_info *dmc_mod_init(struct tsdev *dev, const char *params)
 {
 	struct tslib_dmc *m;
 
@@ -135,5 +152,10 @@ TSAPI struct tslib_module_info *mod_init(struct tsdev *dev, const char *params)
 		return NULL;
 
 	m->module.ops = &dmc_ops;
+	ts_serial_init(&m->serial, dmc_packets, 2);
 	return (struct tslib_module_info*)m;
 }
+
+#ifndef TSLIB_STATIC_DMC_MODULE
+	TSLIB_MODULE_INIT(dmc_mod_init);
+#endif
@@ -0,0 +1,355 @@
+/*
+ *  tslib/plugins/drift.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Follow slow calibration drift from everyday use.  Applications call
+ * ts_target_hint() with the position a press was meant for; the module
+ * fits an affine correction to those pairs with recursive least squares
+ * and applies it to every sample that passes through.  Load it after
+ * the calibration module.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "tslib.h"
+#include "tslib-filter.h"
+
+/* Positions are divided by this before they enter the regression */
+#define DRIFT_SCALE	1024.0
+
+struct tslib_drift {
+	struct tslib_module_info module;
+
+	/* correction in pixels: theta . [x / DRIFT_SCALE, y / DRIFT_SCALE, 1] */
+	double		theta_x[3];
+	double		theta_y[3];
+	double		p[3][3];	/* inverse information of the fit */
+
+	/* the same correction in 16.16, applied to the samples */
+	long long	kx[3];
+	long long	ky[3];
+
+	int		last_x;		/* last pressed sample, uncorrected */
+	int		last_y;
+	int		have_press;
+
+	double		forget;
+	double		weight;
+	int		gate;
+	int		save_every;
+	unsigned long	accepted;
+	unsigned long	rejected;
+	int		unsaved;
+	char		*file;
+};
+
+static void drift_load_k(struct tslib_drift *d)
+{
+	int k;
+
+	for (k = 0; k < 2; k++) {
+		d->kx[k] = llround(d->theta_x[k] * 65536 / DRIFT_SCALE);
+		d->ky[k] = llround(d->theta_y[k] * 65536 / DRIFT_SCALE);
+	}
+	d->kx[2] = llround(d->theta_x[2] * 65536);
+	d->ky[2] = llround(d->theta_y[2] * 65536);
+}
+
+static int
+drift_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+{
+	struct tslib_drift *d = (struct tslib_drift *)info;
+	int ret;
+
+	ret = info->next->ops->read(info->next, samp, nr);
+	if (ret >= 0) {
+		int nr;
+
+		for (nr = 0; nr < ret; nr++, samp++) {
+			long long x = samp->x;
+			long long y = samp->y;
+
+			if (samp->pressure) {
+				d->last_x = samp->x;
+				d->last_y = samp->y;
+				d->have_press = 1;
+			}
+			samp->x += (d->kx[0] * x + d->kx[1] * y + d->kx[2] +
+				    32768) >> 16;
+			samp->y += (d->ky[0] * x + d->ky[1] * y + d->ky[2] +
+				    32768) >> 16;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * The state is replaced with rename(), so that a crash while saving
+ * leaves the previous fit in place.
+ */
+static int drift_save(struct tslib_drift *d)
+{
+	char *tmp;
+	FILE *f;
+	int ret = 0;
+
+	tmp = malloc(strlen(d->file) + 5);
+	if (!tmp)
+		return -1;
+	sprintf(tmp, "%s.tmp", d->file);
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		free(tmp);
+		return -1;
+	}
+	fprintf(f, "# %lu hints accepted, %lu rejected\n",
+		d->accepted, d->rejected);
+	fprintf(f, "x %.17g %.17g %.17g\n",
+		d->theta_x[0], d->theta_x[1], d->theta_x[2]);
+	fprintf(f, "y %.17g %.17g %.17g\n",
+		d->theta_y[0], d->theta_y[1], d->theta_y[2]);
+	fprintf(f, "p %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g\n",
+		d->p[0][0], d->p[0][1], d->p[0][2],
+		d->p[1][0], d->p[1][1], d->p[1][2],
+		d->p[2][0], d->p[2][1], d->p[2][2]);
+	if (fclose(f) || rename(tmp, d->file)) {
+		unlink(tmp);
+		ret = -1;
+	}
+	free(tmp);
+
+	if (!ret)
+		d->unsaved = 0;
+	return ret;
+}
+
+static void drift_restore(struct tslib_drift *d)
+{
+	double theta_x[3], theta_y[3], p[9];
+	char line[512];
+	int have = 0;
+	FILE *f;
+
+	f = fopen(d->file, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "x %lf %lf %lf",
+			   &theta_x[0], &theta_x[1], &theta_x[2]) == 3)
+			have |= 1;
+		else if (sscanf(line, "y %lf %lf %lf",
+				&theta_y[0], &theta_y[1], &theta_y[2]) == 3)
+			have |= 2;
+		else if (sscanf(line, "p %lf %lf %lf %lf %lf %lf %lf %lf %lf",
+				&p[0], &p[1], &p[2], &p[3], &p[4], &p[5],
+				&p[6], &p[7], &p[8]) == 9)
+			have |= 4;
+	}
+	fclose(f);
+
+	if (have != 7) {
+		fprintf(stderr, "drift: ignoring %s\n", d->file);
+		return;
+	}
+	memcpy(d->theta_x, theta_x, sizeof(theta_x));
+	memcpy(d->theta_y, theta_y, sizeof(theta_y));
+	memcpy(d->p, p, sizeof(p));
+	drift_load_k(d);
+}
+
+/*
+ * One recursive least squares step for both axes, which share the
+ * regressor [x y 1] and so the matrix p.  Hints that disagree with the
+ * current fit by more than 'gate' pixels are taken to be misses.
+ */
+static int drift_hint(struct tslib_module_info *info, int x, int y)
+{
+	struct tslib_drift *d = (struct tslib_drift *)info;
+	double phi[3], pphi[3], k[3];
+	double denom, ex, ey;
+	int r, c;
+
+	if (!d->have_press)
+		return 0;
+	d->have_press = 0;
+
+	phi[0] = d->last_x / DRIFT_SCALE;
+	phi[1] = d->last_y / DRIFT_SCALE;
+	phi[2] = 1;
+
+	/* residuals of what the application saw, i.e. after correction */
+	ex = x - d->last_x;
+	ey = y - d->last_y;
+	for (c = 0; c < 3; c++) {
+		ex -= d->theta_x[c] * phi[c];
+		ey -= d->theta_y[c] * phi[c];
+	}
+	if (fabs(ex) > d->gate || fabs(ey) > d->gate) {
+		d->rejected++;
+		return 0;
+	}
+
+	denom = d->forget;
+	for (r = 0; r < 3; r++) {
+		pphi[r] = 0;
+		for (c = 0; c < 3; c++)
+			pphi[r] += d->p[r][c] * phi[c];
+		denom += phi[r] * pphi[r];
+	}
+	for (r = 0; r < 3; r++) {
+		k[r] = pphi[r] / denom;
+		d->theta_x[r] += k[r] * ex;
+		d->theta_y[r] += k[r] * ey;
+	}
+	/* p is symmetric, so phi' p = pphi' */
+	for (r = 0; r < 3; r++)
+		for (c = 0; c < 3; c++)
+			d->p[r][c] = (d->p[r][c] - k[r] * pphi[c]) / d->forget;
+
+	drift_load_k(d);
+	d->accepted++;
+
+#ifdef DEBUG
+	fprintf(stderr, "drift: press %d,%d target %d,%d -> x %g %g %g y %g %g %g\n",
+		d->last_x, d->last_y, x, y,
+		d->theta_x[0], d->theta_x[1], d->theta_x[2],
+		d->theta_y[0], d->theta_y[1], d->theta_y[2]);
+#endif
+	if (d->save_every && ++d->unsaved >= d->save_every)
+		return drift_save(d);
+	return 0;
+}
+
+static int drift_fini(struct tslib_module_info *info)
+{
+	struct tslib_drift *d = (struct tslib_drift *)info;
+
+	if (d->unsaved)
+		drift_save(d);
+	free(d->file);
+	free(d);
+	return 0;
+}
+
+static const struct tslib_ops drift_ops =
+{
+	.read	= drift_read,
+	.fini	= drift_fini,
+	.hint	= drift_hint,
+};
+
+static int drift_double(struct tslib_module_info *inf, char *str, void *data)
+{
+	double v;
+	char *end;
+
+	(void)inf;
+
+	if (!str)
+		return -1;
+	v = strtod(str, &end);
+	if (end == str || v <= 0)
+		return -1;
+	*(double *)data = v;
+	return 0;
+}
+
+static int drift_int(struct tslib_module_info *inf, char *str, void *data)
+{
+	unsigned long v;
+
+	(void)inf;
+
+	if (!str)
+		return -1;
+	v = strtoul(str, NULL, 0);
+	if (v == ULONG_MAX && errno == ERANGE)
+		return -1;
+	*(int *)data = v;
+	return 0;
+}
+
+static int drift_file(struct tslib_module_info *inf, char *str, void *data)
+{
+	struct tslib_drift *d = (struct tslib_drift *)inf;
+
+	(void)data;
+
+	if (!str)
+		return -1;
+	free(d->file);
+	d->file = strdup(str);
+	return d->file ? 0 : -1;
+}
+
+TSAPI struct tslib_module_info *drift_mod_init(struct tsdev *dev, const char *params)
+{
+	struct tslib_drift *d;
+	int k;
+
+	(void)dev;
+
+	d = malloc(sizeof(struct tslib_drift));
+	if (d == NULL)
+		return NULL;
+
+	memset(d, 0, sizeof(struct tslib_drift));
+	d->module.ops = &drift_ops;
+	d->forget = 0.999;
+	d->weight = 20;
+	d->gate = 32;
+	d->save_every = 16;
+
+	{
+		struct tslib_vars vars[] = {
+			{ "forget",	&d->forget,	drift_double },
+			{ "weight",	&d->weight,	drift_double },
+			{ "gate",	&d->gate,	drift_int },
+			{ "save",	&d->save_every,	drift_int },
+			{ "file",	NULL,		drift_file },
+		};
+
+		if (tslib_parse_vars(&d->module, vars,
+				     sizeof(vars) / sizeof(vars[0]), params))
+			goto fail;
+	}
+	if (d->forget > 1) {
+		fprintf(stderr, "drift: forget must be at most 1\n");
+		goto fail;
+	}
+	if (!d->file) {
+		d->file = strdup(TS_POINTERCAL ".drift");
+		if (!d->file)
+			goto fail;
+	}
+
+	/*
+	 * Start at no correction, held there as firmly as 'weight'
+	 * hints would.
+	 */
+	for (k = 0; k < 3; k++)
+		d->p[k][k] = 1 / d->weight;
+	drift_restore(d);
+
+	return &d->module;
+fail:
+	free(d->file);
+	free(d);
+	return NULL;
+}
+
+#ifndef TSLIB_STATIC_DRIFT_MODULE
+	TSLIB_MODULE_INIT(drift_mod_init);
+#endif
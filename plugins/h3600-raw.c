@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-event.h"
 
 struct h3600_ts_event { /* Used in the Compaq IPAQ */
 	unsigned short pressure;
@@ -12,51 +13,17 @@ struct h3600_ts_event { /* Used in the Compaq IPAQ */
 	unsigned short pad;
 };
 
-static int h3600_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
-{
-	struct tsdev *ts = inf->dev;
-	struct h3600_ts_event *h3600_evt;
-	int ret;
-	int total = 0;
-	h3600_evt = alloca(sizeof(*h3600_evt) * nr);
-	ret = read(ts->fd, h3600_evt, sizeof(*h3600_evt) * nr);
-	if(ret > 0) {
-		int nr = ret / sizeof(*h3600_evt);
-		while(ret >= (int)sizeof(*h3600_evt)) {
-			samp->x = h3600_evt->x;
-			samp->y = h3600_evt->y;
-			samp->pressure = h3600_evt->pressure;
-#ifdef DEBUG
-        fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
-#endif /*DEBUG*/
-			gettimeofday(&samp->tv,NULL);
-			samp++;
-			h3600_evt++;
-			ret -= sizeof(*h3600_evt);
-		}
-	} else {
-		return -1;
-	}
-
-	ret = nr;
-	return ret;
-}
-
-static const struct tslib_ops h3600_ops =
-{
-	.read	= h3600_read,
+static const struct ts_event_layout h3600_layout = {
+	.size		= sizeof(struct h3600_ts_event),
+	.x		= TS_EVENT_FIELD(struct h3600_ts_event, x),
+	.y		= TS_EVENT_FIELD(struct h3600_ts_event, y),
+	.pressure	= TS_EVENT_FIELD(struct h3600_ts_event, pressure),
+	.time_kind	= TS_EVENT_TIME_NOW,
 };
 
 TSAPI struct tslib_module_info *h3600_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
-
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
-		return NULL;
-
-	m->ops = &h3600_ops;
-	return m;
+	return ts_event_raw_init(dev, &h3600_layout);
 }
 
 #ifndef TSLIB_STATIC_H3600_MODULE
@@ -18,6 +18,8 @@
 #include <errno.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <stdlib.h>
 #ifdef HAVE_UNISTD_H
@@ -30,20 +32,23 @@
 #ifndef EV_SYN /* 2.4 kernel headers */
 # define EV_SYN 0x00
 #endif
-#ifndef EV_CNT
-# define EV_CNT (EV_MAX+1)
-#endif
-#ifndef ABS_CNT
-# define ABS_CNT (ABS_MAX+1)
-#endif
-#ifndef KEY_CNT
-# define KEY_CNT (KEY_MAX+1)
-#endif
 
 #ifndef ABS_MT_POSITION_X
 # define ABS_MT_POSITION_X       0x35    /* Center X ellipse position */
 # define ABS_MT_POSITION_Y       0x36    /* Center Y ellipse position */
 #endif
+#ifndef ABS_MT_SLOT
+# define ABS_MT_SLOT		0x2f
+#endif
+#ifndef ABS_MT_TRACKING_ID
+# define ABS_MT_TRACKING_ID	0x39
+#endif
+#ifndef SYN_DROPPED
+# define SYN_DROPPED		3
+#endif
+
+#define BITS_PER_LONG		(sizeof(long) * 8)
+#define test_bit(nr, addr)	(!!((addr)[(nr) / BITS_PER_LONG] & (1UL << ((nr) % BITS_PER_LONG))))
 
 #include "tslib-private.h"
 
@@ -57,71 +62,54 @@ struct tslib_input {
 	int	current_y;
 	int	current_p;
 
-	int	sane_fd;
 	int	using_syn;
 	int	grab_events;
-};
 
-#define DIV_ROUND_UP(n,d) (((n) + (d) - 1) / (d))
-#define BIT(nr)                 (1UL << (nr))
-#define BIT_MASK(nr)            (1UL << ((nr) % BITS_PER_LONG))
-#define BIT_WORD(nr)            ((nr) / BITS_PER_LONG)
-#define BITS_PER_BYTE           8
-#define BITS_PER_LONG           (sizeof(long) * BITS_PER_BYTE)
-#define BITS_TO_LONGS(nr)       DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
-#ifndef EV_CNT
-#define EV_CNT	(EV_MAX+1)
-#endif
+	/* the kernel dropped events, skip to the next SYN_REPORT */
+	int	dropping;
+	/* for EVIOCGMTSLOTS: a code, then a value for every slot */
+	int32_t	*mt_req;
+	int	mt_slots;
+};
 
-int old_api = 0;
-static int check_fd(struct tslib_input *i)
+/*
+ * Uses the capabilities probed at open, so that nothing is left to ask
+ * the kernel when the first sample is read.
+ */
+static int check_fd(struct tslib_input *i, struct tsdev *ts)
 {
-	struct tsdev *ts = i->module.dev;
-	int version;
-	long evbit[BITS_TO_LONGS(EV_CNT)];
-	long absbit[BITS_TO_LONGS(ABS_CNT)];
-	long keybit[BITS_TO_LONGS(KEY_CNT)];
+	const struct ts_caps *caps = &ts->caps;
 
-	if (ioctl(ts->fd, EVIOCGVERSION, &version) < 0) {
+	if (!(caps->flags & TS_CAP_EVDEV)) {
 		fprintf(stderr, "tslib: Selected device is not a Linux input event device\n");
 		return -1;
 	}
 
-	if (version < EV_VERSION) {
-		unsigned long bit[EV_CNT / BITS_PER_LONG + 1];
-		unsigned long absbit[ABS_MAX / BITS_PER_LONG + 1];
-
-		if (version != 0x010000) {
+	if (caps->flags & TS_CAP_OLD_API) {
+		if (caps->version != 0x010000) {
 			fprintf(stderr, "tslib: Selected device uses a different version(%d) of the event protocol than tslib was compiled for(%d)\n",
-				version, EV_VERSION);
+				caps->version, EV_VERSION);
 			return -1;
 		}
 
-		if (! (	(ioctl(ts->fd, EVIOCGBIT(0, sizeof(bit)), bit) >= 0) &&
-			(bit[0] & (1 << EV_ABS)) &&
-			(ioctl(ts->fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit) >= 0) &&
-			(absbit[0] & (1 << ABS_X)) &&
-			(absbit[0] & (1 << ABS_Y)) && (absbit[0] & (1 << ABS_PRESSURE)))) {
+		if (!(caps->flags & TS_CAP_ABS) ||
+		    !(caps->flags & TS_CAP_ABS_XY) ||
+		    !(caps->flags & TS_CAP_PRESSURE)) {
 			fprintf(stderr, "selected device is not a touchscreen I understand\n");
 			return -1;
 		}
 
-		if (bit[0] & (1 << EV_SYN))
+		if (caps->flags & TS_CAP_SYN)
 			i->using_syn = 1;
-		old_api = 1;
 		return 0;
 	}
 
-	if ( (ioctl(ts->fd, EVIOCGBIT(0, sizeof(evbit)), evbit) < 0) ||
-		!(evbit[BIT_WORD(EV_ABS)] & BIT_MASK(EV_ABS)) ||
-		!(evbit[BIT_WORD(EV_KEY)] & BIT_MASK(EV_KEY)) ) {
+	if (!(caps->flags & TS_CAP_ABS) || !(caps->flags & TS_CAP_KEY)) {
 		fprintf(stderr, "tslib: Selected device is not a touchscreen (must support ABS and KEY event types)\n");
 		return -1;
 	}
 
-	if ((ioctl(ts->fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit)) < 0 ||
-		!(absbit[BIT_WORD(ABS_X)] & BIT_MASK(ABS_X)) ||
-		!(absbit[BIT_WORD(ABS_Y)] & BIT_MASK(ABS_Y))) {
+	if (!(caps->flags & TS_CAP_ABS_XY)) {
 		fprintf(stderr, "tslib: Selected device is not a touchscreen (must support ABS_X and ABS_Y events)\n");
 		return -1;
 	}
@@ -131,17 +119,16 @@ static int check_fd(struct tslib_input *i)
 	we set it to constant 255. It's still controlled by BTN_TOUCH - when not
 	touched, the pressure is forced to 0. */
 
-	if (!(absbit[BIT_WORD(ABS_PRESSURE)] & BIT_MASK(ABS_PRESSURE))) {
+	if (!(caps->flags & TS_CAP_PRESSURE)) {
 		i->current_p = 255;
 
-		if ((ioctl(ts->fd, EVIOCGBIT(EV_KEY, sizeof(keybit)), keybit) < 0) ||
-			!(keybit[BIT_WORD(BTN_TOUCH)] & BIT_MASK(BTN_TOUCH)) ) {
+		if (!(caps->flags & TS_CAP_BTN_TOUCH)) {
 			fprintf(stderr, "tslib: Selected device is not a touchscreen (must support BTN_TOUCH events)\n");
 			return -1;
 		}
 	}
 
-	if (evbit[BIT_WORD(EV_SYN)] & BIT_MASK(EV_SYN))
+	if (caps->flags & TS_CAP_SYN)
 		i->using_syn = 1;
 
 	if (i->grab_events == GRAB_EVENTS_WANTED) {
@@ -155,6 +142,71 @@ static int check_fd(struct tslib_input *i)
 	return 0;
 }
 
+static int input_get_abs(struct tsdev *ts, int code, int *value)
+{
+	struct input_absinfo abs;
+
+	if (ioctl(ts->fd, EVIOCGABS(code), &abs) < 0)
+		return -1;
+	*value = abs.value;
+	return 0;
+}
+
+/*
+ * Reads the state of the device again after SYN_DROPPED, as the events
+ * that would have told it are gone.  Like the events, the ABS_X/ABS_Y
+ * of the pointer emulation win over the slots.  Returns 1 if the pen
+ * is up.
+ */
+static int input_resync(struct tslib_input *i, struct tsdev *ts)
+{
+	const struct ts_caps *caps = &ts->caps;
+	unsigned long keys[KEY_MAX / (sizeof(long) * 8) + 1];
+	int k, slot, x, y;
+
+#ifdef EVIOCGMTSLOTS
+	if (i->mt_req && input_get_abs(ts, ABS_MT_SLOT, &slot) == 0) {
+		size_t len = (i->mt_slots + 1) * sizeof(int32_t);
+		int32_t *v = i->mt_req + 1;
+
+		/* the current slot if it has a contact, else the first that does */
+		i->mt_req[0] = ABS_MT_TRACKING_ID;
+		if (ioctl(ts->fd, EVIOCGMTSLOTS(len), i->mt_req) == 0) {
+			if (slot < 0 || slot >= i->mt_slots || v[slot] < 0) {
+				for (k = 0; k < i->mt_slots && v[k] < 0; k++)
+					;
+				slot = k;
+			}
+			i->mt_req[0] = ABS_MT_POSITION_X;
+			if (slot < i->mt_slots &&
+			    ioctl(ts->fd, EVIOCGMTSLOTS(len), i->mt_req) == 0) {
+				x = v[slot];
+				i->mt_req[0] = ABS_MT_POSITION_Y;
+				if (ioctl(ts->fd, EVIOCGMTSLOTS(len), i->mt_req) == 0) {
+					i->current_x = x;
+					i->current_y = v[slot];
+				}
+			}
+		}
+	}
+#endif
+	if ((caps->flags & TS_CAP_ABS_XY) &&
+	    input_get_abs(ts, ABS_X, &x) == 0 &&
+	    input_get_abs(ts, ABS_Y, &y) == 0) {
+		i->current_x = x;
+		i->current_y = y;
+	}
+	if (caps->flags & TS_CAP_PRESSURE)
+		input_get_abs(ts, ABS_PRESSURE, &i->current_p);
+
+	if (caps->flags & TS_CAP_BTN_TOUCH) {
+		memset(keys, 0, sizeof(keys));
+		if (ioctl(ts->fd, EVIOCGKEY(sizeof(keys)), keys) == 0)
+			return !test_bit(BTN_TOUCH, keys);
+	}
+	return 0;
+}
+
 static int ts_input_read(struct tslib_module_info *inf,
 			 struct ts_sample *samp, int nr)
 {
@@ -165,20 +217,21 @@ static int ts_input_read(struct tslib_module_info *inf,
 	int total = 0;
 	int pen_up = 0;
 
-	if (i->sane_fd == 0)
-		i->sane_fd = check_fd(i);
-
-	if (i->sane_fd == -1)
-		return 0;
-
 	if (i->using_syn) {
 		while (total < nr) {
 			ret = read(ts->fd, &ev, sizeof(struct input_event));
 			if (ret < (int)sizeof(struct input_event)) {
-				total = -1;
+				/* keep what was read before EAGAIN */
+				if (total == 0)
+					total = -1;
 				break;
 			}
 
+			if (i->dropping && ev.type != EV_SYN) {
+				ts->stats.drop_events++;
+				continue;
+			}
+
 			switch (ev.type) {
 			case EV_KEY:
 				switch (ev.code) {
@@ -189,7 +242,19 @@ static int ts_input_read(struct tslib_module_info *inf,
 				}
 				break;
 			case EV_SYN:
+				if (ev.code == SYN_DROPPED) {
+					/* the partial frame is of no use either */
+					if (!i->dropping)
+						ts->stats.drops++;
+					i->dropping = 1;
+					pen_up = 0;
+					break;
+				}
 				if (ev.code == SYN_REPORT) {
+					if (i->dropping) {
+						i->dropping = 0;
+						pen_up = input_resync(i, ts);
+					}
 					/* Fill out a new complete event */
 					if (pen_up) {
 						samp->x = 0;
@@ -327,6 +392,7 @@ static int ts_input_fini(struct tslib_module_info *inf)
 		}
 	}
 
+	free(i->mt_req);
 	free(inf);
 	return 0;
 }
@@ -378,11 +444,26 @@ TSAPI struct tslib_module_info *input_mod_init(struct tsdev *dev, const char *pa
 	i->current_x = 0;
 	i->current_y = 0;
 	i->current_p = 0;
-	i->sane_fd = 0;
 	i->using_syn = 0;
 	i->grab_events = 0;
+	i->dropping = 0;
+	i->mt_req = NULL;
+	i->mt_slots = 0;
+
+	/* allocated now, so that a resync does not have to */
+	if ((dev->caps.flags & TS_CAP_MT) && (dev->caps.flags & TS_CAP_MT_SLOT) &&
+	    dev->caps.mt_slot.maximum >= 0) {
+		i->mt_slots = dev->caps.mt_slot.maximum + 1;
+		i->mt_req = malloc((i->mt_slots + 1) * sizeof(int32_t));
+		if (i->mt_req == NULL) {
+			free(i);
+			return NULL;
+		}
+	}
 
-	if (tslib_parse_vars(&i->module, raw_vars, NR_VARS, params)) {
+	if (tslib_parse_vars(&i->module, raw_vars, NR_VARS, params) ||
+	    check_fd(i, dev)) {
+		free(i->mt_req);
 		free(i);
 		return NULL;
 	}
@@ -43,46 +43,65 @@ struct tslib_linear {
 	unsigned int cal_res_y;
 };
 
+static void linear_sample(struct tslib_linear *lin, struct tsdev *dev,
+			  struct ts_sample *samp)
+{
+	int xtemp,ytemp;
+
+#ifdef DEBUG
+	fprintf(stderr,"BEFORE CALIB--------------------> %d %d %d\n",samp->x, samp->y, samp->pressure);
+#endif /*DEBUG*/
+	xtemp = samp->x; ytemp = samp->y;
+	samp->x = 	( lin->a[2] +
+			lin->a[0]*xtemp + 
+			lin->a[1]*ytemp ) / lin->a[6];
+	samp->y =	( lin->a[5] +
+			lin->a[3]*xtemp +
+			lin->a[4]*ytemp ) / lin->a[6];
+	if (dev->res_x && lin->cal_res_x)
+		samp->x = samp->x * dev->res_x / lin->cal_res_x;
+	if (dev->res_y && lin->cal_res_y)
+		samp->y = samp->y * dev->res_y / lin->cal_res_y;
+
+	samp->pressure = ((samp->pressure + lin->p_offset)
+				 * lin->p_mult) / lin->p_div;
+	if (lin->swap_xy) {
+		int tmp = samp->x;
+		samp->x = samp->y;
+		samp->y = tmp;
+	}
+}
+
 static int
 linear_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
 {
 	struct tslib_linear *lin = (struct tslib_linear *)info;
 	int ret;
-	int xtemp,ytemp;
 
 	ret = info->next->ops->read(info->next, samp, nr);
 	if (ret >= 0) {
 		int nr;
 
-		for (nr = 0; nr < ret; nr++, samp++) {
-#ifdef DEBUG
-			fprintf(stderr,"BEFORE CALIB--------------------> %d %d %d\n",samp->x, samp->y, samp->pressure);
-#endif /*DEBUG*/
-			xtemp = samp->x; ytemp = samp->y;
-			samp->x = 	( lin->a[2] +
-					lin->a[0]*xtemp + 
-					lin->a[1]*ytemp ) / lin->a[6];
-			samp->y =	( lin->a[5] +
-					lin->a[3]*xtemp +
-					lin->a[4]*ytemp ) / lin->a[6];
-			if (info->dev->res_x && lin->cal_res_x)
-				samp->x = samp->x * info->dev->res_x / lin->cal_res_x;
-			if (info->dev->res_y && lin->cal_res_y)
-				samp->y = samp->y * info->dev->res_y / lin->cal_res_y;
-
-			samp->pressure = ((samp->pressure + lin->p_offset)
-						 * lin->p_mult) / lin->p_div;
-			if (lin->swap_xy) {
-				int tmp = samp->x;
-				samp->x = samp->y;
-				samp->y = tmp;
-			}
-		}
+		for (nr = 0; nr < ret; nr++, samp++)
+			linear_sample(lin, info->dev, samp);
 	}
 
 	return ret;
 }
 
+static int
+linear_read_mt(struct tslib_module_info *info, struct ts_contact *c, int nr)
+{
+	struct tslib_linear *lin = (struct tslib_linear *)info;
+	int ret, k;
+
+	ret = tslib_read_mt(info->next, c, nr);
+	for (k = 0; k < ret; k++)
+		linear_sample(lin, info->dev, &c[k].samp);
+
+	return ret;
+}
+
 static int linear_fini(struct tslib_module_info *info)
 {
 	free(info);
@@ -93,6 +112,7 @@ static const struct tslib_ops linear_ops =
 {
 	.read	= linear_read,
 	.fini	= linear_fini,
+	.read_mt = linear_read_mt,
 };
 
 static int linear_xyswap(struct tslib_module_info *inf, char *str, void *data)
@@ -18,11 +18,11 @@
 #include <fcntl.h>
 
 #include <stdio.h>
-#include <linux/input.h>
 
 #include "tslib.h"
 #include "tslib-filter.h"
 #include "tsquadrant_cal.h"
+#include "tsmodel_cal.h"
 #include "tslib-private.h"
 
 struct tslib_linear {
@@ -36,6 +36,7 @@ struct tslib_linear {
 	int jMax;
 	int ncoeffs;
 	int nregions;
+	struct cal_model_result cal;	/* used when nterms is set */
 };
 
 static void transform(struct tslib_linear *lin, struct ts_sample *samp)
@@ -110,48 +111,70 @@ static void transform(struct tslib_linear *lin, struct ts_sample *samp)
 #endif
 }
 
-static void transform6(struct tslib_linear *lin, struct ts_sample *samp)
+static void transform_model(struct tslib_linear *lin, struct ts_sample *samp)
 {
-	u32 s[6];
+	const struct cal_model_result *m = &lin->cal;
+	u32 s[CAL_MAX_TERMS];
 	s64 xsum, ysum;
 	s32 cx, cy;
-	int xMax = lin->xMax;
-	int yMax = lin->yMax;
-	struct cal_result *r = &lin->res[0];
+	int xMax = m->xmax;
+	int yMax = m->ymax;
+	int q = QUAD_MAIN;
 	int i;
 
 #ifdef DEBUG
 	fprintf(stderr,"BEFORE CALIB--------------------> %d %d %d\n",samp->x, samp->y, samp->pressure);
 #endif /*DEBUG*/
 
+	/* the terms are unsigned fractions of the raw range, kept inside it */
 	cx = samp->x;
 	cy = samp->y;
-	if ((cx >= lin->iMax) || (cy >= lin->jMax))
-		printf("!!!%s:i=%d imax=%d, j=%d jmax=%d\n", __func__,
-				cx, lin->iMax, cy, lin->jMax);
-	s[0] = 1 << 16;
-	s[1] = (cx << 16) / lin->iMax;
-	s[2] = (cy << 16) / lin->jMax;
-	s[3] = (s[1] * s[2]) >> 16;
-	s[4] = (s[1] * s[1]) >> 16;
-	s[5] = (s[2] * s[2]) >> 16;
-
-	xsum = 0;
-	ysum = 0;
-	for (i = 0; i < 6 ; i++) {
-		xsum += (r->a[i] * (s64)s[i]);
-		ysum += (r->a[i + 6] * (s64)s[i]);
-	}
-	cx = (s32)((xsum * xMax) >> 32);
-	cy = (s32)((ysum * yMax) >> 32);
 	if (cx < 0)
 		cx = 0;
 	if (cy < 0)
 		cy = 0;
-	if (cx >= xMax)
-		cx = xMax - 1;
-	if (cy >= yMax)
-		cy = yMax - 1;
+	if (cx >= (s32)m->imax)
+		cx = m->imax - 1;
+	if (cy >= (s32)m->jmax)
+		cy = m->jmax - 1;
+	s[0] = 1 << 16;
+	s[1] = ((u32)cx << 16) / m->imax;
+	s[2] = ((u32)cy << 16) / m->jmax;
+	s[3] = ((u64)s[1] * s[2]) >> 16;
+	s[4] = ((u64)s[1] * s[1]) >> 16;
+	s[5] = ((u64)s[2] * s[2]) >> 16;
+	if (m->nterms > 6) {
+		s[6] = ((u64)s[4] * s[1]) >> 16;
+		s[7] = ((u64)s[4] * s[2]) >> 16;
+		s[8] = ((u64)s[5] * s[1]) >> 16;
+		s[9] = ((u64)s[5] * s[2]) >> 16;
+	}
+
+	for (;;) {
+		xsum = 0;
+		ysum = 0;
+		for (i = 0; i < m->nterms; i++) {
+			xsum += (m->x[q][i] * (s64)s[i]);
+			ysum += (m->y[q][i] * (s64)s[i]);
+		}
+		cx = (s32)((xsum * xMax) >> 32);
+		cy = (s32)((ysum * yMax) >> 32);
+		if (cx < 0)
+			cx = 0;
+		if (cy < 0)
+			cy = 0;
+		if (cx >= xMax)
+			cx = xMax - 1;
+		if (cy >= yMax)
+			cy = yMax - 1;
+		if (m->nregions == 1 || q != QUAD_MAIN)
+			break;
+		/* same quadrant split as transform() */
+		if (xMax * cy >= yMax * cx)
+			q = ((yMax - cy) * xMax >= yMax * cx) ? QUAD_LEFT : QUAD_BOTTOM;
+		else
+			q = ((yMax - cy) * xMax >= yMax * cx) ? QUAD_TOP : QUAD_RIGHT;
+	}
 	samp->x = cx;
 	samp->y = cy;
 #ifdef DEBUG
@@ -169,8 +192,8 @@ linearq_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
 	if (ret >= 0) {
 		int nr;
 		for (nr = 0; nr < ret; nr++, samp++) {
-			if (lin->xMax && lin->nregions == 1)
-				transform6(lin, samp);
+			if (lin->cal.nterms)
+				transform_model(lin, samp);
 			else
 				transform(lin, samp);
 		}
@@ -241,9 +264,9 @@ int get_linearq_settings(struct tslib_linear *lin, char *p)
 {
 	int q;
 	int r;
+	int index;
 	struct cal_data cal[9];
 	for (q = 0; q < 9; q++) {
-		int index;
 		for (index = 0; index < 4; index++) {
 			char *pend;
 			p = (char *)past_delim(p, delim_array, sizeof(delim_array));
@@ -269,11 +292,24 @@ int get_linearq_settings(struct tslib_linear *lin, char *p)
 	lin->yMax = cal[PT_MM].y * 2;
 	r = perform_n_point_calibration(cal, q, lin->xMax, lin->yMax,
 				lin->iMax, lin->jMax, lin->res);
+	if (r >= 0) {
+		struct cal_model_result *m = &lin->cal;
+
+		m->nterms = 6;
+		m->nregions = 1;
+		m->xmax = lin->xMax;
+		m->ymax = lin->yMax;
+		m->imax = lin->iMax;
+		m->jmax = lin->jMax;
+		for (index = 0; index < 6; index++) {
+			m->x[QUAD_MAIN][index] = lin->res[QUAD_MAIN].a[index];
+			m->y[QUAD_MAIN][index] = lin->res[QUAD_MAIN].a[index + 6];
+		}
+	}
 #ifdef DEBUG
 	printf("xMax=%d yMax=%d\n", lin->xMax, lin->yMax);
 	printf("Linear calibration constants: ");
 	for (q = 0; q < lin->nregions; q++) {
-		int index;
 		for(index = 0; index < lin->ncoeffs; index++)
 			printf("%d ",lin->res[q].a[index]);
 		printf("shift %d\n",lin->res[q].shift);
@@ -288,11 +324,10 @@ TSAPI struct tslib_module_info *linear_quad_mod_init(struct tsdev *ts, const cha
 	struct tslib_linear *lin;
 	struct stat sbuf;
 	int pcal_fd;
-	char inputbuf[400];
+	char inputbuf[1024];
 	int q;
 	int r;
 	char *calfile=NULL;
-	struct input_absinfo abs;
 
 	lin = malloc(sizeof(struct tslib_linear));
 	if (lin == NULL)
@@ -313,19 +348,16 @@ TSAPI struct tslib_module_info *linear_quad_mod_init(struct tsdev *ts, const cha
 		lin->res[q].shift = 0;
 	}
 	lin->xMax = lin->yMax = 0;
+	lin->cal.nterms = 0;
 
 
-	if (ioctl(ts->fd, EVIOCGABS(0), &abs) == 0) {
-		lin->iMax = abs.maximum + 1;
+	if (ts->caps.flags & TS_CAP_ABS_XY) {
+		lin->iMax = ts->caps.x.maximum + 1;
+		lin->jMax = ts->caps.y.maximum + 1;
 		printf("iMax = %d\n", lin->iMax);
-	} else {
-		printf("iMax read error, defaulting to 2048\n");
-	}
-	if (ioctl(ts->fd, EVIOCGABS(1), &abs) == 0) {
-		lin->jMax = abs.maximum + 1;
 		printf("jMax = %d\n", lin->jMax);
 	} else {
-		printf("jMax read error, defaulting to 2048\n");
+		printf("iMax/jMax unknown, defaulting to 2048\n");
 	}
 	/*
 	 * Check calibration file
@@ -344,12 +376,15 @@ TSAPI struct tslib_module_info *linear_quad_mod_init(struct tsdev *ts, const cha
 		}
 		p[size] = 0;
 
-		if (p[0] != '(') {
+		if (p[0] == '(') {
+			r = get_linearq_settings(lin, p);
+		} else if (p[0] == '#' || (p[0] >= 'a' && p[0] <= 'z')) {
+			/* model chosen by ts_calibrate_quadrant -a */
+			r = read_model_calibration(p, &lin->cal);
+		} else {
 			/* ts_calibrate was used instead of ts_calibrate_quadrant */
 			printf("Warning: use ts_calibrate_quadrant to get benefit of this module\n");
 			r = get_linear_settings(lin, p);
-		} else {
-			r = get_linearq_settings(lin, p);
 		}
 		if (r < 0) {
 			printf("calibration error %d\n", r);
@@ -0,0 +1,370 @@
+/*
+ *  tslib/plugins/merge-raw.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Several touch controllers as one device, such as two digitizers that
+ * each cover half of a table.  Every source has its own raw module; their
+ * samples are moved by a per-source offset and merged in timestamp order,
+ * so the filters above see a single touchscreen.
+ *
+ *	module_raw merge raw=input source=/dev/input/event3 raw=input xoff=1920
+ *
+ * Parameters before the first source= are for the device tslib opened.
+ * The device's descriptor is replaced by an epoll descriptor that is
+ * readable when any source is, so ts_fd() and ts_reactor keep working.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/epoll.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "tslib-private.h"
+
+#define MERGE_MAX_SOURCES	8
+#define MERGE_QUEUE		64	/* samples, a power of 2 */
+
+struct merge_source {
+	struct tsdev	*ts;
+	char		*raw;
+	int		xoff;
+	int		yoff;
+	long		toff;		/* usec added to the timestamps */
+	int		pressed;
+	int		failed;
+
+	/* read but not yet merged, in the order the source gave them */
+	struct ts_sample queue[MERGE_QUEUE];
+	unsigned int	head;
+	unsigned int	tail;
+};
+
+struct tslib_merge {
+	struct tslib_module_info module;
+	struct merge_source source[MERGE_MAX_SOURCES];
+	char		*path[MERGE_MAX_SOURCES];	/* [0] is the device */
+	int		nr_sources;
+	int		epfd;
+};
+
+static void merge_fail(struct tslib_merge *m, int k)
+{
+	struct merge_source *s = &m->source[k];
+
+	epoll_ctl(m->epfd, EPOLL_CTL_DEL, s->ts->fd, NULL);
+	s->failed = 1;
+	s->pressed = 0;
+	ts_error("merge: source %d failed\n", k);
+}
+
+/* Read all a source has, as far as its queue goes */
+static void merge_drain(struct tslib_merge *m, int k)
+{
+	struct merge_source *s = &m->source[k];
+
+	while (s->tail - s->head < MERGE_QUEUE) {
+		unsigned int at = s->tail % MERGE_QUEUE;
+		unsigned int room = MERGE_QUEUE - s->tail + s->head;
+		struct ts_sample *samp = &s->queue[at];
+		int ret, i;
+
+		if (room > MERGE_QUEUE - at)
+			room = MERGE_QUEUE - at;
+
+		errno = 0;
+		ret = ts_read(s->ts, samp, room);
+		if (ret < 0 && errno != EAGAIN && errno != EINTR)
+			merge_fail(m, k);
+		if (ret <= 0)
+			return;
+
+		for (i = 0; i < ret; i++, samp++) {
+			samp->x += s->xoff;
+			samp->y += s->yoff;
+			samp->tv.tv_usec += s->toff;
+			samp->tv.tv_sec += samp->tv.tv_usec / 1000000;
+			samp->tv.tv_usec %= 1000000;
+			if (samp->tv.tv_usec < 0) {
+				samp->tv.tv_usec += 1000000;
+				samp->tv.tv_sec--;
+			}
+		}
+		s->tail += ret;
+		if (ret < (int)room)
+			return;
+	}
+}
+
+/*
+ * Fill the queues from the sources that are readable, waiting for one
+ * if there is nothing queued and the device is blocking.  Returns the
+ * number of queued samples, or -1.
+ */
+static int merge_fill(struct tslib_merge *m, int fd)
+{
+	struct epoll_event ev[MERGE_MAX_SOURCES];
+	int timeout = 0;
+
+	for (;;) {
+		int queued = 0, live = 0;
+		int n, k;
+
+		n = epoll_wait(m->epfd, ev, MERGE_MAX_SOURCES, timeout);
+		if (n < 0 && errno != EINTR)
+			return -1;
+		for (k = 0; k < n; k++)
+			merge_drain(m, ev[k].data.u32);
+
+		for (k = 0; k < m->nr_sources; k++) {
+			queued += m->source[k].tail - m->source[k].head;
+			live += !m->source[k].failed;
+		}
+		if (queued)
+			return queued;
+		if (!live)
+			return -1;
+		if (fcntl(fd, F_GETFL) & O_NONBLOCK) {
+			errno = EAGAIN;
+			return -1;
+		}
+		timeout = -1;
+	}
+}
+
+static int timeval_before(const struct timeval *a, const struct timeval *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_usec < b->tv_usec);
+}
+
+/*
+ * k-way merge of the queue heads.  With a handful of sources a scan for
+ * the earliest beats keeping a heap.
+ */
+static int merge_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
+{
+	struct tslib_merge *m = (struct tslib_merge *)inf;
+	int total = 0;
+
+	if (merge_fill(m, inf->dev->fd) < 0)
+		return -1;
+
+	while (total < nr) {
+		struct merge_source *s, *first = NULL;
+		struct ts_sample *head;
+		int k, others = 0;
+
+		for (k = 0; k < m->nr_sources; k++) {
+			s = &m->source[k];
+			if (s->head == s->tail)
+				continue;
+			if (!first || timeval_before(&s->queue[s->head % MERGE_QUEUE].tv,
+						     &first->queue[first->head % MERGE_QUEUE].tv))
+				first = s;
+		}
+		if (!first)
+			break;
+
+		head = &first->queue[first->head++ % MERGE_QUEUE];
+		first->pressed = head->pressure != 0;
+
+		/* the pen is only up when it is up on every source */
+		if (!first->pressed) {
+			for (k = 0; k < m->nr_sources; k++)
+				others |= m->source[k].pressed;
+			if (others)
+				continue;
+		}
+		*samp++ = *head;
+		total++;
+	}
+	return total;
+}
+
+static int merge_fini(struct tslib_module_info *inf)
+{
+	struct tslib_merge *m = (struct tslib_merge *)inf;
+	int k;
+
+	for (k = 0; k < m->nr_sources; k++) {
+		if (m->source[k].ts)
+			ts_close(m->source[k].ts);
+		free(m->source[k].raw);
+		free(m->path[k]);
+	}
+	/* the device's own descriptor is the epoll one, closed by ts_close */
+	free(m);
+	return 0;
+}
+
+static const struct tslib_ops merge_ops =
+{
+	.read	= merge_read,
+	.fini	= merge_fini,
+};
+
+static int merge_source(struct tslib_module_info *inf, char *str, void *data)
+{
+	struct tslib_merge *m = (struct tslib_merge *)inf;
+
+	(void)data;
+
+	if (!str || m->nr_sources == MERGE_MAX_SOURCES)
+		return -1;
+	m->path[m->nr_sources] = strdup(str);
+	if (!m->path[m->nr_sources])
+		return -1;
+	m->nr_sources++;
+	return 0;
+}
+
+static int merge_raw(struct tslib_module_info *inf, char *str, void *data)
+{
+	struct tslib_merge *m = (struct tslib_merge *)inf;
+	struct merge_source *s = &m->source[m->nr_sources - 1];
+
+	(void)data;
+
+	if (!str)
+		return -1;
+	free(s->raw);
+	s->raw = strdup(str);
+	return s->raw ? 0 : -1;
+}
+
+static int merge_offset(struct tslib_module_info *inf, char *str, void *data)
+{
+	struct tslib_merge *m = (struct tslib_merge *)inf;
+	struct merge_source *s = &m->source[m->nr_sources - 1];
+	char *end;
+	long v;
+
+	if (!str)
+		return -1;
+	v = strtol(str, &end, 0);
+	if (end == str || v < INT_MIN || v > INT_MAX)
+		return -1;
+
+	switch ((long)data) {
+	case 0:
+		s->xoff = v;
+		break;
+	case 1:
+		s->yoff = v;
+		break;
+	case 2:
+		s->toff = v;
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+static const struct tslib_vars merge_vars[] =
+{
+	{ "source",	NULL,		merge_source },
+	{ "raw",	NULL,		merge_raw },
+	{ "xoff",	(void *)0,	merge_offset },
+	{ "yoff",	(void *)1,	merge_offset },
+	{ "toff",	(void *)2,	merge_offset },
+};
+
+#define NR_VARS (sizeof(merge_vars) / sizeof(merge_vars[0]))
+
+static int merge_open(struct tslib_merge *m, int k, int fd)
+{
+	struct merge_source *s = &m->source[k];
+	struct epoll_event ev;
+	int flags;
+
+	if (fd < 0) {
+		fd = open(m->path[k], O_RDWR | O_NONBLOCK);
+		if (fd < 0 && errno == EACCES)
+			fd = open(m->path[k], O_RDONLY | O_NONBLOCK);
+		if (fd < 0) {
+			perror(m->path[k]);
+			return -1;
+		}
+	}
+	s->ts = ts_open_fd(fd);
+	if (!s->ts) {
+		if (k)
+			close(fd);
+		return -1;
+	}
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+		return -1;
+
+	if (ts_load_module(s->ts, s->raw ? s->raw : "input", NULL)) {
+		ts_error("merge: cannot load %s for source %d\n",
+			 s->raw ? s->raw : "input", k);
+		return -1;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = k;
+	return epoll_ctl(m->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+TSAPI struct tslib_module_info *merge_mod_init(struct tsdev *dev, const char *params)
+{
+	struct tslib_merge *m;
+	int flags, k;
+
+	m = malloc(sizeof(struct tslib_merge));
+	if (m == NULL)
+		return NULL;
+
+	memset(m, 0, sizeof(struct tslib_merge));
+	m->module.ops = &merge_ops;
+	m->nr_sources = 1;
+	m->epfd = -1;
+
+	if (tslib_parse_vars(&m->module, merge_vars, NR_VARS, params))
+		goto fail;
+
+	m->epfd = epoll_create(MERGE_MAX_SOURCES);
+	if (m->epfd < 0)
+		goto fail;
+	flags = fcntl(dev->fd, F_GETFL);
+	if (flags < 0 || fcntl(m->epfd, F_SETFL, flags & O_NONBLOCK) < 0)
+		goto fail;
+
+	/* the device becomes the first source, the rest are opened here */
+	if (merge_open(m, 0, dev->fd))
+		goto fail_dev;
+	for (k = 1; k < m->nr_sources; k++)
+		if (merge_open(m, k, -1))
+			goto fail_dev;
+	dev->fd = m->epfd;
+
+	return &m->module;
+
+fail_dev:
+	/* give the device its descriptor back as it was, it is closed with it */
+	if (m->source[0].ts)
+		m->source[0].ts->fd = -1;
+	fcntl(dev->fd, F_SETFL, flags);
+fail:
+	if (m->epfd >= 0)
+		close(m->epfd);
+	m->epfd = -1;
+	merge_fini(&m->module);
+	return NULL;
+}
+
+#ifndef TSLIB_STATIC_MERGE_MODULE
+	TSLIB_MODULE_INIT(merge_mod_init);
+#endif
@@ -1,9 +1,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <string.h>
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-event.h"
 
 struct mk712_ts_event { /* Used in the Hitachi Webpad */
 	unsigned int header;
@@ -12,54 +14,28 @@ struct mk712_ts_event { /* Used in the Hitachi Webpad */
 	unsigned int reserved;
 };
 
-static int mk712_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
+/* the header is 0 while the pen is down */
+static int mk712_decode(const unsigned char *rec, struct ts_sample *samp)
 {
-	struct tsdev *ts = inf->dev;
-	struct mk712_ts_event *mk712_evt;
-	int ret;
-	int total = 0;
-	mk712_evt = alloca(sizeof(*mk712_evt) * nr);
-	ret = read(ts->fd, mk712_evt, sizeof(*mk712_evt) * nr);
-	if(ret > 0) {
-		int nr = ret / sizeof(*mk712_evt);
-		while(ret >= (int)sizeof(*mk712_evt)) {
-			samp->x = (short)mk712_evt->x;
-			samp->y = (short)mk712_evt->y;
-			if(mk712_evt->header==0)
-				samp->pressure=1;
-			else
-				samp->pressure=0;
-#ifdef DEBUG
-        fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
-#endif /*DEBUG*/
-			gettimeofday(&samp->tv,NULL);
-			samp++;
-			mk712_evt++;
-			ret -= sizeof(*mk712_evt);
-		}
-	} else {
-		return -1;
-	}
+	struct mk712_ts_event evt;
 
-	ret = nr;
-	return ret;
+	memcpy(&evt, rec, sizeof(evt));
+	samp->pressure = evt.header == 0;
+	return 1;
 }
 
-static const struct tslib_ops mk712_ops =
-{
-	.read	= mk712_read,
+/* coordinates are 16 bit signed */
+static const struct ts_event_layout mk712_layout = {
+	.size		= sizeof(struct mk712_ts_event),
+	.x		= TS_EVENT_FIELD_AS(struct mk712_ts_event, x, 16, 1),
+	.y		= TS_EVENT_FIELD_AS(struct mk712_ts_event, y, 16, 1),
+	.time_kind	= TS_EVENT_TIME_NOW,
+	.decode		= mk712_decode,
 };
 
 TSAPI struct tslib_module_info *mk712_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
-
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
-		return NULL;
-
-	m->ops = &mk712_ops;
-	return m;
+	return ts_event_raw_init(dev, &mk712_layout);
 }
 
 #ifndef TSLIB_STATIC_MK712_MODULE
@@ -2,10 +2,15 @@
 	TSAPI struct tslib_module_info *name##_mod_init(struct tsdev *dev, const char *params)
 
 TSLIB_DECLARE_MODULE(linear);
+TSLIB_DECLARE_MODULE(linear_quad);
 TSLIB_DECLARE_MODULE(dejitter);
 TSLIB_DECLARE_MODULE(linear_h2200);
+TSLIB_DECLARE_MODULE(polycorrect);
+TSLIB_DECLARE_MODULE(drift);
 TSLIB_DECLARE_MODULE(variance);
 TSLIB_DECLARE_MODULE(pthres);
+TSLIB_DECLARE_MODULE(track);
+TSLIB_DECLARE_MODULE(power);
 
 TSLIB_DECLARE_MODULE(ucb1x00);
 TSLIB_DECLARE_MODULE(corgi);
@@ -15,4 +20,7 @@ TSLIB_DECLARE_MODULE(mk712);
 TSLIB_DECLARE_MODULE(arctic2);
 TSLIB_DECLARE_MODULE(tatung);
 TSLIB_DECLARE_MODULE(input);
+TSLIB_DECLARE_MODULE(touchkit);
+TSLIB_DECLARE_MODULE(dmc);
+TSLIB_DECLARE_MODULE(merge);
 TSLIB_DECLARE_MODULE(cy8mrln_palmpre);
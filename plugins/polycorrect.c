@@ -0,0 +1,294 @@
+/*
+ *  tslib/plugins/polycorrect.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Correct touchscreen values with a polynomial of any order, loaded
+ * from a coefficient file.  Generalizes linear-h2200, which has one
+ * panel's quadratic compiled in.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "tslib.h"
+#include "tslib-filter.h"
+
+#define POLY_MAX_ORDER	6
+#define POLY_MAX_TERMS	((POLY_MAX_ORDER + 1) * (POLY_MAX_ORDER + 2) / 2)
+
+/*
+ * Coefficients are kept in Horner order, ready to be streamed:
+ * for j = order .. 0, the coefficients of x^i y^j for i = order - j .. 0,
+ * pre-scaled for inputs normalized to 0..1 and shifted left by 'shift'.
+ */
+struct poly_axis {
+	long long	c[POLY_MAX_TERMS];
+	int		shift;
+};
+
+struct tslib_polycorrect {
+	struct tslib_module_info module;
+	int		order;
+	int		xbits;		/* inputs are clamped to 0..(1 << bits) - 1 */
+	int		ybits;
+	struct poly_axis x;
+	struct poly_axis y;
+};
+
+static long long poly_eval(const struct poly_axis *a, int order,
+		long long x, long long y, int xbits, int ybits)
+{
+	const long long *c = a->c;
+	long long p = 0;
+	int i, j;
+
+	for (j = order; j >= 0; j--) {
+		long long q = *c++;
+
+		for (i = order - j; i > 0; i--)
+			q = *c++ + ((q * x) >> xbits);
+		p = q + ((p * y) >> ybits);
+	}
+	return (p + (1LL << (a->shift - 1))) >> a->shift;
+}
+
+static int
+polycorrect_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+{
+	struct tslib_polycorrect *pc = (struct tslib_polycorrect *)info;
+	int xlimit = (1 << pc->xbits) - 1;
+	int ylimit = (1 << pc->ybits) - 1;
+	int ret;
+
+	ret = info->next->ops->read(info->next, samp, nr);
+	if (ret >= 0) {
+		int nr;
+
+		for (nr = 0; nr < ret; nr++, samp++) {
+			int x = samp->x;
+			int y = samp->y;
+
+			if (x < 0)
+				x = 0;
+			else if (x > xlimit)
+				x = xlimit;
+			if (y < 0)
+				y = 0;
+			else if (y > ylimit)
+				y = ylimit;
+
+			samp->x = poly_eval(&pc->x, pc->order, x, y,
+					    pc->xbits, pc->ybits);
+			samp->y = poly_eval(&pc->y, pc->order, x, y,
+					    pc->xbits, pc->ybits);
+#ifdef DEBUG
+			fprintf(stderr, "POLYCORRECT-------------> %d %d -> %d %d\n",
+				x, y, samp->x, samp->y);
+#endif
+		}
+	}
+
+	return ret;
+}
+
+static int polycorrect_fini(struct tslib_module_info *info)
+{
+	free(info);
+	return 0;
+}
+
+static const struct tslib_ops polycorrect_ops =
+{
+	.read	= polycorrect_read,
+	.fini	= polycorrect_fini,
+};
+
+static int bits_for(unsigned long range)
+{
+	int bits = 0;
+
+	while ((1UL << bits) < range)
+		bits++;
+	return bits;
+}
+
+/*
+ * Scale the coefficients for inputs normalized to 0..1, so that every
+ * partial Horner sum is bounded by the sum of their magnitudes, then
+ * pick the largest shift for which that bound, multiplied by an input,
+ * still fits in 63 bits.
+ */
+static int poly_setup(struct poly_axis *a, const double *coef, int order,
+		int xbits, int ybits)
+{
+	double scaled[POLY_MAX_TERMS];
+	double bound = 0;
+	int maxbits = xbits > ybits ? xbits : ybits;
+	int d, k, n = 0;
+
+	for (d = 0; d <= order; d++) {
+		for (k = 0; k <= d; k++, n++) {
+			scaled[n] = ldexp(coef[n], xbits * (d - k) + ybits * k);
+			bound += fabs(scaled[n]);
+		}
+	}
+	if (bound < 1)
+		bound = 1;
+
+	a->shift = 61 - maxbits - (int)ceil(log2(bound));
+	if (a->shift < 8) {
+		fprintf(stderr, "polycorrect: coefficients out of range\n");
+		return -1;
+	}
+	if (a->shift > 48)
+		a->shift = 48;
+
+	/* graded order 1 x y x2 xy y2 ... into Horner order */
+	n = 0;
+	for (d = order; d >= 0; d--) {
+		int i;
+
+		for (i = order - d; i >= 0; i--) {
+			int deg = i + d;
+
+			a->c[n++] = llround(ldexp(scaled[deg * (deg + 1) / 2 + d],
+						  a->shift));
+		}
+	}
+	return 0;
+}
+
+static int read_coefs(FILE *f, double *coef, int nterms)
+{
+	int k;
+
+	for (k = 0; k < nterms; k++)
+		if (fscanf(f, "%lf", &coef[k]) != 1)
+			return -1;
+	return 0;
+}
+
+/*
+ * File format, terms in graded order 1 x y x2 xy y2 x3 x2y xy2 y3 ...:
+ *	order <n>
+ *	range <xrange> <yrange>
+ *	x <coefficients>
+ *	y <coefficients>
+ * Lines starting with '#' are comments.
+ */
+static int polycorrect_load(struct tslib_polycorrect *pc, const char *file)
+{
+	double xcoef[POLY_MAX_TERMS], ycoef[POLY_MAX_TERMS];
+	unsigned long xrange = 0, yrange = 0;
+	int have_x = 0, have_y = 0;
+	int nterms = 0;
+	char word[16];
+	FILE *f;
+	int ret = -1;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+
+	pc->order = -1;
+	while (fscanf(f, "%15s", word) == 1) {
+		if (word[0] == '#') {
+			int c;
+
+			while ((c = fgetc(f)) != EOF && c != '\n')
+				;
+		} else if (!strcmp(word, "order")) {
+			if (fscanf(f, "%d", &pc->order) != 1 ||
+			    pc->order < 0 || pc->order > POLY_MAX_ORDER)
+				goto out;
+			nterms = (pc->order + 1) * (pc->order + 2) / 2;
+		} else if (!strcmp(word, "range")) {
+			if (fscanf(f, "%lu %lu", &xrange, &yrange) != 2)
+				goto out;
+		} else if (!strcmp(word, "x") && nterms) {
+			if (read_coefs(f, xcoef, nterms))
+				goto out;
+			have_x = 1;
+		} else if (!strcmp(word, "y") && nterms) {
+			if (read_coefs(f, ycoef, nterms))
+				goto out;
+			have_y = 1;
+		} else {
+			goto out;
+		}
+	}
+	if (!have_x || !have_y || !xrange || !yrange)
+		goto out;
+
+	pc->xbits = bits_for(xrange);
+	pc->ybits = bits_for(yrange);
+	if (poly_setup(&pc->x, xcoef, pc->order, pc->xbits, pc->ybits) ||
+	    poly_setup(&pc->y, ycoef, pc->order, pc->xbits, pc->ybits))
+		goto out;
+#ifdef DEBUG
+	printf("polycorrect: order %d, %d/%d input bits, shift %d/%d\n",
+	       pc->order, pc->xbits, pc->ybits, pc->x.shift, pc->y.shift);
+#endif
+	ret = 0;
+out:
+	if (ret)
+		fprintf(stderr, "polycorrect: %s: bad coefficient file\n", file);
+	fclose(f);
+	return ret;
+}
+
+static int polycorrect_file(struct tslib_module_info *inf, char *str, void *data)
+{
+	(void)inf;
+
+	if (!str)
+		return -1;
+	/* str is gone once tslib_parse_vars() returns */
+	free(*(char **)data);
+	*(char **)data = strdup(str);
+	return *(char **)data ? 0 : -1;
+}
+
+TSAPI struct tslib_module_info *polycorrect_mod_init(struct tsdev *dev, const char *params)
+{
+	struct tslib_polycorrect *pc;
+	char *file = NULL;
+	struct tslib_vars vars[] = {
+		{ "file",	&file, polycorrect_file },
+	};
+
+	(void)dev;
+
+	pc = malloc(sizeof(struct tslib_polycorrect));
+	if (pc == NULL)
+		return NULL;
+
+	memset(pc, 0, sizeof(struct tslib_polycorrect));
+	pc->module.ops = &polycorrect_ops;
+
+	if (tslib_parse_vars(&pc->module, vars, 1, params))
+		goto fail;
+	if (polycorrect_load(pc, file ? file : TS_POLYCORRECT))
+		goto fail;
+
+	free(file);
+	return &pc->module;
+fail:
+	free(file);
+	free(pc);
+	return NULL;
+}
+
+#ifndef TSLIB_STATIC_POLYCORRECT_MODULE
+	TSLIB_MODULE_INIT(polycorrect_mod_init);
+#endif
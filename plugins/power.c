@@ -0,0 +1,241 @@
+/*
+ *  tslib/plugins/power.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Saves power on controllers that can scan slower or sleep until they
+ * are touched.  While nothing touches the screen, the raw module below
+ * is set to a lower scan rate after a while, and put to sleep after a
+ * longer one; the first touch brings it back to the full rate.  The
+ * raw module does the work through its set_rate and set_idle ops.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "tslib-private.h"
+#include "tslib-filter.h"
+
+enum {
+	POWER_ACTIVE,
+	POWER_IDLE,		/* at the idle rate */
+	POWER_ASLEEP,		/* until it is touched */
+};
+
+struct tslib_power {
+	struct tslib_module_info module;
+	int		rate;		/* Hz while in use, 0 to leave it */
+	int		idle_rate;	/* Hz once idle, 0 to leave it */
+	unsigned long	idle_ms;	/* untouched this long, idle */
+	unsigned long	sleep_ms;	/* untouched this long, asleep */
+
+	struct tslib_module_info *raw;	/* the module below with the ops */
+	int		state;
+	int		started;
+	int		waking;
+	struct timespec	start;
+	struct timespec	last_touch;
+	struct timespec	wake;
+};
+
+static unsigned long long power_ns(const struct timespec *from,
+				   const struct timespec *to)
+{
+	return (unsigned long long)(to->tv_sec - from->tv_sec) * 1000000000ULL +
+	       to->tv_nsec - from->tv_nsec;
+}
+
+static void power_set_rate(struct tslib_power *p, int rate)
+{
+	if (rate && p->raw->ops->set_rate)
+		p->raw->ops->set_rate(p->raw, rate);
+}
+
+static void power_set_idle(struct tslib_power *p, int idle)
+{
+	if (p->raw->ops->set_idle)
+		p->raw->ops->set_idle(p->raw, idle);
+}
+
+static void power_start(struct tslib_power *p, const struct timespec *now)
+{
+	struct tslib_module_info *m;
+
+	/* the chain below is only complete once ts_config() is done */
+	p->raw = p->module.next;
+	for (m = p->module.next; m; m = m->next) {
+		if (m->ops->set_rate || m->ops->set_idle) {
+			p->raw = m;
+			break;
+		}
+	}
+	power_set_rate(p, p->rate);
+	p->state = POWER_ACTIVE;
+	p->start = p->last_touch = *now;
+	p->started = 1;
+}
+
+/*
+ * Called after every read from below: counts it, and moves between
+ * the states on a touch or when the idle times have passed.
+ */
+static void power_update(struct tslib_power *p, int touch)
+{
+	struct ts_stats *stats = &p->module.dev->stats;
+	struct timespec now;
+	unsigned long long idle;
+	unsigned long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!p->started)
+		power_start(p, &now);
+
+	stats->wakeups++;
+	stats->wakeup_ns = power_ns(&p->start, &now);
+
+	if (p->waking) {
+		ns = power_ns(&p->wake, &now);
+		stats->wake_ns = ns;
+		if (ns > stats->wake_ns_max)
+			stats->wake_ns_max = ns;
+		p->waking = 0;
+	}
+
+	if (touch) {
+		if (p->state != POWER_ACTIVE) {
+			if (p->state == POWER_ASLEEP)
+				power_set_idle(p, 0);
+			power_set_rate(p, p->rate);
+			p->state = POWER_ACTIVE;
+			stats->wakes++;
+			p->wake = now;
+			p->waking = 1;
+		}
+		p->last_touch = now;
+		return;
+	}
+
+	idle = power_ns(&p->last_touch, &now) / 1000000;
+	if (p->state == POWER_ACTIVE && p->idle_ms && idle >= p->idle_ms) {
+		power_set_rate(p, p->idle_rate);
+		p->state = POWER_IDLE;
+	}
+	if (p->state != POWER_ASLEEP && p->sleep_ms && idle >= p->sleep_ms) {
+		power_set_idle(p, 1);
+		p->state = POWER_ASLEEP;
+	}
+}
+
+static int power_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+{
+	struct tslib_power *p = (struct tslib_power *)info;
+	int ret, k, touch = 0;
+
+	ret = info->next->ops->read(info->next, samp, nr);
+	if (ret < 0)
+		return ret;
+	for (k = 0; k < ret && !touch; k++)
+		touch = samp[k].pressure > 0;
+	power_update(p, touch);
+	return ret;
+}
+
+static int power_read_mt(struct tslib_module_info *info, struct ts_contact *c, int nr)
+{
+	struct tslib_power *p = (struct tslib_power *)info;
+	int ret, k, touch = 0;
+
+	ret = tslib_read_mt(info->next, c, nr);
+	if (ret < 0)
+		return ret;
+	for (k = 0; k < ret && !touch; k++)
+		touch = c[k].samp.pressure > 0;
+	power_update(p, touch);
+	return ret;
+}
+
+static int power_fini(struct tslib_module_info *info)
+{
+	free(info);
+	return 0;
+}
+
+static const struct tslib_ops power_ops =
+{
+	.read		= power_read,
+	.fini		= power_fini,
+	.read_mt	= power_read_mt,
+};
+
+static int power_limit(struct tslib_module_info *inf, char *str, void *data)
+{
+	struct tslib_power *p = (struct tslib_power *)inf;
+	unsigned long v;
+	int err = errno;
+
+	v = strtoul(str, NULL, 0);
+
+	if (v == ULONG_MAX && errno == ERANGE)
+		return -1;
+
+	errno = err;
+	switch ((int)(long)data) {
+	case 1:
+		p->rate = v;
+		break;
+	case 2:
+		p->idle_rate = v;
+		break;
+	case 3:
+		p->idle_ms = v;
+		break;
+	case 4:
+		p->sleep_ms = v;
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+static const struct tslib_vars power_vars[] =
+{
+	{ "rate",	(void *)1, power_limit },
+	{ "idle_rate",	(void *)2, power_limit },
+	{ "idle",	(void *)3, power_limit },
+	{ "sleep",	(void *)4, power_limit },
+};
+
+#define NR_VARS (sizeof(power_vars) / sizeof(power_vars[0]))
+
+TSAPI struct tslib_module_info *power_mod_init(struct tsdev *dev, const char *params)
+{
+	struct tslib_power *p;
+
+	p = malloc(sizeof(struct tslib_power));
+	if (p == NULL)
+		return NULL;
+
+	memset(p, 0, sizeof(struct tslib_power));
+	p->module.ops = &power_ops;
+	p->rate = 60;
+	p->idle_rate = 10;
+	p->idle_ms = 500;
+	p->sleep_ms = 5000;
+
+	if (tslib_parse_vars(&p->module, power_vars, NR_VARS, params)) {
+		free(p);
+		return NULL;
+	}
+
+	return &p->module;
+}
+
+#ifndef TSLIB_STATIC_POWER_MODULE
+	TSLIB_MODULE_INIT(power_mod_init);
+#endif
@@ -28,6 +28,9 @@ struct tslib_pthres {
 	struct tslib_module_info module;
 	unsigned int	pmin;
 	unsigned int	pmax;
+	int		xsave;		/* last press, reported with the release */
+	int		ysave;
+	int		press;
 };
 
 static int
@@ -35,8 +38,6 @@ pthres_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
 {
 	struct tslib_pthres *p = (struct tslib_pthres *)info;
 	int ret;
-	static int xsave = 0, ysave = 0;
-	static int press = 0;
 
 	ret = info->next->ops->read(info->next, samp, nr);
 	if (ret >= 0) {
@@ -45,12 +46,12 @@ pthres_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
 
 		for (s = samp, i = 0; i < ret; i++, s++) {
 			if (s->pressure < p->pmin) {
-				if (press != 0) {
+				if (p->press != 0) {
 					/* release */
-					press = 0;
+					p->press = 0;
 					s->pressure = 0;
-					s->x = xsave;
-					s->y = ysave;
+					s->x = p->xsave;
+					s->y = p->ysave;
 				} else {
 					/* release with no press, outside bounds, dropping */
 					int left = ret - nr - 1;
@@ -73,9 +74,9 @@ pthres_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
 					break;
 				}
 				/* press */
-				press = 1;
-				xsave = s->x;
-				ysave = s->y;
+				p->press = 1;
+				p->xsave = s->x;
+				p->ysave = s->y;
 			}
 			nr++;
 		}
@@ -141,6 +142,7 @@ TSAPI struct tslib_module_info *pthres_mod_init(struct tsdev *dev, const char *p
 	if (p == NULL)
 		return NULL;
 
+	memset(p, 0, sizeof(struct tslib_pthres));
 	p->module.ops = &pthres_ops;
 
 	p->pmin = 1;
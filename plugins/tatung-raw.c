@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-event.h"
 
 struct tatung_ts_event { /* Tatung touchscreen 4bytes protocol */
 	unsigned char x1;
@@ -12,61 +13,32 @@ struct tatung_ts_event { /* Tatung touchscreen 4bytes protocol */
 	unsigned char y2;
 };
 
-static int tatung_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
+/* a record with a byte of 240 in it is the pen going up */
+static int tatung_decode(const unsigned char *rec, struct ts_sample *samp)
 {
-	struct tsdev *ts = inf->dev;
-	struct tatung_ts_event *tatung_evt;
-	int ret;
-	int total = 0;
-	tatung_evt = alloca(sizeof(*tatung_evt) * nr);
-	ret = read(ts->fd, tatung_evt, sizeof(*tatung_evt) * nr);
-	if(ret > 0) {
-		int nr = ret / sizeof(*tatung_evt);
-		while(ret >= (int)sizeof(*tatung_evt)) {
+	const struct tatung_ts_event *evt = (const struct tatung_ts_event *)rec;
 
-			if (tatung_evt->x1==240 || tatung_evt->x2==240 || tatung_evt->y1==240 || tatung_evt->y2==240)
-			{
-				ret = nr;
-				return ret;
-			}
-
-			samp->x = (tatung_evt->x1)*31 + (tatung_evt->x2)-64;
-			samp->y = (tatung_evt->y1)*31 + (tatung_evt->y2)-192;
-			samp->pressure=1;
-			//samp->pressure = tatung_evt->pressure;
-
-#ifdef DEBUG
-        fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
-#endif /*DEBUG*/
-			gettimeofday(&samp->tv,NULL);
-			samp++;
-			tatung_evt++;
-			ret -= sizeof(*tatung_evt);
-		}
+	if (evt->x1 == 240 || evt->x2 == 240 || evt->y1 == 240 || evt->y2 == 240) {
+		samp->x = 0;
+		samp->y = 0;
+		samp->pressure = 0;
 	} else {
-		return -1;
+		samp->x = (evt->x1)*31 + (evt->x2)-64;
+		samp->y = (evt->y1)*31 + (evt->y2)-192;
+		samp->pressure = 1;
 	}
-
-	samp->pressure=0;
-	ret = nr;
-	return ret;
+	return 1;
 }
 
-static const struct tslib_ops tatung_ops =
-{
-	.read	= tatung_read,
+static const struct ts_event_layout tatung_layout = {
+	.size		= sizeof(struct tatung_ts_event),
+	.time_kind	= TS_EVENT_TIME_NOW,
+	.decode		= tatung_decode,
 };
 
 TSAPI struct tslib_module_info *tatung_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
-
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
-		return NULL;
-
-	m->ops = &tatung_ops;
-	return m;
+	return ts_event_raw_init(dev, &tatung_layout);
 }
 
 #ifndef TSLIB_STATIC_TATUNG_MODULE
@@ -7,6 +7,7 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-serial.h"
 
 /*
  * TouchKit RS232 driver
@@ -23,20 +24,23 @@
  * Problem: sometimes some packets overlap, so it is possible
  * to find a new packet in the middle of another packet.
  * -> check that no byte in the packet (but the first one)
- *    have its first bit set (0x80 = start)
+ *    have its first bit set (0x80 = start), which the framing
+ *    engine does for us
  *
  * This file is placed under the LGPL.  Please see the file
  * COPYING for more details.
 */
 
-enum {
-	PACKET_SIZE = 5,
-	BUFFER_SIZE = 100,
-	PACKET_SIGNATURE = 0x81
+/* a header byte is 0x80 or 0x81, the others never have bit 7 set */
+static const struct ts_serial_packet touchkit_packets[] = {
+	{ 0xfe, 0x80, 5, 0x80 },
 };
 
-/* Is is a start of packet ? */
-#define IsStart(x) (((x)|1) == PACKET_SIGNATURE)
+struct tslib_touchkit {
+	struct tslib_module_info module;
+	int initDone;
+	struct ts_serial serial;
+};
 
 static int touchkit_init(int dev)
 {
@@ -59,99 +63,72 @@ static int touchkit_init(int dev)
 static int touchkit_read(struct tslib_module_info *inf, struct ts_sample *samp,
 			 int nr)
 {
-	static int initDone = 0;
-	static unsigned char buffer[BUFFER_SIZE];	/* enough space for 2 "normal" packets */
-	static int pos = 0;
-
+	struct tslib_touchkit *tk = (struct tslib_touchkit *)inf;
 	struct tsdev *ts = inf->dev;
+	const unsigned char *data;
+	int total = 0;
+	int type;
 
-	if (initDone == 0) {
-		initDone = touchkit_init(ts->fd);
-		if (initDone == -1)
+	if (tk->initDone == 0) {
+		tk->initDone = touchkit_init(ts->fd);
+		if (tk->initDone == -1)
 			return -1;
 	}
-	/* read some new bytes (enough for 1 normal packet) */
-	int ret = read(ts->fd, buffer + pos, PACKET_SIZE);
-	if (ret <= 0)
-		return -1;
-
-	pos += ret;
-	if (pos < PACKET_SIZE)
-		return 0;
 
-	/* find start */
-	int p;
-	int total = 0;
-	for (p = 0; p < pos; ++p)
-		if (IsStart(buffer[p])) {
-			/* we have enough data for a packet ? */
-			if (p + PACKET_SIZE > pos) {
-				if (p > 0) {
-                                        /*
-					 * we have found a start >0, it means we have garbage
-					 * at beginning of buffer
-					 * so let's shift data to ignore this garbage
-                                         */
-					memcpy(buffer, buffer + p, pos - p);
-					pos -= p;
-				}
+	while (total < nr) {
+		data = ts_serial_next(&tk->serial, &type);
+		if (!data) {
+			/* only wait for bytes while there is nothing to return */
+			if (total)
 				break;
-			}
-
-			unsigned char *data = buffer + p;
+			if (ts_serial_fill(&tk->serial, ts->fd) <= 0)
+				return -1;
+			continue;
+		}
 
-			/* check if all bytes are ok (no 'start' embedded) */
-			int q;
-			for (q = 1; q < PACKET_SIZE; ++q)
-				if (IsStart(buffer[p + q]))
-					break;
-			if (q < PACKET_SIZE) {
-#ifdef DEBUG
-				fprintf(stderr,
-					"Start found within packet [%X %X %X %X %X] ignore %d bytes\n",
-					data[0], data[1], data[2], data[3],
-					data[4], q);
-#endif
-				p += q - 1;
-				continue;
-			}
-			/* now let's decode it */
-			samp->x = (data[1] & 0x000F) << 7 | (data[2] & 0x007F);
-			samp->y =
-			    ((data[3] & 0x000F) << 7 | (data[4] & 0x007F));
-			samp->pressure = (data[0] & 1) ? 200 : 0;
-			gettimeofday(&samp->tv, NULL);
+		/* now let's decode it */
+		samp->x = (data[1] & 0x000F) << 7 | (data[2] & 0x007F);
+		samp->y = ((data[3] & 0x000F) << 7 | (data[4] & 0x007F));
+		samp->pressure = (data[0] & 1) ? 200 : 0;
+		gettimeofday(&samp->tv, NULL);
 #ifdef DEBUG
-			fprintf(stderr,
-				"RAW -------------------------> data=[%X %X %X %X %X]  x=%d y=%d pres=%d\n",
-				data[0], data[1], data[2], data[3], data[4],
-				samp->x, samp->y, samp->pressure);
+		fprintf(stderr,
+			"RAW -------------------------> data=[%X %X %X %X %X]  x=%d y=%d pres=%d\n",
+			data[0], data[1], data[2], data[3], data[4],
+			samp->x, samp->y, samp->pressure);
 #endif
-			samp++;
-
-			/* now remove it */
-			memcpy(buffer, buffer + p + PACKET_SIZE,
-			       pos - p - PACKET_SIZE);
-			pos -= p + PACKET_SIZE;
-			total = 1;
-			break;
-		}
+		samp++;
+		total++;
+	}
 
 	return total;
 }
 
+static int touchkit_fini(struct tslib_module_info *inf)
+{
+	free(inf);
+	return 0;
+}
+
 static const struct tslib_ops touchkit_ops = {
 	.read = touchkit_read,
+	.fini = touchkit_fini,
 };
 
-TSAPI struct tslib_module_info *mod_init(struct tsdev *dev, const char *params)
+TSAPI struct tslib_module_info *touchkit_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
+	struct tslib_touchkit *tk;
 
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
+	tk = malloc(sizeof(struct tslib_touchkit));
+	if (tk == NULL)
 		return NULL;
 
-	m->ops = &touchkit_ops;
-	return m;
+	memset(tk, 0, sizeof(struct tslib_touchkit));
+	tk->module.ops = &touchkit_ops;
+	ts_serial_init(&tk->serial, touchkit_packets, 1);
+	return &tk->module;
 }
+
+#ifndef TSLIB_STATIC_TOUCHKIT_MODULE
+	TSLIB_MODULE_INIT(touchkit_mod_init);
+#endif
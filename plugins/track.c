@@ -0,0 +1,381 @@
+/*
+ *  tslib/plugins/track.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Follows the contacts of a multi-touch device from frame to frame and
+ * gives each an id that stays the same from its down to its up.  The
+ * samples of one frame are those with the same timestamp, as the raw
+ * modules of heatmap controllers hand them out.  A contact is matched
+ * to the nearest one of the frame before within gate; with few contacts
+ * greedily, with more by the Hungarian method, which finds the pairing
+ * that moves them the least in all.  Everything is kept in fixed
+ * arrays, nothing is allocated while reading.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "config.h"
+#include "tslib.h"
+#include "tslib-filter.h"
+
+#define TRACK_IN	64	/* samples read from below at once */
+#define TRACK_OUT	(2 * TS_MAX_CONTACTS)	/* handed out for a frame */
+#define TRACK_FAR	(1LL << 48)	/* a pair outside the gate, or further */
+#define TRACK_INF	(LLONG_MAX / 4)
+
+struct track_slot {
+	int		active;
+	struct ts_sample samp;		/* where it was last seen */
+};
+
+struct tslib_track {
+	struct tslib_module_info module;
+	long long	gate;		/* squared, 0 for none */
+	int		greedy;		/* contacts matched greedily, at most */
+
+	struct track_slot slot[TS_MAX_CONTACTS];	/* by id */
+	int		nr_active;
+
+	/* read from below, not yet tracked */
+	struct ts_contact in[TRACK_IN];
+	int		in_head;
+	int		in_tail;
+
+	/* the contacts of the last frame, not yet handed out */
+	struct ts_contact out[TRACK_OUT];
+	char		release[TRACK_OUT];	/* the last contact went up */
+	int		out_head;
+	int		out_tail;
+};
+
+static long long track_dist(const struct ts_sample *a, const struct ts_sample *b)
+{
+	long long dx = a->x - b->x;
+	long long dy = a->y - b->y;
+	long long d = dx * dx + dy * dy;
+
+	/* so that all of them summed cannot overflow */
+	return d < TRACK_FAR ? d : TRACK_FAR - 1;
+}
+
+/*
+ * Pairs the closest track and contact, then the closest of the rest,
+ * and so on, until no pair is left within the gate.
+ */
+static void track_greedy(long long cost[][TS_MAX_CONTACTS], int nr_t, int nr_c,
+			 int *match)
+{
+	int used[TS_MAX_CONTACTS] = { 0 };
+	int t, c, bt, bc;
+	long long best;
+
+	for (;;) {
+		best = TRACK_FAR;
+		bt = bc = -1;
+		for (t = 0; t < nr_t; t++) {
+			if (match[t] >= 0)
+				continue;
+			for (c = 0; c < nr_c; c++) {
+				if (!used[c] && cost[t][c] < best) {
+					best = cost[t][c];
+					bt = t;
+					bc = c;
+				}
+			}
+		}
+		if (bt < 0)
+			return;
+		match[bt] = bc;
+		used[bc] = 1;
+	}
+}
+
+/*
+ * The Hungarian method, with potentials, on the square of the larger
+ * count: O(n^3) for n contacts, at most TS_MAX_CONTACTS.  Pairs with a
+ * dummy row or column cost nothing and are left unmatched, as are those
+ * outside the gate.
+ */
+static void track_hungarian(long long cost[][TS_MAX_CONTACTS], int nr_t,
+			    int nr_c, int *match)
+{
+	long long u[TS_MAX_CONTACTS + 1], v[TS_MAX_CONTACTS + 1];
+	long long minv[TS_MAX_CONTACTS + 1];
+	int p[TS_MAX_CONTACTS + 1], way[TS_MAX_CONTACTS + 1];
+	char used[TS_MAX_CONTACTS + 1];
+	int n = nr_t > nr_c ? nr_t : nr_c;
+	int i, j, i0, j0, j1;
+	long long cur, delta;
+
+	memset(u, 0, sizeof(u));
+	memset(v, 0, sizeof(v));
+	memset(p, 0, sizeof(p));
+	memset(way, 0, sizeof(way));
+
+	for (i = 1; i <= n; i++) {
+		p[0] = i;
+		j0 = 0;
+		for (j = 0; j <= n; j++) {
+			minv[j] = TRACK_INF;
+			used[j] = 0;
+		}
+		do {
+			used[j0] = 1;
+			i0 = p[j0];
+			delta = TRACK_INF;
+			j1 = 0;
+			for (j = 1; j <= n; j++) {
+				if (used[j])
+					continue;
+				cur = (i0 <= nr_t && j <= nr_c ? cost[i0 - 1][j - 1] : 0) -
+				      u[i0] - v[j];
+				if (cur < minv[j]) {
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (j = 0; j <= n; j++) {
+				if (used[j]) {
+					u[p[j]] += delta;
+					v[j] -= delta;
+				} else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+		do {
+			j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0);
+	}
+
+	for (j = 1; j <= nr_c; j++)
+		if (p[j] && p[j] <= nr_t && cost[p[j] - 1][j - 1] < TRACK_FAR)
+			match[p[j] - 1] = j - 1;
+}
+
+static void track_emit(struct tslib_track *t, const struct ts_sample *s,
+		       int id, int state)
+{
+	struct ts_contact *c = &t->out[t->out_tail];
+
+	c->samp = *s;
+	c->id = id;
+	c->state = state;
+	t->release[t->out_tail] = 0;
+	t->out_tail++;
+}
+
+/*
+ * Matches the contacts of a frame to the tracks, and queues the ups of
+ * the tracks that found none, then the moves, then the downs.
+ */
+static void track_frame(struct tslib_track *t, const struct ts_contact *in, int nr)
+{
+	long long cost[TS_MAX_CONTACTS][TS_MAX_CONTACTS];
+	int ids[TS_MAX_CONTACTS], match[TS_MAX_CONTACTS];
+	int taken[TS_MAX_CONTACTS] = { 0 };
+	const struct ts_sample *cur[TS_MAX_CONTACTS];
+	struct timeval tv = in[0].samp.tv;
+	int nr_t = 0, nr_c = 0, k, c, first_up = -1;
+
+	for (k = 0; k < nr && nr_c < TS_MAX_CONTACTS; k++)
+		if (in[k].samp.pressure && in[k].state != TS_CONTACT_UP)
+			cur[nr_c++] = &in[k].samp;
+	for (k = 0; k < TS_MAX_CONTACTS; k++) {
+		if (!t->slot[k].active)
+			continue;
+		ids[nr_t] = k;
+		match[nr_t] = -1;
+		for (c = 0; c < nr_c; c++) {
+			cost[nr_t][c] = track_dist(&t->slot[k].samp, cur[c]);
+			if (t->gate && cost[nr_t][c] > t->gate)
+				cost[nr_t][c] = TRACK_FAR;
+		}
+		nr_t++;
+	}
+
+	if (nr_t && nr_c) {
+		if (nr_t <= t->greedy && nr_c <= t->greedy)
+			track_greedy(cost, nr_t, nr_c, match);
+		else
+			track_hungarian(cost, nr_t, nr_c, match);
+	}
+
+	t->out_head = t->out_tail = 0;
+	for (k = 0; k < nr_t; k++) {
+		if (match[k] >= 0)
+			continue;
+		t->slot[ids[k]].active = 0;
+		t->slot[ids[k]].samp.pressure = 0;
+		t->slot[ids[k]].samp.tv = tv;
+		t->nr_active--;
+		if (first_up < 0)
+			first_up = t->out_tail;
+		track_emit(t, &t->slot[ids[k]].samp, ids[k], TS_CONTACT_UP);
+	}
+	for (k = 0; k < nr_t; k++) {
+		if (match[k] < 0)
+			continue;
+		taken[match[k]] = 1;
+		t->slot[ids[k]].samp = *cur[match[k]];
+		track_emit(t, cur[match[k]], ids[k], TS_CONTACT_MOVE);
+	}
+	for (c = 0; c < nr_c; c++) {
+		if (taken[c])
+			continue;
+		for (k = 0; k < TS_MAX_CONTACTS && t->slot[k].active; k++)
+			;
+		if (k == TS_MAX_CONTACTS)
+			break;
+		t->slot[k].active = 1;
+		t->slot[k].samp = *cur[c];
+		t->nr_active++;
+		track_emit(t, cur[c], k, TS_CONTACT_DOWN);
+	}
+
+	if (!t->nr_active && first_up >= 0)
+		t->release[first_up] = 1;
+}
+
+/*
+ * Hands out the contacts of as many frames as fit in nr, reading from
+ * below only while nothing came out yet, so as not to block with
+ * contacts in hand.
+ */
+static int track_read_mt(struct tslib_module_info *info, struct ts_contact *c, int nr)
+{
+	struct tslib_track *t = (struct tslib_track *)info;
+	int n = 0, end, ret;
+
+	while (n < nr) {
+		if (t->out_head == t->out_tail) {
+			if (t->in_head == t->in_tail) {
+				if (n)
+					break;
+				ret = tslib_read_mt(info->next, t->in, TRACK_IN);
+				if (ret <= 0)
+					return ret;
+				t->in_head = 0;
+				t->in_tail = ret;
+			}
+			for (end = t->in_head + 1; end < t->in_tail; end++)
+				if (timercmp(&t->in[end].samp.tv,
+					     &t->in[t->in_head].samp.tv, !=))
+					break;
+			track_frame(t, &t->in[t->in_head], end - t->in_head);
+			t->in_head = end;
+			continue;
+		}
+		c[n++] = t->out[t->out_head++];
+	}
+	return n;
+}
+
+/*
+ * Without ids, one contact going up while others stay down is not a
+ * release, only the last one is.
+ */
+static int track_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+{
+	struct tslib_track *t = (struct tslib_track *)info;
+	struct ts_contact c;
+	int n = 0, ret;
+
+	while (n < nr) {
+		ret = track_read_mt(info, &c, 1);
+		if (ret < 0)
+			return n ? n : ret;
+		if (!ret)
+			break;
+		if (c.state == TS_CONTACT_UP && !t->release[t->out_head - 1])
+			continue;
+		samp[n++] = c.samp;
+		if (t->out_head == t->out_tail && t->in_head == t->in_tail)
+			break;
+	}
+	return n;
+}
+
+static int track_fini(struct tslib_module_info *info)
+{
+	free(info);
+	return 0;
+}
+
+static const struct tslib_ops track_ops =
+{
+	.read		= track_read,
+	.fini		= track_fini,
+	.read_mt	= track_read_mt,
+};
+
+static int track_limit(struct tslib_module_info *inf, char *str, void *data)
+{
+	struct tslib_track *t = (struct tslib_track *)inf;
+	unsigned long v;
+	int err = errno;
+
+	v = strtoul(str, NULL, 0);
+
+	if (v == ULONG_MAX && errno == ERANGE)
+		return -1;
+
+	errno = err;
+	switch ((int)(long)data) {
+	case 1:
+		/* further than any panel reaches is as good as none */
+		t->gate = v < (1UL << 20) ? (long long)v * v : 0;
+		break;
+	case 2:
+		t->greedy = v;
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+static const struct tslib_vars track_vars[] =
+{
+	{ "gate",	(void *)1, track_limit },
+	{ "greedy",	(void *)2, track_limit },
+};
+
+#define NR_VARS (sizeof(track_vars) / sizeof(track_vars[0]))
+
+TSAPI struct tslib_module_info *track_mod_init(struct tsdev *dev, const char *params)
+{
+	struct tslib_track *t;
+
+	t = malloc(sizeof(struct tslib_track));
+	if (t == NULL)
+		return NULL;
+
+	memset(t, 0, sizeof(struct tslib_track));
+	t->module.ops = &track_ops;
+	t->gate = 100 * 100;
+	t->greedy = 3;
+
+	if (tslib_parse_vars(&t->module, track_vars, NR_VARS, params)) {
+		free(t);
+		return NULL;
+	}
+
+	return &t->module;
+}
+
+#ifndef TSLIB_STATIC_TRACK_MODULE
+	TSLIB_MODULE_INIT(track_mod_init);
+#endif
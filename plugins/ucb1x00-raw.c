@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "tslib-private.h"
+#include "tslib-event.h"
 
 struct ucb1x00_ts_event  {   /* Used in UCB1x00 style touchscreens */
 	unsigned short pressure;
@@ -13,52 +14,18 @@ struct ucb1x00_ts_event  {   /* Used in UCB1x00 style touchscreens */
 	struct timeval stamp;
 };
 
-static int ucb1x00_read(struct tslib_module_info *inf, struct ts_sample *samp, int nr)
-{
-	struct tsdev *ts = inf->dev;
-	struct ucb1x00_ts_event *ucb1x00_evt;
-	int ret;
-	int total = 0;
-	ucb1x00_evt = alloca(sizeof(*ucb1x00_evt) * nr);
-	ret = read(ts->fd, ucb1x00_evt, sizeof(*ucb1x00_evt) * nr);
-	if(ret > 0) {
-		int nr = ret / sizeof(*ucb1x00_evt);
-		while(ret >= (int)sizeof(*ucb1x00_evt)) {
-			samp->x = ucb1x00_evt->x;
-			samp->y = ucb1x00_evt->y;
-			samp->pressure = ucb1x00_evt->pressure;
-#ifdef DEBUG
-        fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
-#endif /*DEBUG*/
-			samp->tv.tv_usec = ucb1x00_evt->stamp.tv_usec;
-			samp->tv.tv_sec = ucb1x00_evt->stamp.tv_sec;
-			samp++;
-			ucb1x00_evt++;
-			ret -= sizeof(*ucb1x00_evt);
-		}
-	} else {
-		return -1;
-	}
-
-	ret = nr;
-	return ret;
-}
-
-static const struct tslib_ops ucb1x00_ops =
-{
-	.read	= ucb1x00_read,
+static const struct ts_event_layout ucb1x00_layout = {
+	.size		= sizeof(struct ucb1x00_ts_event),
+	.x		= TS_EVENT_FIELD(struct ucb1x00_ts_event, x),
+	.y		= TS_EVENT_FIELD(struct ucb1x00_ts_event, y),
+	.pressure	= TS_EVENT_FIELD(struct ucb1x00_ts_event, pressure),
+	.time_kind	= TS_EVENT_TIME_TIMEVAL,
+	.time		= { offsetof(struct ucb1x00_ts_event, stamp) },
 };
 
 TSAPI struct tslib_module_info *ucb1x00_mod_init(struct tsdev *dev, const char *params)
 {
-	struct tslib_module_info *m;
-
-	m = malloc(sizeof(struct tslib_module_info));
-	if (m == NULL)
-		return NULL;
-
-	m->ops = &ucb1x00_ops;
-	return m;
+	return ts_event_raw_init(dev, &ucb1x00_layout);
 }
 
 #ifndef TSLIB_STATIC_UCB1X00_MODULE
@@ -31,16 +31,30 @@
 #include "tslib.h"
 #include "tslib-filter.h"
 
+#define VAR_IN		64	/* contacts read from below at once */
+
+/*
+ * The state of each contact, by its id; contacts without one, as with
+ * ts_read(), all use the first.
+ */
 struct tslib_variance {
 	struct tslib_module_info module;
 	int delta;
-        struct ts_sample last;
-        struct ts_sample noise;
-	unsigned int flags;
+        struct ts_sample last[TS_MAX_CONTACTS];
+        struct ts_sample noise[TS_MAX_CONTACTS];
+	unsigned int flags[TS_MAX_CONTACTS];
+	int id[TS_MAX_CONTACTS];	/* of the contact last seen */
 #define VAR_PENDOWN		0x00000001
 #define VAR_LASTVALID		0x00000002
 #define VAR_NOISEVALID		0x00000004
 #define VAR_SUBMITNOISE		0x00000008
+#define VAR_DOWNSENT		0x00000010
+
+	/* read from below, not yet looked at */
+	struct ts_contact in[VAR_IN];
+	int in_head;
+	int in_tail;
+	struct timeval tv;		/* of the frame being looked at */
 };
 
 static int sqr (int x)
@@ -48,72 +62,194 @@ static int sqr (int x)
 	return x * x;
 }
 
+/*
+ * Runs one sample of contact i through the state machine.  Returns 1 if
+ * it put a sample in out, which may be where in was.  A sample to be
+ * looked at again is left in noise[i] with VAR_SUBMITNOISE set.
+ */
+static int variance_sample(struct tslib_variance *var, int i,
+			   const struct ts_sample *in, struct ts_sample *out)
+{
+	struct ts_sample cur = *in;
+	int count = 0, dist;
+
+	if (cur.pressure == 0) {
+		/* Flush the queue immediately when the pen is just
+		 * released, otherwise the previous layer will
+		 * get the pen up notification too late. This 
+		 * will happen if info->next->ops->read() blocks.
+		 */
+		if (var->flags[i] & VAR_PENDOWN) {
+			var->flags[i] |= VAR_SUBMITNOISE;
+			var->noise[i] = cur;
+		}
+		/* Reset the state machine on pen up events. */
+		var->flags[i] &= ~(VAR_PENDOWN | VAR_NOISEVALID | VAR_LASTVALID);
+		goto acceptsample;
+	} else
+		var->flags[i] |= VAR_PENDOWN;
+
+	if (!(var->flags[i] & VAR_LASTVALID)) {
+		var->last[i] = cur;
+		var->flags[i] |= VAR_LASTVALID;
+		return 0;
+	}
+
+	if (var->flags[i] & VAR_PENDOWN) {
+		/* Compute the distance between last sample and current */
+		dist = sqr (cur.x - var->last[i].x) +
+		       sqr (cur.y - var->last[i].y);
+
+		if (dist > var->delta) {
+			/* Do we suspect the previous sample was a noise? */
+			if (var->flags[i] & VAR_NOISEVALID) {
+				/* Two "noises": it's just a quick pen movement */
+				*out = var->last[i] = var->noise[i];
+				var->flags[i] = (var->flags[i] & ~VAR_NOISEVALID) |
+					VAR_SUBMITNOISE;
+				count = 1;
+			} else
+				var->flags[i] |= VAR_NOISEVALID;
+
+			/* The pen jumped too far, maybe it's a noise ... */
+			var->noise[i] = cur;
+			return count;
+		} else
+			var->flags[i] &= ~VAR_NOISEVALID;
+	}
+
+acceptsample:
+#ifdef DEBUG
+	fprintf(stderr,"VARIANCE----------------> %d %d %d\n",
+		var->last[i].x, var->last[i].y, var->last[i].pressure);
+#endif
+	*out = var->last[i];
+	var->last[i] = cur;
+	return 1;
+}
+
 static int variance_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
 {
 	struct tslib_variance *var = (struct tslib_variance *)info;
 	struct ts_sample cur;
-	int count = 0, dist;
+	int count = 0;
 
 	while (count < nr) {
-		if (var->flags & VAR_SUBMITNOISE) {
-			cur = var->noise;
-			var->flags &= ~VAR_SUBMITNOISE;
+		if (var->flags[0] & VAR_SUBMITNOISE) {
+			cur = var->noise[0];
+			var->flags[0] &= ~VAR_SUBMITNOISE;
 		} else {
 			if (info->next->ops->read(info->next, &cur, 1) < 1)
 				return count;
 		}
 
-		if (cur.pressure == 0) {
-			/* Flush the queue immediately when the pen is just
-			 * released, otherwise the previous layer will
-			 * get the pen up notification too late. This 
-			 * will happen if info->next->ops->read() blocks.
-			 */
-			if (var->flags & VAR_PENDOWN) {
-				var->flags |= VAR_SUBMITNOISE;
-				var->noise = cur;
-			}
-			/* Reset the state machine on pen up events. */
-			var->flags &= ~(VAR_PENDOWN | VAR_NOISEVALID | VAR_LASTVALID);
-			goto acceptsample;
-		} else
-			var->flags |= VAR_PENDOWN;
+		count += variance_sample(var, 0, &cur, samp + count);
+	}
+
+	return count;
+}
+
+/*
+ * As the state machine holds samples back, the state of a contact is
+ * made again from what is handed out.
+ */
+static void variance_contact(struct tslib_variance *var, int i,
+			     struct ts_contact *c)
+{
+	c->id = var->id[i];
+	if (c->samp.pressure == 0) {
+		c->state = TS_CONTACT_UP;
+		var->flags[i] &= ~VAR_DOWNSENT;
+	} else if (c->id >= 0 && !(var->flags[i] & VAR_DOWNSENT)) {
+		c->state = TS_CONTACT_DOWN;
+		var->flags[i] |= VAR_DOWNSENT;
+	} else {
+		c->state = TS_CONTACT_MOVE;
+	}
+}
+
+/* Looks at the sample held back of contact i again, if there is one */
+static int variance_flush(struct tslib_variance *var, int i, struct ts_contact *c)
+{
+	struct ts_sample cur;
+
+	if (!(var->flags[i] & VAR_SUBMITNOISE))
+		return 0;
+	cur = var->noise[i];
+	var->flags[i] &= ~VAR_SUBMITNOISE;
+	if (!variance_sample(var, i, &cur, &c->samp))
+		return 0;
+	variance_contact(var, i, c);
+	return 1;
+}
+
+/* The samples held back of all contacts, as many as fit */
+static int variance_flush_all(struct tslib_variance *var, struct ts_contact *c, int nr)
+{
+	int i, count = 0;
+
+	for (i = 0; i < TS_MAX_CONTACTS && count < nr; i++)
+		count += variance_flush(var, i, &c[count]);
+	return count;
+}
+
+static int variance_pending(struct tslib_variance *var)
+{
+	int i;
 
-		if (!(var->flags & VAR_LASTVALID)) {
-			var->last = cur;
-			var->flags |= VAR_LASTVALID;
+	for (i = 0; i < TS_MAX_CONTACTS; i++)
+		if (var->flags[i] & VAR_SUBMITNOISE)
+			return 1;
+	return 0;
+}
+
+/*
+ * Hands out the contacts in the order they came: a sample held back is
+ * looked at again before the next one of its contact, and what is held
+ * back of a frame before the next frame, or once all that was read is
+ * through.  Read a contact at a time, only each contact stays in order.
+ * A contact is only taken from the input once there is room for what
+ * it hands out.
+ */
+static int variance_read_mt(struct tslib_module_info *info, struct ts_contact *c, int nr)
+{
+	struct tslib_variance *var = (struct tslib_variance *)info;
+	const struct ts_contact *in;
+	int count = 0, i, ret;
+
+	while (count < nr) {
+		if (var->in_head == var->in_tail) {
+			/* the frame is over, as far as is known */
+			count += variance_flush_all(var, c + count, nr - count);
+			if (count)
+				break;
+			ret = tslib_read_mt(info->next, var->in,
+					    nr < VAR_IN ? nr : VAR_IN);
+			if (ret <= 0)
+				return ret;
+			var->in_head = 0;
+			var->in_tail = ret;
 			continue;
 		}
 
-		if (var->flags & VAR_PENDOWN) {
-			/* Compute the distance between last sample and current */
-			dist = sqr (cur.x - var->last.x) +
-			       sqr (cur.y - var->last.y);
-
-			if (dist > var->delta) {
-				/* Do we suspect the previous sample was a noise? */
-				if (var->flags & VAR_NOISEVALID) {
-					/* Two "noises": it's just a quick pen movement */
-					samp [count++] = var->last = var->noise;
-					var->flags = (var->flags & ~VAR_NOISEVALID) |
-						VAR_SUBMITNOISE;
-				} else
-					var->flags |= VAR_NOISEVALID;
-
-				/* The pen jumped too far, maybe it's a noise ... */
-				var->noise = cur;
-				continue;
-			} else
-				var->flags &= ~VAR_NOISEVALID;
+		in = &var->in[var->in_head];
+		if (timercmp(&in->samp.tv, &var->tv, !=)) {
+			count += variance_flush_all(var, c + count, nr - count);
+			if (variance_pending(var))
+				break;
+			var->tv = in->samp.tv;
+			continue;
 		}
 
-acceptsample:
-#ifdef DEBUG
-		fprintf(stderr,"VARIANCE----------------> %d %d %d\n",
-			var->last.x, var->last.y, var->last.pressure);
-#endif
-		samp [count++] = var->last;
-		var->last = cur;
+		i = in->id >= 0 && in->id < TS_MAX_CONTACTS ? in->id : 0;
+		if (var->flags[i] & VAR_SUBMITNOISE) {
+			count += variance_flush(var, i, &c[count]);
+			continue;
+		}
+		var->id[i] = in->id;
+		var->in_head++;
+		if (variance_sample(var, i, &in->samp, &c[count].samp))
+			variance_contact(var, i, &c[count++]);
 	}
 
 	return count;
@@ -127,8 +263,9 @@ static int variance_fini(struct tslib_module_info *info)
 
 static const struct tslib_ops variance_ops =
 {
-	.read	= variance_read,
-	.fini	= variance_fini,
+	.read		= variance_read,
+	.fini		= variance_fini,
+	.read_mt	= variance_read_mt,
 };
 
 static int variance_limit(struct tslib_module_info *inf, char *str, void *data)
@@ -169,10 +306,10 @@ TSAPI struct tslib_module_info *variance_mod_init(struct tsdev *dev, const char
 	if (var == NULL)
 		return NULL;
 
+	memset(var, 0, sizeof(struct tslib_variance));
 	var->module.ops = &variance_ops;
 
 	var->delta = 30;
-	var->flags = 0;
 
 	if (tslib_parse_vars(&var->module, variance_vars, NR_VARS, params)) {
 		free(var);
@@ -0,0 +1,126 @@
+/*
+ *  tslib/src/ts_caps.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Probe what the touchscreen device can report, once, when it is
+ * opened.  Modules and applications read the snapshot instead of
+ * asking the kernel again.
+ */
+#include "config.h"
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "tslib-private.h"
+
+#ifndef EV_CNT
+#define EV_CNT	(EV_MAX+1)
+#endif
+#ifndef ABS_CNT
+#define ABS_CNT	(ABS_MAX+1)
+#endif
+#ifndef KEY_CNT
+#define KEY_CNT	(KEY_MAX+1)
+#endif
+#ifndef ABS_MT_SLOT
+#define ABS_MT_SLOT		0x2f
+#endif
+#ifndef ABS_MT_POSITION_X
+#define ABS_MT_POSITION_X	0x35
+#define ABS_MT_POSITION_Y	0x36
+#endif
+
+#define DIV_ROUND_UP(n,d) (((n) + (d) - 1) / (d))
+#define BIT_MASK(nr)            (1UL << ((nr) % BITS_PER_LONG))
+#define BIT_WORD(nr)            ((nr) / BITS_PER_LONG)
+#define BITS_PER_BYTE           8
+#define BITS_PER_LONG           (sizeof(long) * BITS_PER_BYTE)
+#define BITS_TO_LONGS(nr)       DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
+
+#define test_bit(nr, addr)	(!!((addr)[BIT_WORD(nr)] & BIT_MASK(nr)))
+
+static void get_abs(struct tsdev *ts, int code, struct ts_absinfo *info)
+{
+	struct input_absinfo abs;
+
+	if (ioctl(ts->fd, EVIOCGABS(code), &abs) < 0)
+		return;
+	info->value = abs.value;
+	info->minimum = abs.minimum;
+	info->maximum = abs.maximum;
+	info->fuzz = abs.fuzz;
+	info->flat = abs.flat;
+	info->resolution = abs.resolution;
+}
+
+/*
+ * Devices that are not event devices, like the ones the legacy raw
+ * modules drive, end up with no flags set.
+ */
+void ts_probe_caps(struct tsdev *ts)
+{
+	struct ts_caps *caps = &ts->caps;
+	unsigned long evbit[BITS_TO_LONGS(EV_CNT)];
+	unsigned long absbit[BITS_TO_LONGS(ABS_CNT)];
+	unsigned long keybit[BITS_TO_LONGS(KEY_CNT)];
+	int version;
+
+	memset(caps, 0, sizeof(*caps));
+	if (ioctl(ts->fd, EVIOCGVERSION, &version) < 0)
+		return;
+	caps->flags = TS_CAP_EVDEV;
+	caps->version = version;
+
+	memset(evbit, 0, sizeof(evbit));
+	memset(absbit, 0, sizeof(absbit));
+	memset(keybit, 0, sizeof(keybit));
+
+	if (version < EV_VERSION)
+		caps->flags |= TS_CAP_OLD_API;
+
+	if (ioctl(ts->fd, EVIOCGBIT(0, sizeof(evbit)), evbit) < 0)
+		return;
+	if (test_bit(EV_ABS, evbit) &&
+	    ioctl(ts->fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit) < 0)
+		return;
+	if (test_bit(EV_KEY, evbit) &&
+	    ioctl(ts->fd, EVIOCGBIT(EV_KEY, sizeof(keybit)), keybit) < 0)
+		return;
+
+	if (test_bit(EV_SYN, evbit))
+		caps->flags |= TS_CAP_SYN;
+	if (test_bit(EV_KEY, evbit))
+		caps->flags |= TS_CAP_KEY;
+	if (test_bit(EV_ABS, evbit))
+		caps->flags |= TS_CAP_ABS;
+	if (test_bit(BTN_TOUCH, keybit))
+		caps->flags |= TS_CAP_BTN_TOUCH;
+
+	if (test_bit(ABS_X, absbit) && test_bit(ABS_Y, absbit)) {
+		caps->flags |= TS_CAP_ABS_XY;
+		get_abs(ts, ABS_X, &caps->x);
+		get_abs(ts, ABS_Y, &caps->y);
+	}
+	if (test_bit(ABS_PRESSURE, absbit)) {
+		caps->flags |= TS_CAP_PRESSURE;
+		get_abs(ts, ABS_PRESSURE, &caps->pressure);
+	}
+	if (test_bit(ABS_MT_POSITION_X, absbit) &&
+	    test_bit(ABS_MT_POSITION_Y, absbit)) {
+		caps->flags |= TS_CAP_MT;
+		get_abs(ts, ABS_MT_POSITION_X, &caps->mt_x);
+		get_abs(ts, ABS_MT_POSITION_Y, &caps->mt_y);
+	}
+	if (test_bit(ABS_MT_SLOT, absbit)) {
+		caps->flags |= TS_CAP_MT_SLOT;
+		get_abs(ts, ABS_MT_SLOT, &caps->mt_slot);
+	}
+}
+
+const struct ts_caps *ts_get_caps(struct tsdev *ts)
+{
+	return &ts->caps;
+}
@@ -22,11 +22,11 @@ int ts_close(struct tsdev *ts)
 {
 	void *handle;
 	int ret;
-	struct tslib_module_info *info, *prev;
+	struct tslib_module_info *info, *next;
 
-	for(info = ts->list, prev = info;
-	    info != NULL;
-	    info = prev->next, prev = info) {
+	/* fini frees the module, so step past it first */
+	for (info = ts->list; info != NULL; info = next) {
+		next = info->next;
 		handle = info->handle;
 		info->ops->fini(info);
 		if (handle)
@@ -34,6 +34,8 @@ int ts_close(struct tsdev *ts)
 	}
 
 	ret = close(ts->fd);
+	ts_coalesce_free(ts);
+	ts_vsync_free(ts);
 	free(ts);
 
 	return ret;
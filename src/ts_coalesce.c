@@ -0,0 +1,135 @@
+/*
+ *  tslib/src/ts_coalesce.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Reads for applications that fall behind: everything the device has
+ * is read at once, and each run of moves is handed out as its latest
+ * sample.  Presses and releases always come out on their own, so what
+ * an application has to catch up on is one sample for each of them.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "tslib-private.h"
+
+#define TS_COALESCE_BUF		64	/* read from the modules at once */
+
+struct ts_coalesce {
+	int		on;		/* for ts_read() */
+	int		pressed;	/* the last sample taken was */
+	/* read, not yet handed out */
+	struct ts_sample buf[TS_COALESCE_BUF];
+	int		head;
+	int		tail;
+};
+
+int ts_coalesce_set(struct tsdev *ts, int on)
+{
+	if (!ts->coalesce) {
+		if (!on)
+			return 0;
+		ts->coalesce = calloc(1, sizeof(struct ts_coalesce));
+		if (!ts->coalesce)
+			return -1;
+	}
+	ts->coalesce->on = on;
+	return 0;
+}
+
+int ts_coalesce_on(struct tsdev *ts)
+{
+	struct ts_coalesce *c = ts->coalesce;
+
+	/* what was read while it was on still comes out */
+	return c && (c->on || c->head < c->tail);
+}
+
+void ts_coalesce_free(struct tsdev *ts)
+{
+	free(ts->coalesce);
+	ts->coalesce = NULL;
+}
+
+static void ts_coalesce_box(struct ts_coalesced *p, const struct ts_sample *s)
+{
+	if (s->x < p->x_min)
+		p->x_min = s->x;
+	if (s->x > p->x_max)
+		p->x_max = s->x;
+	if (s->y < p->y_min)
+		p->y_min = s->y;
+	if (s->y > p->y_max)
+		p->y_max = s->y;
+}
+
+/*
+ * Hands out samples to samp, or with their counts and boxes to path.
+ * The first read asks for nr, as ts_read() would.  After it, the chain
+ * is read without blocking until it has no more, as only it knows what
+ * its filters still hold back.
+ */
+int ts_coalesce_read(struct tsdev *ts, struct ts_sample *samp,
+		     struct ts_coalesced *path, int nr)
+{
+	struct ts_coalesce *c = ts->coalesce;
+	const struct ts_sample *s;
+	int n = 0, merging = 0, ret;
+
+	for (;;) {
+		while (c->head < c->tail) {
+			s = &c->buf[c->head];
+			if (merging && s->pressure) {
+				/* a move after a move: only the latest counts */
+				if (path) {
+					path[n - 1].samp = *s;
+					path[n - 1].count++;
+					ts_coalesce_box(&path[n - 1], s);
+				} else {
+					samp[n - 1] = *s;
+				}
+				c->head++;
+				continue;
+			}
+			if (n == nr)
+				return n;
+			if (path) {
+				path[n].samp = *s;
+				path[n].count = 1;
+				path[n].x_min = path[n].x_max = s->x;
+				path[n].y_min = path[n].y_max = s->y;
+			} else {
+				samp[n] = *s;
+			}
+			n++;
+			/* a press comes out on its own, the moves after it merge */
+			merging = s->pressure && c->pressed;
+			c->pressed = s->pressure != 0;
+			c->head++;
+		}
+
+		if (!n)
+			ret = ts->list->ops->read(ts->list, c->buf,
+						  nr < TS_COALESCE_BUF ? nr : TS_COALESCE_BUF);
+		else
+			ret = ts_read_nonblock(ts, c->buf, TS_COALESCE_BUF);
+		if (ret <= 0)
+			return n ? n : ret;
+		c->head = 0;
+		c->tail = ret;
+	}
+}
+
+int ts_read_coalesced(struct tsdev *ts, struct ts_coalesced *path, int nr)
+{
+	/* without turning it on for ts_read() */
+	if (!ts->coalesce) {
+		ts->coalesce = calloc(1, sizeof(struct ts_coalesce));
+		if (!ts->coalesce)
+			return -1;
+	}
+	return ts_coalesce_read(ts, NULL, path, nr);
+}
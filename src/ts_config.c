@@ -29,10 +29,10 @@ int ts_config(struct tsdev *ts)
 	int line = 0;
 	int ret = 0;
 
-	char *conffile;
+	const char *conffile;
 
 	if( (conffile = getenv("TSLIB_CONFFILE")) == NULL) {
-		conffile = strdup (TS_CONF);
+		conffile = TS_CONF;
 	}
 
 	f = fopen(conffile, "r");
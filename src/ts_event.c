@@ -0,0 +1,172 @@
+/*
+ *  tslib/src/ts_event.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * The read loop of the raw modules for drivers with fixed size event
+ * records.  Records are framed by the serial engine, as packets that
+ * any byte may start, so many of them come in with one read() and a
+ * record split between reads is kept for the next one.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef DEBUG
+#include <stdio.h>
+#endif
+
+#include "tslib-private.h"
+#include "tslib-serial.h"
+#include "tslib-event.h"
+
+struct tslib_event_raw {
+	struct tslib_module_info module;
+	const struct ts_event_layout *layout;
+	struct ts_serial_packet record;
+	struct ts_serial serial;
+};
+
+static long long event_field(const unsigned char *rec,
+			     const struct ts_event_field *f)
+{
+	const unsigned char *p = rec + f->offset;
+	long long v = 0;
+
+	switch (f->size) {
+	case 1: {
+		uint8_t u;
+
+		memcpy(&u, p, 1);
+		v = f->is_signed ? (int8_t)u : u;
+		break;
+	}
+	case 2: {
+		uint16_t u;
+
+		memcpy(&u, p, 2);
+		v = f->is_signed ? (int16_t)u : u;
+		break;
+	}
+	case 4: {
+		uint32_t u;
+
+		memcpy(&u, p, 4);
+		if (f->is_signed)
+			v = (int32_t)u;
+		else
+			v = u;
+		break;
+	}
+	case 8:
+		memcpy(&v, p, 8);
+		break;
+	}
+
+	if (f->bits) {
+		unsigned long long mask = (1ULL << f->bits) - 1;
+
+		v &= mask;
+		if (f->is_signed && (v >> (f->bits - 1)))
+			v |= ~mask;
+	}
+	return v;
+}
+
+static int event_decode(const struct ts_event_layout *l,
+			const unsigned char *rec, struct ts_sample *samp)
+{
+	long long ms;
+
+	if (l->x.size)
+		samp->x = event_field(rec, &l->x);
+	if (l->y.size)
+		samp->y = event_field(rec, &l->y);
+	if (l->pressure.size)
+		samp->pressure = event_field(rec, &l->pressure);
+
+	switch (l->time_kind) {
+	case TS_EVENT_TIME_NOW:
+		gettimeofday(&samp->tv, NULL);
+		break;
+	case TS_EVENT_TIME_MS:
+		ms = event_field(rec, &l->time);
+		samp->tv.tv_sec = ms / 1000;
+		samp->tv.tv_usec = (ms % 1000) * 1000;
+		break;
+	case TS_EVENT_TIME_TIMEVAL:
+		memcpy(&samp->tv, rec + l->time.offset, sizeof(samp->tv));
+		break;
+	}
+
+	if (l->decode && !l->decode(rec, samp))
+		return 0;
+#ifdef DEBUG
+	fprintf(stderr,"RAW---------------------------> %d %d %d\n",samp->x,samp->y,samp->pressure);
+#endif /*DEBUG*/
+	return 1;
+}
+
+static int event_raw_read(struct tslib_module_info *inf,
+			  struct ts_sample *samp, int nr)
+{
+	struct tslib_event_raw *e = (struct tslib_event_raw *)inf;
+	const unsigned char *rec;
+	int total = 0;
+	int type;
+
+	while (total < nr) {
+		rec = ts_serial_next(&e->serial, &type);
+		if (!rec) {
+			/* only wait for the device while there is nothing to return */
+			if (total)
+				break;
+			if (ts_serial_fill(&e->serial, inf->dev->fd) <= 0)
+				return -1;
+			continue;
+		}
+		if (event_decode(e->layout, rec, samp)) {
+			samp++;
+			total++;
+		}
+	}
+	return total;
+}
+
+static int event_raw_fini(struct tslib_module_info *inf)
+{
+	free(inf);
+	return 0;
+}
+
+static const struct tslib_ops event_raw_ops =
+{
+	.read	= event_raw_read,
+	.fini	= event_raw_fini,
+};
+
+struct tslib_module_info *ts_event_raw_init(struct tsdev *dev,
+		const struct ts_event_layout *layout)
+{
+	struct tslib_event_raw *e;
+
+	(void)dev;
+
+	if (layout->size == 0 || layout->size > TS_SERIAL_BUF / 4 ||
+	    layout->size > 255)
+		return NULL;
+
+	e = malloc(sizeof(struct tslib_event_raw));
+	if (e == NULL)
+		return NULL;
+
+	memset(e, 0, sizeof(struct tslib_event_raw));
+	e->module.ops = &event_raw_ops;
+	e->layout = layout;
+	/* any byte starts a record, which is just its length */
+	e->record.len = layout->size;
+	ts_serial_init(&e->serial, &e->record, 1);
+	return &e->module;
+}
@@ -0,0 +1,212 @@
+/*
+ *  tslib/src/ts_find.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Find the touchscreen among the input devices without opening them:
+ * sysfs lists the capabilities of every event device.  The device found
+ * last time is remembered, together with its identity, so that the
+ * next start only has to check that it is still the same device.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+
+#include "tslib-private.h"
+
+#define SYSFS_INPUT	"/sys/class/input"
+#define IDENTITY_SIZE	256
+
+#ifndef BTN_TOUCH
+#define BTN_TOUCH	0x14a
+#endif
+
+#define BITS_PER_LONG	(sizeof(long) * 8)
+
+static int sysfs_read(const char *event, const char *attr,
+		char *buf, int len)
+{
+	char path[256];
+	FILE *f;
+	char *e;
+
+	snprintf(path, sizeof(path), SYSFS_INPUT "/%s/device/%s", event, attr);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (!fgets(buf, len, f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	e = strchr(buf, '\n');
+	if (e)
+		*e = '\0';
+	return 0;
+}
+
+/*
+ * Capability bitmaps are printed as hex longs, most significant first,
+ * without the leading zero words.
+ */
+static int sysfs_test_bit(const char *event, const char *attr, int bit)
+{
+	char buf[512];
+	char *word[64];
+	char *p, *save;
+	int n = 0;
+	int w = bit / BITS_PER_LONG;
+
+	if (sysfs_read(event, attr, buf, sizeof(buf)))
+		return 0;
+
+	for (p = strtok_r(buf, " ", &save); p && n < 64;
+	     p = strtok_r(NULL, " ", &save))
+		word[n++] = p;
+	if (w >= n)
+		return 0;
+	return (strtoul(word[n - 1 - w], NULL, 16) >> (bit % BITS_PER_LONG)) & 1;
+}
+
+static int sysfs_is_touchscreen(const char *event)
+{
+	return sysfs_test_bit(event, "capabilities/abs", ABS_X) &&
+	       sysfs_test_bit(event, "capabilities/abs", ABS_Y) &&
+	       sysfs_test_bit(event, "capabilities/key", BTN_TOUCH);
+}
+
+/* bus:vendor:product:version:name, which survives renumbering */
+static int sysfs_identity(const char *event, char *buf, int len)
+{
+	static const char * const ids[] = {
+		"id/bustype", "id/vendor", "id/product", "id/version", "name",
+	};
+	unsigned int k;
+	int used = 0;
+
+	for (k = 0; k < sizeof(ids) / sizeof(ids[0]); k++) {
+		char val[128];
+
+		if (sysfs_read(event, ids[k], val, sizeof(val)))
+			return -1;
+		used += snprintf(buf + used, len - used, k ? ":%s" : "%s", val);
+		if (used >= len)
+			return -1;
+	}
+	return 0;
+}
+
+static const char *cache_file(void)
+{
+	const char *file = getenv("TSLIB_DEVCACHE");
+
+	return file ? file : TS_DEVCACHE;
+}
+
+static int cache_lookup(char *path, int len)
+{
+	char identity[IDENTITY_SIZE], current[IDENTITY_SIZE];
+	const char *event;
+	FILE *f;
+	char *e;
+	int ret = -1;
+
+	f = fopen(cache_file(), "r");
+	if (!f)
+		return -1;
+	if (fgets(path, len, f) && fgets(identity, sizeof(identity), f)) {
+		if ((e = strchr(path, '\n')))
+			*e = '\0';
+		if ((e = strchr(identity, '\n')))
+			*e = '\0';
+		event = strrchr(path, '/');
+		if (event && !sysfs_identity(event + 1, current, sizeof(current)) &&
+		    !strcmp(identity, current))
+			ret = 0;
+	}
+	fclose(f);
+	return ret;
+}
+
+/*
+ * Written aside and renamed into place, since several devices may be
+ * opened at once and each may find the cache stale.
+ */
+static void cache_store(const char *path, const char *identity)
+{
+	const char *file = cache_file();
+	char *tmp;
+	FILE *f;
+	int fd;
+
+	tmp = malloc(strlen(file) + 8);
+	if (!tmp)
+		return;
+	sprintf(tmp, "%s.XXXXXX", file);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		return;
+	}
+	fchmod(fd, 0644);
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp);
+		free(tmp);
+		return;
+	}
+	fprintf(f, "%s\n%s\n", path, identity);
+	if (fclose(f) || rename(tmp, file))
+		unlink(tmp);
+	free(tmp);
+}
+
+/*
+ * Returns the path of the touchscreen, the lowest numbered event device
+ * with ABS_X, ABS_Y and BTN_TOUCH, or NULL when sysfs has none.
+ */
+const char *ts_find_device(char *path, int len)
+{
+	char identity[IDENTITY_SIZE];
+	char event[32];
+	struct dirent *d;
+	DIR *dir;
+	int best = -1;
+
+	if (!cache_lookup(path, len))
+		return path;
+
+	dir = opendir(SYSFS_INPUT);
+	if (!dir)
+		return NULL;
+	while ((d = readdir(dir)) != NULL) {
+		char *end;
+		long n;
+
+		if (strncmp(d->d_name, "event", 5))
+			continue;
+		n = strtol(d->d_name + 5, &end, 10);
+		if (*end || (best >= 0 && n >= best))
+			continue;
+		if (sysfs_is_touchscreen(d->d_name))
+			best = n;
+	}
+	closedir(dir);
+	if (best < 0)
+		return NULL;
+
+	snprintf(path, len, "/dev/input/event%d", best);
+	snprintf(event, sizeof(event), "event%d", best);
+	if (!sysfs_identity(event, identity, sizeof(identity)))
+		cache_store(path, identity);
+	return path;
+}
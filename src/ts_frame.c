@@ -0,0 +1,321 @@
+/*
+ *  tslib/src/ts_frame.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Turn frames of a capacitive sensor grid into contacts: a baseline
+ * of the untouched readings, the deltas to it above the noise, the
+ * blobs of cells they form and the centroid of each.  The stages work
+ * in place on the buffers of struct ts_frame_proc and allocate nothing.
+ */
+#include "config.h"
+#include <string.h>
+#include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "tslib-private.h"
+#include "tslib-frame.h"
+
+void ts_frame_reset(struct ts_frame_proc *p, const uint16_t *cells)
+{
+	int i;
+
+	for (i = 0; i < p->width * p->height; i++)
+		p->baseline[0][i] = (uint32_t)cells[i] << TS_FRAME_SHIFT;
+	p->cur = 0;
+}
+
+int ts_frame_baseline(struct ts_frame_proc *p, const uint16_t *cells)
+{
+	const uint32_t *base = p->baseline[p->cur];
+	uint32_t *next = p->baseline[!p->cur];
+	uint16_t *delta = p->delta;
+	int n = p->width * p->height;
+	int shift = p->decay;
+	/* deltas below quiet decay the baseline, none with a decay of 0 */
+	uint32_t quiet = shift ? p->noise + 1 : 0;
+	uint32_t raw, r, b, d, bad = 0, max = 0;
+	int i = 0;
+
+#if defined(__SSE2__)
+	{
+		/*
+		 * SSE2 only compares and packs signed: the baselines are
+		 * biased by 1 << 31 and the deltas by 1 << 15 for that, so
+		 * all of 16 bits works as in the loop below.
+		 */
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i sign32 = _mm_set1_epi32((int)0x80000000);
+		const __m128i bias32 = _mm_set1_epi32(0x8000);
+		const __m128i sign16 = _mm_set1_epi16((short)0x8000);
+		const __m128i min_v = _mm_set1_epi32(p->min_value);
+		const __m128i max_v = _mm_set1_epi32(p->max_value);
+		const __m128i quiet_v = _mm_set1_epi32(quiet);
+		const __m128i shift_v = _mm_cvtsi32_si128(shift);
+		__m128i bad_v = zero, max_d = sign16;
+		__m128i raw16, raw32[2], r_v, b_v, gt, diff, d_v[2];
+		int k;
+
+		for (; i + 8 <= n; i += 8) {
+			raw16 = _mm_loadu_si128((const __m128i *)(cells + i));
+			raw32[0] = _mm_unpacklo_epi16(raw16, zero);
+			raw32[1] = _mm_unpackhi_epi16(raw16, zero);
+			for (k = 0; k < 2; k++) {
+				bad_v = _mm_or_si128(bad_v, _mm_cmplt_epi32(raw32[k], min_v));
+				bad_v = _mm_or_si128(bad_v, _mm_cmpgt_epi32(raw32[k], max_v));
+				r_v = _mm_slli_epi32(raw32[k], TS_FRAME_SHIFT);
+				b_v = _mm_loadu_si128((const __m128i *)(base + i + 4 * k));
+				gt = _mm_cmpgt_epi32(_mm_xor_si128(r_v, sign32),
+						     _mm_xor_si128(b_v, sign32));
+				diff = _mm_sub_epi32(b_v, r_v);
+				d_v[k] = _mm_andnot_si128(gt, _mm_srli_epi32(diff, TS_FRAME_SHIFT));
+				b_v = _mm_sub_epi32(b_v, _mm_and_si128(_mm_srl_epi32(diff, shift_v),
+						_mm_cmplt_epi32(d_v[k], quiet_v)));
+				b_v = _mm_or_si128(_mm_and_si128(gt, r_v), _mm_andnot_si128(gt, b_v));
+				_mm_storeu_si128((__m128i *)(next + i + 4 * k), b_v);
+				d_v[k] = _mm_sub_epi32(d_v[k], bias32);
+			}
+			d_v[0] = _mm_packs_epi32(d_v[0], d_v[1]);
+			_mm_storeu_si128((__m128i *)(delta + i), _mm_xor_si128(d_v[0], sign16));
+			max_d = _mm_max_epi16(max_d, d_v[0]);
+		}
+		if (_mm_movemask_epi8(bad_v))
+			return -1;
+		max_d = _mm_max_epi16(max_d, _mm_srli_si128(max_d, 8));
+		max_d = _mm_max_epi16(max_d, _mm_srli_si128(max_d, 4));
+		max_d = _mm_max_epi16(max_d, _mm_srli_si128(max_d, 2));
+		max = _mm_extract_epi16(max_d, 0) ^ 0x8000;
+	}
+#elif defined(__ARM_NEON)
+	{
+		const uint32x4_t min_v = vdupq_n_u32(p->min_value);
+		const uint32x4_t max_v = vdupq_n_u32(p->max_value);
+		const uint32x4_t quiet_v = vdupq_n_u32(quiet);
+		const int32x4_t shift_v = vdupq_n_s32(-shift);
+		uint32x4_t bad_v = vdupq_n_u32(0);
+		uint16x8_t max_d = vdupq_n_u16(0);
+		uint16x8_t raw16, d16;
+		uint16x4_t max16;
+		uint32x2_t bad32;
+		uint32x4_t raw32[2], r_v, b_v, gt, diff, d_v[2];
+		int k;
+
+		for (; i + 8 <= n; i += 8) {
+			raw16 = vld1q_u16(cells + i);
+			raw32[0] = vmovl_u16(vget_low_u16(raw16));
+			raw32[1] = vmovl_u16(vget_high_u16(raw16));
+			for (k = 0; k < 2; k++) {
+				bad_v = vorrq_u32(bad_v, vcltq_u32(raw32[k], min_v));
+				bad_v = vorrq_u32(bad_v, vcgtq_u32(raw32[k], max_v));
+				r_v = vshlq_n_u32(raw32[k], TS_FRAME_SHIFT);
+				b_v = vld1q_u32(base + i + 4 * k);
+				gt = vcgtq_u32(r_v, b_v);
+				diff = vsubq_u32(b_v, r_v);
+				d_v[k] = vbicq_u32(vshrq_n_u32(diff, TS_FRAME_SHIFT), gt);
+				b_v = vsubq_u32(b_v, vandq_u32(vshlq_u32(diff, shift_v),
+						vcltq_u32(d_v[k], quiet_v)));
+				b_v = vbslq_u32(gt, r_v, b_v);
+				vst1q_u32(next + i + 4 * k, b_v);
+			}
+			d16 = vcombine_u16(vqmovn_u32(d_v[0]), vqmovn_u32(d_v[1]));
+			vst1q_u16(delta + i, d16);
+			max_d = vmaxq_u16(max_d, d16);
+		}
+		bad32 = vorr_u32(vget_low_u32(bad_v), vget_high_u32(bad_v));
+		if (vget_lane_u32(bad32, 0) | vget_lane_u32(bad32, 1))
+			return -1;
+		max16 = vpmax_u16(vget_low_u16(max_d), vget_high_u16(max_d));
+		max16 = vpmax_u16(max16, max16);
+		max16 = vpmax_u16(max16, max16);
+		max = vget_lane_u16(max16, 0);
+	}
+#endif
+
+	/* what is left over, or all of it without SIMD */
+	for (; i < n; i++) {
+		raw = cells[i];
+		bad |= raw < (uint32_t)p->min_value || raw > (uint32_t)p->max_value;
+		r = raw << TS_FRAME_SHIFT;
+		b = base[i];
+		if (r > b) {
+			d = 0;
+			next[i] = r;
+		} else {
+			d = (b - r) >> TS_FRAME_SHIFT;
+			next[i] = d < quiet ? b - ((b - r) >> shift) : b;
+		}
+		delta[i] = d;
+		if (d > max)
+			max = d;
+	}
+	if (bad)
+		return -1;
+
+	p->cur = !p->cur;
+	return max;
+}
+
+int ts_frame_threshold(struct ts_frame_proc *p)
+{
+	int i, left = 0;
+
+	for (i = 0; i < p->width * p->height; i++) {
+		if (p->delta[i] <= p->noise)
+			p->delta[i] = 0;
+		else
+			left++;
+	}
+	return left;
+}
+
+/*
+ * Every cell climbs to its highest neighbour until it reaches a local
+ * maximum, and belongs to the contact of that maximum, so two fingers
+ * that touch the same cells still are two contacts where connected
+ * components would make one.  Between cells of the same value the lower
+ * one counts as higher, so that every climb ends.
+ */
+int ts_frame_blobs(struct ts_frame_proc *p, struct ts_frame_blob *blob, int max)
+{
+	struct ts_frame_blob found[TS_FRAME_MAX_MAXIMA];
+	uint16_t up[TS_FRAME_MAX_CELLS];
+	int16_t label[TS_FRAME_MAX_CELLS];
+	const uint16_t *delta = p->delta;
+	int w = p->width, h = p->height;
+	int x, y, dx, dy, c, n, best, top, k, nr_found = 0;
+
+	for (c = 0; c < w * h; c++) {
+		label[c] = -1;
+		if (!delta[c])
+			continue;
+		x = c % w;
+		y = c / w;
+		best = c;
+		for (dy = -1; dy <= 1; dy++) {
+			if (y + dy < 0 || y + dy >= h)
+				continue;
+			for (dx = -1; dx <= 1; dx++) {
+				if (x + dx < 0 || x + dx >= w)
+					continue;
+				n = c + dy * w + dx;
+				if (delta[n] > delta[best] ||
+				    (delta[n] == delta[best] && n < best))
+					best = n;
+			}
+		}
+		up[c] = best;
+	}
+
+	for (c = 0; c < w * h; c++) {
+		if (!delta[c])
+			continue;
+		for (top = c; up[top] != top; top = up[top])
+			;
+		if (label[top] < 0) {
+			label[top] = nr_found;
+			memset(&found[nr_found], 0, sizeof(found[0]));
+			found[nr_found++].peak = delta[top];
+		}
+		k = label[top];
+		x = p->mirror_x ? w - 1 - c % w : c % w;
+		found[k].sum += delta[c];
+		found[k].sx += delta[c] * x;
+		found[k].sy += delta[c] * (c / w);
+	}
+
+	/* more local maxima than fingers are noise, keep the highest */
+	for (n = 0; n < nr_found && n < max; n++) {
+		best = n;
+		for (k = n + 1; k < nr_found; k++)
+			if (found[k].peak > found[best].peak)
+				best = k;
+		blob[n] = found[best];
+		found[best] = found[n];
+	}
+
+	return n;
+}
+
+void ts_frame_centroid(const struct ts_frame_proc *p,
+		       const struct ts_frame_blob *blob, struct ts_sample *samp)
+{
+	/* a large blob's moments times the pitch do not fit in an int */
+	samp->x = p->offset_x + ((long long)p->pitch_x * blob->sx + blob->sum / 2) / blob->sum;
+	samp->y = p->offset_y + ((long long)p->pitch_y * blob->sy + blob->sum / 2) / blob->sum;
+	samp->pressure = blob->sum;
+}
+
+static void frame_done(struct tslib_frame_module *fm, const struct timespec *start)
+{
+	struct ts_stats *stats = &fm->module.dev->stats;
+	struct timespec now;
+	unsigned long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - start->tv_sec) * 1000000000UL + now.tv_nsec - start->tv_nsec;
+
+	stats->frames++;
+	stats->frame_ns = ns;
+	stats->frame_ns_total += ns;
+	if (ns > stats->frame_ns_max)
+		stats->frame_ns_max = ns;
+	stats->frame_period_ns = fm->period_ns;
+	if (fm->period_ns && ns > fm->period_ns)
+		stats->frames_late++;
+}
+
+int ts_frame_read(struct tslib_module_info *info, struct ts_sample *samp, int nr)
+{
+	struct tslib_frame_module *fm = (struct tslib_frame_module *)info;
+	struct ts_frame_proc *p = &fm->proc;
+	struct ts_frame_blob blob[TS_FRAME_MAX_CONTACTS];
+	struct ts_frame frame;
+	struct timespec start;
+	int ret, n = 0, k;
+
+	ret = fm->frame_ops->read_frame(fm, &frame);
+	if (ret <= 0)
+		return ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = ts_frame_baseline(p, frame.cells);
+	if (ret < 0) {
+		if (fm->frame_ops->bad_frame)
+			fm->frame_ops->bad_frame(fm);
+		return 0;
+	}
+	if (fm->frame_ops->keep_frame && !fm->frame_ops->keep_frame(fm))
+		return 0;
+
+	if (ret > p->noise && ts_frame_threshold(p))
+		n = ts_frame_blobs(p, blob, nr < TS_FRAME_MAX_CONTACTS ?
+					    nr : TS_FRAME_MAX_CONTACTS);
+
+	/* all contacts of the frame come out together */
+	if (n > 0) {
+		for (k = 0; k < n; k++) {
+			ts_frame_centroid(p, &blob[k], &samp[k]);
+			samp[k].tv = frame.tv;
+		}
+		memcpy(fm->last, samp, n * sizeof(struct ts_sample));
+		fm->nr_last = n;
+	} else if (fm->nr_last) {
+		/* the last ones again with pressure 0, for the release */
+		n = fm->nr_last < nr ? fm->nr_last : nr;
+		for (k = 0; k < n; k++) {
+			samp[k] = fm->last[k];
+			samp[k].pressure = 0;
+			samp[k].tv = frame.tv;
+		}
+		fm->nr_last = 0;
+	}
+
+	frame_done(fm, &start);
+	return n;
+}
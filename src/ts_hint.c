@@ -0,0 +1,24 @@
+/*
+ *  tslib/src/ts_hint.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Pass the screen position an application expected a press at down
+ * the module chain, for filters that learn from it.
+ */
+#include "config.h"
+
+#include "tslib-private.h"
+
+int ts_target_hint(struct tsdev *ts, int x, int y)
+{
+	struct tslib_module_info *info;
+	int ret = 0;
+
+	for (info = ts->list; info; info = info->next)
+		if (info->ops->hint && info->ops->hint(info, x, y) < 0)
+			ret = -1;
+	return ret;
+}
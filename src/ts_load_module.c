@@ -7,7 +7,7 @@
  * COPYING for more details.
  *
  *
- * Close a touchscreen device.
+ * Load a module, from libts itself or from the plugin directory.
  */
 #include "config.h"
 
@@ -23,11 +23,13 @@
 
 #include "../plugins/plugins.h"
 
-static const struct {
+struct tslib_static_module {
 	const char *name;
 	tslib_module_init mod_init;
-} tslib_modules[] = {
-	/* XXX: sort alphabetically and use a binary search? */
+};
+
+/* Keep sorted by name, it is searched with bsearch() */
+static const struct tslib_static_module tslib_modules[] = {
 #ifdef TSLIB_STATIC_ARCTIC2_MODULE
 	{ "arctic2", arctic2_mod_init },
 #endif
@@ -36,80 +38,114 @@ static const struct {
 #endif
 #ifdef TSLIB_STATIC_CORGI_MODULE
 	{ "corgi", corgi_mod_init },
-#endif 
-#ifdef TSLIB_CY8MRLN_PALMPRE_MODULE
-        { "cy8mrln_palmpre", cy8mrln_palmpre_mod_init },
+#endif
+#ifdef TSLIB_STATIC_CY8MRLN_PALMPRE_MODULE
+	{ "cy8mrln_palmpre", cy8mrln_palmpre_mod_init },
 #endif
 #ifdef TSLIB_STATIC_DEJITTER_MODULE
 	{ "dejitter", dejitter_mod_init },
 #endif
+#ifdef TSLIB_STATIC_DMC_MODULE
+	{ "dmc", dmc_mod_init },
+#endif
+#ifdef TSLIB_STATIC_DRIFT_MODULE
+	{ "drift", drift_mod_init },
+#endif
 #ifdef TSLIB_STATIC_H3600_MODULE
 	{ "h3600", h3600_mod_init },
 #endif
 #ifdef TSLIB_STATIC_INPUT_MODULE
 	{ "input", input_mod_init },
 #endif
-#ifdef TSLIB_STATIC_LINEAR_MODULE 
+#ifdef TSLIB_STATIC_LINEAR_MODULE
 	{ "linear", linear_mod_init },
 #endif
 #ifdef TSLIB_STATIC_LINEAR_H2200_MODULE
 	{ "linear_h2200", linear_h2200_mod_init },
 #endif
+#ifdef TSLIB_STATIC_LINEAR_QUAD_MODULE
+	{ "linear_quad", linear_quad_mod_init },
+#endif
+#ifdef TSLIB_STATIC_MERGE_MODULE
+	{ "merge", merge_mod_init },
+#endif
 #ifdef TSLIB_STATIC_MK712_MODULE
 	{ "mk712", mk712_mod_init },
 #endif
+#ifdef TSLIB_STATIC_POLYCORRECT_MODULE
+	{ "polycorrect", polycorrect_mod_init },
+#endif
+#ifdef TSLIB_STATIC_POWER_MODULE
+	{ "power", power_mod_init },
+#endif
 #ifdef TSLIB_STATIC_PTHRES_MODULE
 	{ "pthres", pthres_mod_init },
 #endif
 #ifdef TSLIB_STATIC_TATUNG_MODULE
 	{ "tatung", tatung_mod_init },
 #endif
+#ifdef TSLIB_STATIC_TOUCHKIT_MODULE
+	{ "touchkit", touchkit_mod_init },
+#endif
+#ifdef TSLIB_STATIC_TRACK_MODULE
+	{ "track", track_mod_init },
+#endif
 #ifdef TSLIB_STATIC_UCB1X00_MODULE
 	{ "ucb1x00", ucb1x00_mod_init },
 #endif
 #ifdef TSLIB_STATIC_VARIANCE_MODULE
 	{ "variance", variance_mod_init },
 #endif
+	/* keeps the array from being empty */
+	{ NULL, NULL },
 };
 
 #define countof(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+static int tslib_module_cmp(const void *key, const void *entry)
+{
+	return strcmp(key, ((const struct tslib_static_module *)entry)->name);
+}
+
 static struct tslib_module_info *__ts_load_module_static(struct tsdev *ts, const char *module, const char *params)
 {
-	struct tslib_module_info *info = NULL;
-	unsigned int i;
+	const struct tslib_static_module *m;
+	struct tslib_module_info *info;
+
+	m = bsearch(module, tslib_modules, countof(tslib_modules) - 1,
+		    sizeof(tslib_modules[0]), tslib_module_cmp);
+	if (!m)
+		return NULL;
 
-	for (i = 0; i < countof(tslib_modules); i++) {
-		if (!strcmp(tslib_modules[i].name, module)) {
-			info = tslib_modules[i].mod_init(ts, params);
+	info = m->mod_init(ts, params);
 #ifdef DEBUG
-			fprintf(stderr, "static module %s init %s\n", module,
-				info ? "succeeded" : "failed");
+	fprintf(stderr, "static module %s init %s\n", module,
+		info ? "succeeded" : "failed");
 #endif
-			break;
-		}
-	}
-
 	if (info)
 		info->handle = NULL;
 
 	return info;
 }
 
-static struct tslib_module_info *__ts_load_module_shared(struct tsdev *ts, const char *module, const char *params)
+/*
+ * A module is looked up as <module>_mod_init in the plugins.so bundle
+ * first, then as the mod_init pointer of <module>.so.  Symbols are
+ * bound lazily, and the bundle is only mapped once however many of
+ * its modules are loaded.  *found tells a module that failed to
+ * initialize from one that is not there.
+ */
+static struct tslib_module_info *__ts_load_module_from(struct tsdev *ts,
+		const char *fn, const char *sym, int bundle, const char *params,
+		int *found)
 {
-	tslib_module_init *init;
+	tslib_module_init init;
 	struct tslib_module_info *info;
-	char fn[1024];
 	void *handle;
-	char *plugin_directory = getenv("TSLIB_PLUGINDIR");
-
-	if (!plugin_directory)
-		plugin_directory = PLUGIN_DIR;
+	void *p;
 
-	snprintf(fn, sizeof fn, "%s/%s.so", plugin_directory, module);
-
-	handle = dlopen(fn, RTLD_NOW);
+	*found = 0;
+	handle = dlopen(fn, RTLD_LAZY);
 	if (!handle) {
 #ifdef DEBUG
 		fprintf (stderr, "%s dlopen() failed: %s\n", fn, dlerror());
@@ -117,16 +153,21 @@ static struct tslib_module_info *__ts_load_module_shared(struct tsdev *ts, const
 		return NULL;
 	}
 
-	init = dlsym(handle, "mod_init");
-	if (!init || !(*init)) {
+	p = dlsym(handle, sym);
+	if (p && !bundle)
+		init = *(tslib_module_init *)p;
+	else
+		*(void **)&init = p;
+	if (!init) {
 #ifdef DEBUG
-		fprintf (stderr, "%s dlsym() failed: %s\n", fn, dlerror());
+		fprintf (stderr, "%s dlsym(%s) failed: %s\n", fn, sym, dlerror());
 #endif
 		dlclose(handle);
 		return NULL;
 	}
+	*found = 1;
 
-	info = (*init)(ts, params);
+	info = init(ts, params);
 	if (!info) {
 #ifdef DEBUG
 		fprintf (stderr, "Can't init %s\n", fn);
@@ -140,6 +181,27 @@ static struct tslib_module_info *__ts_load_module_shared(struct tsdev *ts, const
 	return info;
 }
 
+static struct tslib_module_info *__ts_load_module_shared(struct tsdev *ts, const char *module, const char *params)
+{
+	struct tslib_module_info *info;
+	char fn[1024];
+	char sym[128];
+	int found;
+	char *plugin_directory = getenv("TSLIB_PLUGINDIR");
+
+	if (!plugin_directory)
+		plugin_directory = PLUGIN_DIR;
+
+	snprintf(fn, sizeof fn, "%s/plugins.so", plugin_directory);
+	snprintf(sym, sizeof sym, "%s_mod_init", module);
+	info = __ts_load_module_from(ts, fn, sym, 1, params, &found);
+	if (found)
+		return info;
+
+	snprintf(fn, sizeof fn, "%s/%s.so", plugin_directory, module);
+	return __ts_load_module_from(ts, fn, "mod_init", 0, params, &found);
+}
+
 static int __ts_load_module(struct tsdev *ts, const char *module, const char *params, int raw)
 {
 	struct tslib_module_info *info;
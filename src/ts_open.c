@@ -26,39 +26,50 @@
 
 extern struct tslib_module_info __ts_raw;
 
+struct tsdev *ts_open_fd(int fd)
+{
+	struct tsdev *ts;
+
+	ts = malloc(sizeof(struct tsdev));
+	if (ts) {
+		memset(ts, 0, sizeof(struct tsdev));
+		ts->fd = fd;
+		ts_probe_caps(ts);
+	}
+	return ts;
+}
+
 static struct tsdev *ts_open_xy(const char *name, int nonblock, int xres, int yres)
 {
 	struct tsdev *ts;
 	int flags = O_RDWR;
+	int fd;
 
 	if (nonblock)
 		flags |= O_NONBLOCK;
 
-	ts = malloc(sizeof(struct tsdev));
-	if (ts) {
-		memset(ts, 0, sizeof(struct tsdev));
-		ts->xres = xres;
-		ts->yres = yres;
-
-		ts->fd = open(name, flags);
-		/*
-		 * Try again in case file is simply not writable
-		 * It will do for most drivers
-		 */
-		if (ts->fd == -1 && errno == EACCES) {
-			flags = nonblock ? (O_RDONLY | O_NONBLOCK) : O_RDONLY;
-			ts->fd = open(name, flags);
-		}
-		if (ts->fd == -1)
-			goto free;
+	fd = open(name, flags);
+	/*
+	 * Try again in case file is simply not writable
+	 * It will do for most drivers
+	 */
+	if (fd == -1 && errno == EACCES) {
+		flags = nonblock ? (O_RDONLY | O_NONBLOCK) : O_RDONLY;
+		fd = open(name, flags);
+	}
+	if (fd == -1)
+		return NULL;
+
+	ts = ts_open_fd(fd);
+	if (!ts) {
+		close(fd);
+		return NULL;
 	}
+	ts->xres = xres;
+	ts->yres = yres;
 
 	printf("%s:%s:screen resolution = %dx%d\n", __func__, name, ts->xres, ts->yres);
 	return ts;
-
-free:
-	free(ts);
-	return NULL;
 }
 
 static const char * const input_choices[] = {"/dev/input/ts",
@@ -66,35 +77,11 @@ static const char * const input_choices[] = {"/dev/input/ts",
 	"/dev/input/event2", "/dev/touchscreen/ucb1x00",
 };
 
-#define DIV_ROUND_UP(n,d) (((n) + (d) - 1) / (d))
-#define BIT(nr)                 (1UL << (nr))
-#define BIT_MASK(nr)            (1UL << ((nr) % BITS_PER_LONG))
-#define BIT_WORD(nr)            ((nr) / BITS_PER_LONG)
-#define BITS_PER_BYTE           8
-#define BITS_PER_LONG           (sizeof(long) * BITS_PER_BYTE)
-#define BITS_TO_LONGS(nr)       DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
-#ifndef EV_CNT
-#define EV_CNT	(EV_MAX+1)
-#endif
+#define TS_CAPS_WANTED	(TS_CAP_EVDEV | TS_CAP_KEY | TS_CAP_ABS | TS_CAP_ABS_XY)
 
 static int is_touchscreen(struct tsdev *ts)
 {
-	int ret;
-	long evbit[BITS_TO_LONGS(EV_CNT)];
-	long absbit[BITS_TO_LONGS(ABS_CNT)];
-
-	ret = ioctl(ts->fd, EVIOCGBIT(0, sizeof(evbit)), evbit);
-	if ( (ret < 0) || !(evbit[BIT_WORD(EV_ABS)] & BIT_MASK(EV_ABS)) ||
-		!(evbit[BIT_WORD(EV_KEY)] & BIT_MASK(EV_KEY)) ) {
-		return 0;
-	}
-
-	ret = ioctl(ts->fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit);
-	if ( (ret < 0) || !(absbit[BIT_WORD(ABS_X)] & BIT_MASK(ABS_X)) ||
-		!(absbit[BIT_WORD(ABS_Y)] & BIT_MASK(ABS_Y))) {
-		return 0;
-	}
-	return 1;
+	return (ts->caps.flags & TS_CAPS_WANTED) == TS_CAPS_WANTED;
 }
 
 struct tsdev *ts_try_dev(const char *p, int nonblock, int xres, int yres)
@@ -113,83 +100,112 @@ struct tsdev *ts_try_dev(const char *p, int nonblock, int xres, int yres)
 	return NULL;
 }
 
-struct tsdev *ts_try_open(int nonblock, int xres, int yres, int index, const char **pp)
+/*
+ * The device asked for, then TSLIB_TSDEVICE, then the one sysfs
+ * points at, then the usual suspects.  *pp is set to the path that
+ * was opened.
+ */
+static struct tsdev *ts_try_open(const char *name, int nonblock,
+		int xres, int yres, char *path, int len, const char **pp)
 {
-	const char *p = NULL;
+	struct tsdev *ts;
+	unsigned int i;
 
-	if (index == -1) {
-		p = getenv("TSLIB_TSDEVICE");
-	} else if (index < (int)ARRAY_SIZE(input_choices)) {
-		p = input_choices[index];
+	*pp = name;
+	if ((ts = ts_try_dev(*pp, nonblock, xres, yres)))
+		return ts;
+
+	*pp = getenv("TSLIB_TSDEVICE");
+	if ((ts = ts_try_dev(*pp, nonblock, xres, yres)))
+		return ts;
+
+	*pp = ts_find_device(path, len);
+	if ((ts = ts_try_dev(*pp, nonblock, xres, yres)))
+		return ts;
+
+	for (i = 0; i < ARRAY_SIZE(input_choices); i++) {
+		*pp = input_choices[i];
+		if ((ts = ts_try_dev(*pp, nonblock, xres, yres)))
+			return ts;
 	}
-	*pp = p;
-	return ts_try_dev(p, nonblock, xres, yres);
+	return NULL;
 }
 
 struct tsdev *ts_open_config(int nonblock, int xres, int yres)
 {
 	struct tsdev *ts;
+	char path[256];
 	const char *p;
-	int i;
-
-	for (i = -1; i < (int)ARRAY_SIZE(input_choices); i++) {
-		ts = ts_try_open(nonblock, xres, yres, i, &p);
-		if (ts) {
-			if (!ts_config(ts)) {
-				printf("opened:%s\n", p);
-				return ts;
-			}
-			perror("ts_config");
-			ts_close(ts);
-		}
+
+	ts = ts_try_open(NULL, nonblock, xres, yres, path, sizeof(path), &p);
+	if (!ts)
+		return NULL;
+	if (ts_config(ts)) {
+		perror("ts_config");
+		ts_close(ts);
+		return NULL;
 	}
-	return NULL;
+	printf("opened:%s\n", p);
+	return ts;
 }
 
 static char *defaultfbdevice = "/dev/fb0";
 
-struct tsdev *ts_open(const char *name, int nonblock)
+/*
+ * The current mode is in sysfs, which saves opening the framebuffer
+ * device; the ioctl is kept for drivers that do not fill it in.
+ */
+static void fb_resolution(int *xres, int *yres)
 {
 	struct fb_var_screeninfo var;
-	struct tsdev *ts;
-	char *fbdevice;
-	const char *p;
+	const char *fbdevice, *node;
+	char path[128];
+	FILE *f;
 	int fb;
-	int xres = 0;
-	int yres = 0;
-	int i;
 
 	fbdevice = getenv("TSLIB_FBDEVICE");
 	if (!fbdevice)
 		fbdevice = defaultfbdevice;
 
+	node = strrchr(fbdevice, '/');
+	snprintf(path, sizeof(path), "/sys/class/graphics/%s/mode",
+		 node ? node + 1 : fbdevice);
+	f = fopen(path, "r");
+	if (f) {
+		int found = fscanf(f, "%*[^:]:%dx%d", xres, yres) == 2;
+
+		fclose(f);
+		if (found)
+			return;
+	}
+
 	fb = open(fbdevice, O_RDWR);
 	if (fb == -1) {
 		perror("open fbdevice");
-		goto c1;
+		return;
 	}
 
 	if (ioctl(fb, FBIOGET_VSCREENINFO, &var) < 0) {
 		perror("ioctl FBIOGET_VSCREENINFO");
-		goto c1;
+	} else {
+		*xres = var.xres;
+		*yres = var.yres;
 	}
-
-	xres = var.xres;
-	yres = var.yres;
-c1:
 	close(fb);
+}
 
-	ts = ts_try_dev(name, nonblock, xres, yres);
-	if (ts) {
+struct tsdev *ts_open(const char *name, int nonblock)
+{
+	struct tsdev *ts;
+	char path[256];
+	const char *p;
+	int xres = 0;
+	int yres = 0;
+
+	fb_resolution(&xres, &yres);
+
+	ts = ts_try_open(name, nonblock, xres, yres, path, sizeof(path), &p);
+	if (ts)
 		printf("opened:%s\n", p);
-		return ts;
-	}
-	for (i = -1; i < (int)ARRAY_SIZE(input_choices); i++) {
-		ts = ts_try_open(nonblock, xres, yres, i, &p);
-		if (ts) {
-			printf("opened:%s\n", p);
-			return ts;
-		}
-	}
-	return NULL;
+	return ts;
 }
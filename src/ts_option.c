@@ -34,6 +34,19 @@ int ts_option(struct tsdev *ts, enum ts_param param, ...)
                        ts->rotation = va_arg(ap, int);
                        ret = 0;
                        break;
+               case TS_COALESCE:
+                       ret = ts_coalesce_set(ts, va_arg(ap, int));
+                       break;
+               case TS_VSYNC: {
+                       int period = va_arg(ap, int);
+                       int lead = va_arg(ap, int);
+
+                       ret = ts_vsync_set(ts, period, lead);
+                       break;
+               }
+               default:
+                       ret = -1;
+                       break;
        }
        va_end(ap);
 
@@ -20,12 +20,11 @@
 
 #define BUF_SIZE 1024
 
-char s_holder[BUF_SIZE];
-
 int tslib_parse_vars(struct tslib_module_info *mod,
 		     const struct tslib_vars *vars, int nr,
 		     const char *str)
 {
+	char s_holder[BUF_SIZE];
 	char *s, *p;
 	int ret = 0;
 
@@ -0,0 +1,231 @@
+/*
+ *  tslib/src/ts_reactor.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Serve several touchscreens from one thread: a single epoll waits on
+ * all of them, and only the filter chains of the devices that have
+ * something to read are run.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/epoll.h>
+
+#include "tslib-private.h"
+
+/* devices reported ready by one epoll_wait() */
+#define REACTOR_EVENTS	16
+/* samples read from a device at a time */
+#define REACTOR_CHUNK	16
+
+struct reactor_dev {
+	struct tsdev	*ts;
+	int		failed;
+};
+
+struct ts_reactor {
+	int		epfd;
+	struct reactor_dev *dev;
+	int		nr_dev;
+	/* devices still to be read from the last epoll_wait() */
+	struct epoll_event ready[REACTOR_EVENTS];
+	int		nr_ready;
+	int		next_ready;
+};
+
+struct ts_reactor *ts_reactor_new(void)
+{
+	struct ts_reactor *r;
+
+	r = malloc(sizeof(struct ts_reactor));
+	if (r == NULL)
+		return NULL;
+
+	memset(r, 0, sizeof(struct ts_reactor));
+	r->epfd = epoll_create(REACTOR_EVENTS);
+	if (r->epfd < 0) {
+		free(r);
+		return NULL;
+	}
+	return r;
+}
+
+int ts_reactor_add(struct ts_reactor *r, struct tsdev *ts)
+{
+	struct epoll_event ev;
+	int index, flags;
+
+	for (index = 0; index < r->nr_dev; index++)
+		if (!r->dev[index].ts)
+			break;
+	if (index == r->nr_dev) {
+		struct reactor_dev *dev;
+
+		dev = realloc(r->dev, (r->nr_dev + 1) * sizeof(*dev));
+		if (!dev)
+			return -1;
+		r->dev = dev;
+		r->dev[r->nr_dev++].ts = NULL;
+	}
+
+	flags = fcntl(ts->fd, F_GETFL);
+	if (flags < 0 || fcntl(ts->fd, F_SETFL, flags | O_NONBLOCK) < 0)
+		return -1;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = index;
+	if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, ts->fd, &ev) < 0)
+		return -1;
+
+	r->dev[index].ts = ts;
+	r->dev[index].failed = 0;
+	return index;
+}
+
+struct tsdev *ts_reactor_remove(struct ts_reactor *r, int index)
+{
+	struct tsdev *ts;
+
+	if (index < 0 || index >= r->nr_dev || !r->dev[index].ts)
+		return NULL;
+
+	ts = r->dev[index].ts;
+	if (!r->dev[index].failed)
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, ts->fd, NULL);
+	r->dev[index].ts = NULL;
+
+	/* the slot may be reused; level triggering reports the rest again */
+	r->nr_ready = r->next_ready = 0;
+	return ts;
+}
+
+static void reactor_fail(struct ts_reactor *r, int index)
+{
+	struct reactor_dev *d = &r->dev[index];
+
+	epoll_ctl(r->epfd, EPOLL_CTL_DEL, d->ts->fd, NULL);
+	d->failed = 1;
+	ts_error("ts_reactor: device %d failed\n", index);
+}
+
+/* returns the number of devices left to read, or -1 */
+static int reactor_poll(struct ts_reactor *r, int timeout)
+{
+	int n;
+
+	if (r->next_ready < r->nr_ready)
+		return r->nr_ready - r->next_ready;
+
+	n = epoll_wait(r->epfd, r->ready, REACTOR_EVENTS, timeout);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+	r->nr_ready = n;
+	r->next_ready = 0;
+	return n;
+}
+
+/*
+ * Read up to nr samples from a device.  Returns 0 when it would block,
+ * and -1 when it failed.  Filters may swallow samples, so a short count
+ * does not mean the device has nothing more; as epoll is level triggered,
+ * what is left is reported again.
+ */
+static int reactor_read_dev(struct ts_reactor *r, int index,
+			    struct ts_sample *samp, int nr)
+{
+	struct reactor_dev *d;
+	int ret;
+
+	if (index >= r->nr_dev)
+		return 0;
+	d = &r->dev[index];
+	if (!d->ts || d->failed)
+		return 0;
+
+	errno = 0;
+	ret = ts_read(d->ts, samp, nr);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		reactor_fail(r, index);
+	}
+	return ret;
+}
+
+int ts_reactor_wait(struct ts_reactor *r, int timeout,
+		    ts_reactor_fn fn, void *data)
+{
+	struct ts_sample samp[REACTOR_CHUNK];
+	int total = 0;
+
+	if (reactor_poll(r, timeout) < 0)
+		return -1;
+
+	while (r->next_ready < r->nr_ready) {
+		int index = r->ready[r->next_ready++].data.u32;
+		int ret;
+
+		do {
+			ret = reactor_read_dev(r, index, samp, REACTOR_CHUNK);
+			if (ret < 0) {
+				fn(data, index, NULL, -1);
+			} else if (ret > 0) {
+				fn(data, index, samp, ret);
+				total += ret;
+			}
+		} while (ret == REACTOR_CHUNK);
+	}
+	return total;
+}
+
+int ts_reactor_read(struct ts_reactor *r, struct ts_reactor_sample *rsamp,
+		    int nr, int timeout)
+{
+	struct ts_sample samp[REACTOR_CHUNK];
+	int total = 0;
+
+	if (reactor_poll(r, timeout) < 0)
+		return -1;
+
+	/* a device that fills the batch is carried over to the next call */
+	while (total < nr && r->next_ready < r->nr_ready) {
+		int index = r->ready[r->next_ready].data.u32;
+		int want = nr - total < REACTOR_CHUNK ? nr - total : REACTOR_CHUNK;
+		int ret, k;
+
+		ret = reactor_read_dev(r, index, samp, want);
+		for (k = 0; k < ret; k++, total++) {
+			rsamp[total].index = index;
+			rsamp[total].samp = samp[k];
+		}
+		if (ret != want)
+			r->next_ready++;
+	}
+	return total;
+}
+
+int ts_reactor_fd(struct ts_reactor *r)
+{
+	return r->epfd;
+}
+
+void ts_reactor_free(struct ts_reactor *r)
+{
+	int index;
+
+	for (index = 0; index < r->nr_dev; index++)
+		if (r->dev[index].ts)
+			ts_close(r->dev[index].ts);
+	close(r->epfd);
+	free(r->dev);
+	free(r);
+}
@@ -10,6 +10,8 @@
  * Read raw pressure, x, y, and timestamp from a touchscreen device.
  */
 #include "config.h"
+#include <fcntl.h>
+#include <string.h>
 
 #include "tslib-private.h"
 
@@ -34,7 +36,12 @@ int ts_read(struct tsdev *ts, struct ts_sample *samp, int nr)
 	int result;
 //	int i;
 //	result = ts->list->ops->read(ts->list, ts_read_private_samples, nr);
-	result = ts->list->ops->read(ts->list, samp, nr);
+	if (ts->vsync)
+		result = ts_vsync_read(ts, samp, nr);
+	else if (ts->coalesce && ts_coalesce_on(ts))
+		result = ts_coalesce_read(ts, samp, NULL, nr);
+	else
+		result = ts->list->ops->read(ts->list, samp, nr);
 //	for(i=0;i<nr;i++) {
 //		samp[i] = ts_read_private_samples[i];
 //	}
@@ -45,3 +52,48 @@ int ts_read(struct tsdev *ts, struct ts_sample *samp, int nr)
 	return result;
 
 }
+
+/*
+ * Reads what the chain hands out without waiting, with the device set
+ * to not block for the time of the read.  Filters may hold samples back
+ * that the device no longer shows as readable, so asking the chain is
+ * the only way to learn whether there are any.
+ */
+int ts_read_nonblock(struct tsdev *ts, struct ts_sample *samp, int nr)
+{
+	int flags, ret;
+
+	flags = fcntl(ts->fd, F_GETFL);
+	if (flags >= 0 && !(flags & O_NONBLOCK))
+		fcntl(ts->fd, F_SETFL, flags | O_NONBLOCK);
+	ret = ts->list->ops->read(ts->list, samp, nr);
+	if (flags >= 0 && !(flags & O_NONBLOCK))
+		fcntl(ts->fd, F_SETFL, flags);
+	return ret;
+}
+
+int tslib_read_mt(struct tslib_module_info *inf, struct ts_contact *c, int nr)
+{
+	struct ts_sample *samp = (struct ts_sample *)c;
+	int ret, k;
+
+	if (inf->ops->read_mt)
+		return inf->ops->read_mt(inf, c, nr);
+
+	/*
+	 * The samples are read into the start of c and spread out from the
+	 * last one, which never overwrites one not yet moved.
+	 */
+	ret = inf->ops->read(inf, samp, nr);
+	for (k = ret - 1; k >= 0; k--) {
+		memmove(&c[k].samp, &samp[k], sizeof(struct ts_sample));
+		c[k].id = -1;
+		c[k].state = c[k].samp.pressure ? TS_CONTACT_MOVE : TS_CONTACT_UP;
+	}
+	return ret;
+}
+
+int ts_read_mt(struct tsdev *ts, struct ts_contact *c, int nr)
+{
+	return tslib_read_mt(ts->list, c, nr);
+}
@@ -0,0 +1,92 @@
+/*
+ *  tslib/src/ts_serial.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Find packets in the byte stream of a serial touchscreen.  Bytes are
+ * read in as large chunks as the buffer allows, and packets are handed
+ * out where they lie.  Only the partial packet left at the end of the
+ * buffer is ever moved, down to its start before the next read, so a
+ * packet never wraps around and needs no copy to be decoded.
+ */
+#include "config.h"
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "tslib-serial.h"
+
+void ts_serial_init(struct ts_serial *s,
+		    const struct ts_serial_packet *packets, int nr)
+{
+	memset(s, 0, sizeof(*s));
+	s->packets = packets;
+	s->nr_packets = nr;
+}
+
+int ts_serial_fill(struct ts_serial *s, int fd)
+{
+	int ret;
+
+	if (s->head == s->tail) {
+		s->head = s->tail = 0;
+	} else if (s->head) {
+		memmove(s->buf, s->buf + s->head, s->tail - s->head);
+		s->tail -= s->head;
+		s->head = 0;
+	}
+
+	do {
+		ret = read(fd, s->buf + s->tail, TS_SERIAL_BUF - s->tail);
+	} while (ret < 0 && errno == EINTR);
+	if (ret > 0)
+		s->tail += ret;
+	return ret;
+}
+
+/*
+ * Returns 1 for a packet, 0 if more bytes are needed to tell, and -1
+ * if there is no packet of this type at p.
+ */
+static int serial_match(const struct ts_serial_packet *pkt,
+			const unsigned char *p, int avail)
+{
+	int k;
+
+	if ((p[0] & pkt->mask) != pkt->match)
+		return -1;
+	for (k = 1; k < pkt->len && k < avail; k++)
+		if (p[k] & pkt->body_mask)
+			return -1;
+	return k == pkt->len;
+}
+
+const unsigned char *ts_serial_next(struct ts_serial *s, int *type)
+{
+	while (s->head < s->tail) {
+		const unsigned char *p = s->buf + s->head;
+		int avail = s->tail - s->head;
+		int t;
+
+		for (t = 0; t < s->nr_packets; t++) {
+			int ret = serial_match(&s->packets[t], p, avail);
+
+			if (ret > 0) {
+				s->head += s->packets[t].len;
+				*type = t;
+				return p;
+			}
+			if (ret == 0)
+				return NULL;
+		}
+
+		/* not the start of anything we know, resync on the next byte */
+		s->head++;
+		s->skipped++;
+	}
+	return NULL;
+}
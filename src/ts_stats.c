@@ -0,0 +1,20 @@
+/*
+ *  tslib/src/ts_stats.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Return the counters kept for a touchscreen device.
+ */
+#include <string.h>
+
+#include "tslib-private.h"
+
+int ts_get_stats(struct tsdev *ts, struct ts_stats *stats)
+{
+	if (!ts || !stats)
+		return -1;
+	memcpy(stats, &ts->stats, sizeof(*stats));
+	return 0;
+}
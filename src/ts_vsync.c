@@ -0,0 +1,260 @@
+/*
+ *  tslib/src/ts_vsync.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Reads paced to the display: one sample a frame, at the position the
+ * touch is at when the frame is scanned out.  The frames come from the
+ * framebuffer's vsync, or from a period.  What the device sent since
+ * the last frame is read at each vsync, and the position is
+ * interpolated, or extrapolated for at most one sample's time, from
+ * the two latest samples.
+ */
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <linux/fb.h>
+
+#include "tslib-private.h"
+
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC	_IOW('F', 0x20, __u32)
+#endif
+
+#define TS_VSYNC_BUF		64	/* read from the modules at once */
+
+struct ts_vsync {
+	int		fb;		/* waited on for vsync, or -1 */
+	long		period_us;	/* given, or measured at the vsyncs */
+	long		lead_us;	/* from a vsync to the scanout */
+	struct timespec	next;		/* the next frame, without fb */
+	struct timeval	vsync;		/* the last one */
+
+	/* the latest pressed samples, cur the newest */
+	struct ts_sample prev;
+	struct ts_sample cur;
+	int		nr_hist;
+	int		pressed;	/* as last handed out */
+	int		up;		/* a release read, not handed out yet */
+	struct ts_sample release;
+
+	/* read, not yet looked at */
+	struct ts_sample buf[TS_VSYNC_BUF];
+	int		head;
+	int		tail;
+};
+
+static long long ts_vsync_us(const struct timeval *tv)
+{
+	return (long long)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+int ts_vsync_set(struct tsdev *ts, int period_us, int lead_us)
+{
+	struct ts_vsync *v;
+	const char *fbdevice;
+
+	if (ts->vsync) {
+		if (ts->vsync->fb >= 0)
+			close(ts->vsync->fb);
+		free(ts->vsync);
+		ts->vsync = NULL;
+	}
+	if (period_us < 0)
+		return 0;
+
+	v = calloc(1, sizeof(struct ts_vsync));
+	if (!v)
+		return -1;
+	v->fb = -1;
+	v->period_us = period_us;
+	v->lead_us = lead_us;
+
+	if (!period_us) {
+		fbdevice = getenv("TSLIB_FBDEVICE");
+		if (!fbdevice)
+			fbdevice = "/dev/fb0";
+		v->fb = open(fbdevice, O_RDWR);
+		if (v->fb < 0) {
+			ts_error("open %s for vsync failed\n", fbdevice);
+			free(v);
+			return -1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &v->next);
+	ts->vsync = v;
+	return 0;
+}
+
+void ts_vsync_free(struct tsdev *ts)
+{
+	ts_vsync_set(ts, -1, 0);
+}
+
+/* Waits for the next frame, and notes when it came */
+static int ts_vsync_wait(struct ts_vsync *v)
+{
+	struct timeval now;
+	struct timespec ts;
+	__u32 crtc = 0;
+	long long us;
+
+	if (v->fb >= 0) {
+		if (ioctl(v->fb, FBIO_WAITFORVSYNC, &crtc) < 0)
+			return -1;
+		gettimeofday(&now, NULL);
+		us = ts_vsync_us(&now) - ts_vsync_us(&v->vsync);
+		/* the display's period, as long as the frames come in a row */
+		if (v->vsync.tv_sec && us > 0 && (!v->period_us || us < 2 * v->period_us))
+			v->period_us = us;
+		v->vsync = now;
+		return 0;
+	}
+
+	/* after waiting for a touch, the frames start over from now */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	if (ts.tv_sec > v->next.tv_sec ||
+	    (ts.tv_sec == v->next.tv_sec && ts.tv_nsec > v->next.tv_nsec))
+		v->next = ts;
+	v->next.tv_nsec += v->period_us * 1000;
+	while (v->next.tv_nsec >= 1000000000) {
+		v->next.tv_nsec -= 1000000000;
+		v->next.tv_sec++;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &v->next, NULL) == EINTR)
+		;
+	gettimeofday(&v->vsync, NULL);
+	return 0;
+}
+
+/*
+ * Takes the samples read so far, up to a release: what comes after it
+ * waits for the next frame.
+ */
+static void ts_vsync_take(struct ts_vsync *v)
+{
+	const struct ts_sample *s;
+
+	while (v->head < v->tail && !v->up) {
+		s = &v->buf[v->head++];
+		if (!s->pressure) {
+			if (v->nr_hist) {
+				v->up = 1;
+				v->release = *s;
+			}
+			continue;
+		}
+		v->prev = v->cur;
+		v->cur = *s;
+		if (v->nr_hist < 2)
+			v->nr_hist++;
+	}
+}
+
+/*
+ * Reads what the chain has, without blocking unless block is set.  Filters
+ * may hold samples the device no longer shows as readable, so the chain is
+ * drained rather than the fd polled.
+ */
+static int ts_vsync_fill(struct tsdev *ts, struct ts_vsync *v, int block)
+{
+	int ret;
+
+	for (;;) {
+		if (v->head < v->tail)
+			return 1;
+		/* raw modules wait for all they are asked for */
+		if (block)
+			ret = ts->list->ops->read(ts->list, v->buf, 1);
+		else
+			ret = ts_read_nonblock(ts, v->buf, TS_VSYNC_BUF);
+		if (ret < 0 && !block && errno == EAGAIN)
+			return 0;
+		if (ret <= 0)
+			return ret;
+		v->head = 0;
+		v->tail = ret;
+		ts_vsync_take(v);
+		if (v->up || block)
+			return 1;
+	}
+}
+
+/* The position at t, from the two latest samples */
+static void ts_vsync_resample(struct ts_vsync *v, const struct timeval *t,
+			      struct ts_sample *samp)
+{
+	long long dt, at;
+
+	*samp = v->cur;
+	samp->tv = *t;
+	if (v->nr_hist < 2)
+		return;
+	dt = ts_vsync_us(&v->cur.tv) - ts_vsync_us(&v->prev.tv);
+	if (dt <= 0)
+		return;
+	at = ts_vsync_us(t) - ts_vsync_us(&v->prev.tv);
+	/* no further past cur than it is past prev, held there once they stop */
+	if (at > 2 * dt)
+		at = 2 * dt;
+	if (at < 0)
+		at = 0;
+	samp->x = v->prev.x + (v->cur.x - v->prev.x) * at / dt;
+	samp->y = v->prev.y + (v->cur.y - v->prev.y) * at / dt;
+}
+
+/*
+ * Hands out one sample a frame while the screen is touched.  While it
+ * is not, waits for a touch as ts_read() would.
+ */
+int ts_vsync_read(struct tsdev *ts, struct ts_sample *samp, int nr)
+{
+	struct ts_vsync *v = ts->vsync;
+	struct timeval at;
+	long long us;
+	int ret;
+
+	if (nr < 1)
+		return 0;
+
+	while (!v->pressed && !v->nr_hist && !v->up) {
+		ret = ts_vsync_fill(ts, v, 1);
+		if (ret <= 0)
+			return ret;
+		ts_vsync_take(v);
+	}
+
+	if (ts_vsync_wait(v))
+		return -1;
+	ret = ts_vsync_fill(ts, v, 0);
+	if (ret < 0 && !v->nr_hist && !v->up)
+		return ret;
+
+	/* a press and its release in one frame still come out as both */
+	if (v->up && v->pressed) {
+		*samp = v->release;
+		samp->x = v->cur.x;
+		samp->y = v->cur.y;
+		v->up = 0;
+		v->pressed = 0;
+		v->nr_hist = 0;
+		ts_vsync_take(v);
+		return 1;
+	}
+
+	us = ts_vsync_us(&v->vsync) + (v->lead_us >= 0 ? v->lead_us : v->period_us);
+	at.tv_sec = us / 1000000;
+	at.tv_usec = us % 1000000;
+	ts_vsync_resample(v, &at, samp);
+	v->pressed = 1;
+	return 1;
+}
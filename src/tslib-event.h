@@ -0,0 +1,60 @@
+#ifndef _TSLIB_EVENT_H_
+#define _TSLIB_EVENT_H_
+/*
+ *  tslib/src/tslib-event.h
+ *
+ * This file is placed under the LGPL.
+ *
+ *
+ * Raw modules for drivers that report fixed size event records, which
+ * only need to say where the fields are.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+#include "tslib-filter.h"
+
+/* Where a value is in the record; size 0 leaves the sample alone */
+struct ts_event_field {
+	unsigned short	offset;
+	unsigned char	size;		/* 1, 2, 4 or 8 bytes */
+	unsigned char	is_signed;
+	unsigned char	bits;		/* only the low bits count, if not 0 */
+};
+
+#define TS_EVENT_FIELD_AS(type, member, nbits, sign) \
+	{ offsetof(type, member), sizeof(((type *)0)->member), sign, nbits }
+#define TS_EVENT_FIELD(type, member) \
+	TS_EVENT_FIELD_AS(type, member, 0, \
+			  (__typeof__(((type *)0)->member))-1 < 0)
+
+enum ts_event_time {
+	TS_EVENT_TIME_NOW,		/* stamped when read */
+	TS_EVENT_TIME_MS,		/* milliseconds */
+	TS_EVENT_TIME_TIMEVAL,		/* a struct timeval */
+};
+
+struct ts_event_layout {
+	unsigned int	size;		/* of one record */
+	struct ts_event_field x;
+	struct ts_event_field y;
+	struct ts_event_field pressure;
+	enum ts_event_time time_kind;
+	struct ts_event_field time;
+	/*
+	 * Optional, for what fields cannot say.  Called after the fields
+	 * are filled in, with the record wherever it lies in the buffer;
+	 * returns 0 to drop it.
+	 */
+	int (*decode)(const unsigned char *rec, struct ts_sample *samp);
+};
+
+TSAPI struct tslib_module_info *ts_event_raw_init(struct tsdev *dev,
+		const struct ts_event_layout *layout);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _TSLIB_EVENT_H_ */
@@ -28,6 +28,14 @@ struct tslib_vars {
 struct tslib_ops {
 	int (*read)(struct tslib_module_info *inf, struct ts_sample *samp, int nr);
 	int (*fini)(struct tslib_module_info *inf);
+	/* optional: the last press was aimed at screen position x, y */
+	int (*hint)(struct tslib_module_info *inf, int x, int y);
+	/* optional: read keeping the contacts apart, see tslib_read_mt() */
+	int (*read_mt)(struct tslib_module_info *inf, struct ts_contact *c, int nr);
+	/* optional, for the power module: scan at hz */
+	int (*set_rate)(struct tslib_module_info *inf, int hz);
+	/* optional: idle 1 sleeps until touched, 0 wakes up */
+	int (*set_idle)(struct tslib_module_info *inf, int idle);
 };
 
 struct tslib_module_info {
@@ -38,12 +46,25 @@ struct tslib_module_info {
 };
 
 typedef struct tslib_module_info *(*tslib_module_init)(struct tsdev *dev, const char *params);
+#ifdef TSLIB_PLUGIN_BUNDLE
+/* plugins.so holds many modules, each is found by the name of f */
+#define TSLIB_MODULE_INIT(f) TSAPI struct tslib_module_info *f(struct tsdev *dev, const char *params)
+#else
 #define TSLIB_MODULE_INIT(f) TSAPI tslib_module_init mod_init = &f
+#endif
 
 TSAPI extern int tslib_parse_vars(struct tslib_module_info *,
 			    const struct tslib_vars *, int,
 			    const char *);
 
+/*
+ * Reads contacts from inf, through its read_mt if it has one.  Else
+ * its samples come with id -1, and are TS_CONTACT_UP if their pressure
+ * is 0, TS_CONTACT_MOVE if not.
+ */
+TSAPI extern int tslib_read_mt(struct tslib_module_info *inf,
+			       struct ts_contact *c, int nr);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
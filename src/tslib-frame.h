@@ -0,0 +1,137 @@
+#ifndef _TSLIB_FRAME_H_
+#define _TSLIB_FRAME_H_
+/*
+ *  tslib/src/tslib-frame.h
+ *
+ * This file is placed under the LGPL.
+ *
+ *
+ * Contacts from whole frames of a capacitive sensor grid, for raw
+ * modules of controllers that hand out their heatmap.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+#include <tslib.h>
+#include "tslib-filter.h"
+
+#define TS_FRAME_MAX_W		20	/* cells, as on the larger panels */
+#define TS_FRAME_MAX_H		30
+#define TS_FRAME_MAX_CELLS	(TS_FRAME_MAX_W * TS_FRAME_MAX_H)
+#define TS_FRAME_MAX_CONTACTS	TS_MAX_CONTACTS
+/* no two local maxima are neighbours */
+#define TS_FRAME_MAX_MAXIMA	(((TS_FRAME_MAX_W + 1) / 2) * ((TS_FRAME_MAX_H + 1) / 2))
+
+#define TS_FRAME_SHIFT		16	/* fraction bits of the baseline */
+
+/* A frame as the controller scanned it */
+struct ts_frame {
+	const uint16_t	*cells;		/* readings, row after row */
+	struct timeval	tv;		/* when it was scanned */
+};
+
+/* The cells of one contact */
+struct ts_frame_blob {
+	int		peak;
+	int		sum;		/* of the deltas, grows with the area touched */
+	int		sx;		/* the deltas times the column of their cell */
+	int		sy;		/* the deltas times the row */
+};
+
+/*
+ * The stages a frame goes through, and what they keep from one frame
+ * to the next.  The driver sets the grid and the limits; the baseline
+ * is set from an untouched frame with ts_frame_reset().
+ */
+struct ts_frame_proc {
+	int		width;		/* cells */
+	int		height;
+	int		mirror_x;	/* column 0 is on the right */
+	int		min_value;	/* a reading outside these is a bad frame */
+	int		max_value;
+	int		noise;		/* deltas up to this are no touch */
+	int		decay;		/* the baseline follows by 1 / (1 << decay) */
+	int		pitch_x;	/* screen units from a cell to the next */
+	int		pitch_y;
+	int		offset_x;	/* of the middle of cell 0 */
+	int		offset_y;
+
+	/* in 1 << TS_FRAME_SHIFT units, the current one is baseline[cur] */
+	uint32_t	baseline[2][TS_FRAME_MAX_CELLS];
+	int		cur;
+	uint16_t	delta[TS_FRAME_MAX_CELLS];
+};
+
+TSAPI void ts_frame_reset(struct ts_frame_proc *p, const uint16_t *cells);
+
+/*
+ * Checks that every reading is in range, moves the baseline and puts
+ * the deltas to it in p->delta, all in one pass.  A cell reading above
+ * its baseline raises it at once; a cell within the noise below it
+ * pulls it down by 1 / (1 << decay) of the difference, so drift is
+ * followed while a finger resting on the glass is not.  The baseline is
+ * only kept if the frame was good.  Readings may use all 16 bits, with
+ * or without SIMD.  Returns the highest delta, or -1.
+ */
+TSAPI int ts_frame_baseline(struct ts_frame_proc *p, const uint16_t *cells);
+
+/* Clears the deltas within the noise, returns how many are left */
+TSAPI int ts_frame_threshold(struct ts_frame_proc *p);
+
+/*
+ * Splits the cells left by ts_frame_threshold() into contacts, highest
+ * peak first.  Returns how many were put in blob, up to max.
+ */
+TSAPI int ts_frame_blobs(struct ts_frame_proc *p, struct ts_frame_blob *blob,
+			 int max);
+
+/* The weighted centroid of a contact on the screen, its sum as pressure */
+TSAPI void ts_frame_centroid(const struct ts_frame_proc *p,
+			     const struct ts_frame_blob *blob,
+			     struct ts_sample *samp);
+
+struct tslib_frame_module;
+
+struct tslib_frame_ops {
+	/*
+	 * Reads the next frame.  Returns 1 if there was one, 0 if not,
+	 * -1 on error.
+	 */
+	int	(*read_frame)(struct tslib_frame_module *fm,
+			      struct ts_frame *frame);
+	/* A frame was dropped as bad.  May be NULL. */
+	void	(*bad_frame)(struct tslib_frame_module *fm);
+	/*
+	 * Returns 0 if the good frame just read should only update the
+	 * baseline.  May be NULL.
+	 */
+	int	(*keep_frame)(struct tslib_frame_module *fm);
+};
+
+/*
+ * A raw module that reads frames: it starts with this, sets frame_ops
+ * and proc, and uses ts_frame_read() as its read.
+ */
+struct tslib_frame_module {
+	struct tslib_module_info	module;
+	const struct tslib_frame_ops	*frame_ops;
+	struct ts_frame_proc		proc;
+	unsigned long			period_ns;	/* of a scan, 0 if unknown */
+	int				nr_last;
+	struct ts_sample		last[TS_FRAME_MAX_CONTACTS];
+};
+
+/*
+ * Reads a frame and hands out all of its contacts, or once they are
+ * gone, the last ones again with pressure 0.  The time each frame took
+ * is counted in the device's ts_stats, against frame_period_ns.
+ */
+TSAPI int ts_frame_read(struct tslib_module_info *info,
+			struct ts_sample *samp, int nr);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _TSLIB_FRAME_H_ */
@@ -28,6 +28,10 @@ struct tsdev {
 	unsigned int res_x;
 	unsigned int res_y;
 	int rotation;
+	struct ts_caps caps;
+	struct ts_stats stats;
+	struct ts_coalesce *coalesce;	/* NULL until it is first used */
+	struct ts_vsync *vsync;		/* NULL while it is off */
 };
 
 int __ts_attach(struct tsdev *ts, struct tslib_module_info *info);
@@ -35,6 +39,17 @@ int __ts_attach_raw(struct tsdev *ts, struct tslib_module_info *info);
 int ts_load_module(struct tsdev *dev, const char *module, const char *params);
 int ts_load_module_raw(struct tsdev *dev, const char *module, const char *params);
 int ts_error(const char *fmt, ...);
+void ts_probe_caps(struct tsdev *ts);
+const char *ts_find_device(char *path, int len);
+int ts_read_nonblock(struct tsdev *ts, struct ts_sample *samp, int nr);
+int ts_coalesce_set(struct tsdev *ts, int on);
+int ts_coalesce_on(struct tsdev *ts);
+int ts_coalesce_read(struct tsdev *ts, struct ts_sample *samp,
+		     struct ts_coalesced *path, int nr);
+void ts_coalesce_free(struct tsdev *ts);
+int ts_vsync_set(struct tsdev *ts, int period_us, int lead_us);
+int ts_vsync_read(struct tsdev *ts, struct ts_sample *samp, int nr);
+void ts_vsync_free(struct tsdev *ts);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,61 @@
+#ifndef _TSLIB_SERIAL_H_
+#define _TSLIB_SERIAL_H_
+/*
+ *  tslib/src/tslib-serial.h
+ *
+ * This file is placed under the LGPL.
+ *
+ *
+ * Packet framing for raw modules that read a byte stream, such as
+ * touchscreens on a serial port.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <tslib.h>
+
+#define TS_SERIAL_BUF		1024	/* bytes, dozens of packets or records */
+
+/*
+ * A packet starts with a byte for which (byte & mask) == match and is
+ * len bytes long, the first one included.  None of the bytes after the
+ * first may have a bit of body_mask set; a packet that breaks this was
+ * cut short by the start of another.
+ */
+struct ts_serial_packet {
+	unsigned char	mask;
+	unsigned char	match;
+	unsigned char	len;
+	unsigned char	body_mask;
+};
+
+struct ts_serial {
+	const struct ts_serial_packet *packets;
+	int		nr_packets;
+	unsigned long	skipped;	/* bytes dropped to find a packet */
+	int		head;		/* first byte not yet framed */
+	int		tail;		/* end of what was read */
+	unsigned char	buf[TS_SERIAL_BUF];
+};
+
+TSAPI void ts_serial_init(struct ts_serial *s,
+			  const struct ts_serial_packet *packets, int nr);
+
+/*
+ * Reads as much as there is room for, with one read().  Returns what
+ * read() returned.
+ */
+TSAPI int ts_serial_fill(struct ts_serial *s, int fd);
+
+/*
+ * Returns the next complete packet, where it lies in the buffer, and
+ * sets *type to its index in the packet table.  It stays valid until
+ * the next ts_serial_fill().  NULL means more bytes are needed.
+ */
+TSAPI const unsigned char *ts_serial_next(struct ts_serial *s, int *type);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _TSLIB_SERIAL_H_ */
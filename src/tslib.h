@@ -38,6 +38,7 @@ extern "C" {
 #endif // TSLIB_INTERNAL
 
 struct tsdev;
+struct ts_reactor;
 
 struct ts_sample {
 	int		x;
@@ -46,9 +47,132 @@ struct ts_sample {
 	struct timeval	tv;
 };
 
+#define TS_MAX_CONTACTS		10	/* tracked at once */
+
+#define TS_CONTACT_DOWN		1	/* the first sample of a contact */
+#define TS_CONTACT_MOVE		2
+#define TS_CONTACT_UP		3	/* it is gone, at its last position */
+
+/*
+ * A sample of one of the contacts of a multi-touch device.  The track
+ * filter gives each contact an id, the same from down to up and below
+ * TS_MAX_CONTACTS; without it every id is -1 and a contact is only
+ * told to be up by its pressure of 0.
+ */
+struct ts_contact {
+	struct ts_sample samp;
+	int		id;
+	int		state;		/* TS_CONTACT_* */
+};
+
+/* Range of one absolute axis, as reported by the kernel */
+struct ts_absinfo {
+	int		value;
+	int		minimum;
+	int		maximum;
+	int		fuzz;
+	int		flat;
+	int		resolution;	/* units per mm, 0 if unknown */
+};
+
+#define TS_CAP_EVDEV		0x0001	/* Linux input event device */
+#define TS_CAP_OLD_API		0x0002	/* event protocol 1.0.0 */
+#define TS_CAP_SYN		0x0004	/* EV_SYN */
+#define TS_CAP_KEY		0x0008	/* EV_KEY */
+#define TS_CAP_ABS		0x0010	/* EV_ABS */
+#define TS_CAP_ABS_XY		0x0020	/* ABS_X and ABS_Y, see x and y */
+#define TS_CAP_PRESSURE		0x0040	/* ABS_PRESSURE, see pressure */
+#define TS_CAP_BTN_TOUCH	0x0080	/* BTN_TOUCH */
+#define TS_CAP_MT		0x0100	/* ABS_MT_POSITION_X/Y, see mt_x, mt_y */
+#define TS_CAP_MT_SLOT		0x0200	/* ABS_MT_SLOT, see mt_slot */
+
+/*
+ * What the device reported when it was opened.  Fields that go with
+ * a flag that is not set are zero.
+ */
+struct ts_caps {
+	unsigned int	flags;
+	int		version;	/* event protocol version */
+	struct ts_absinfo x;
+	struct ts_absinfo y;
+	struct ts_absinfo pressure;
+	struct ts_absinfo mt_x;
+	struct ts_absinfo mt_y;
+	struct ts_absinfo mt_slot;
+};
+
+/*
+ * Counted by the raw modules that read whole frames of a sensor grid
+ * and find the contacts in them.  Times are in ns; a frame is late when
+ * finding its contacts took longer than the sensor takes to scan one.
+ *
+ * The wakeups and wakes are counted by the power module: wakeups are
+ * the reads that came back from the device, wakeups * 1e9 / wakeup_ns
+ * of them a second.  A wake is a touch that ended idling, and wake_ns
+ * the time from it to the next read, at the full rate again.
+ *
+ * drops counts the times the kernel's event buffer overflowed, as the
+ * application did not read fast enough; drop_events the events thrown
+ * away until the device state was read again.
+ */
+struct ts_stats {
+	unsigned long	frames;		/* searched for contacts */
+	unsigned long	frames_late;
+	unsigned long	frame_ns;	/* the last frame took */
+	unsigned long	frame_ns_max;
+	unsigned long long frame_ns_total;
+	unsigned long	frame_period_ns; /* at the scan rate in use */
+	unsigned long	wakeups;
+	unsigned long long wakeup_ns;	/* since the first read */
+	unsigned long	wakes;
+	unsigned long	wake_ns;	/* the last wake took */
+	unsigned long	wake_ns_max;
+	unsigned long	drops;		/* SYN_DROPPED */
+	unsigned long	drop_events;
+};
+
+/* A sample read through a ts_reactor, with the device it came from */
+struct ts_reactor_sample {
+	int		index;		/* as returned by ts_reactor_add() */
+	struct ts_sample samp;
+};
+
+/*
+ * Called by ts_reactor_wait() with the samples read from one device,
+ * or with samp NULL and nr -1 when the device failed.
+ */
+typedef void (*ts_reactor_fn)(void *data, int index,
+			      struct ts_sample *samp, int nr);
+
 enum ts_param {
 	TS_SCREEN_RES = 0,						/* 2 integer args, x and y */
 	TS_SCREEN_ROT,							/* 1 integer arg, 1 = rotate */
+	TS_COALESCE,							/* 1 integer arg, 1 = ts_read() merges moves */
+	TS_VSYNC,							/* 2 integer args, see below */
+};
+
+/*
+ * ts_option(ts, TS_VSYNC, period, lead) paces ts_read() to the display.
+ * While the screen is touched, each call waits for the next frame and
+ * returns one sample, where the touch is at the scanout lead us after
+ * it; a press and a release still each come out.  The frames are the
+ * vsyncs of TSLIB_FBDEVICE with period 0, or come every period us.  A
+ * lead of -1 is one period, when the frame drawn after a vsync shows.
+ * A period of -1 turns it off.
+ */
+
+/*
+ * A sample read with ts_read_coalesced(): the latest of a run of moves,
+ * with how many there were and the box around them.  A press or a
+ * release always comes on its own, with count 1.
+ */
+struct ts_coalesced {
+	struct ts_sample samp;
+	int		count;
+	int		x_min;
+	int		y_min;
+	int		x_max;
+	int		y_max;
 };
 
 /*
@@ -71,11 +195,27 @@ TSAPI int ts_option(struct tsdev *, enum ts_param, ...);
  */
 extern TSAPI int (*ts_error_fn)(const char *fmt, va_list ap);
 
+/*
+ * Tell the filters that the last press was aimed at screen position
+ * x, y, such as the center of the button it activated.
+ */
+TSAPI int ts_target_hint(struct tsdev *, int x, int y);
+
 /*
  * Returns the file descriptor in use for the touchscreen device.
  */
 TSAPI int ts_fd(struct tsdev *);
 
+/*
+ * Returns the capabilities probed when the device was opened.
+ */
+TSAPI const struct ts_caps *ts_get_caps(struct tsdev *);
+
+/*
+ * Copies the counters of the device to stats.
+ */
+TSAPI int ts_get_stats(struct tsdev *, struct ts_stats *stats);
+
 /*
  * Load a filter/scaling module
  */
@@ -87,16 +227,59 @@ TSAPI int ts_load_module(struct tsdev *, const char *mod, const char *params);
 TSAPI struct tsdev *ts_open(const char *dev_name, int nonblock);
 TSAPI struct tsdev *ts_open_config(int nonblock, int xres, int yres);
 
+/*
+ * Use a descriptor that is already open, such as a serial port set up
+ * by the caller.  Nothing is checked and no modules are loaded; follow
+ * with ts_config() or ts_load_module().  ts_close() closes fd.
+ */
+TSAPI struct tsdev *ts_open_fd(int fd);
+
 /*
  * Return a scaled touchscreen sample.
  */
 TSAPI int ts_read(struct tsdev *, struct ts_sample *, int);
 
+/*
+ * Return scaled samples of each contact, with their ids, through the
+ * filters that know of contacts.
+ */
+TSAPI int ts_read_mt(struct tsdev *, struct ts_contact *, int);
+
+/*
+ * Reads all the device has, and merges each run of moves into its
+ * latest sample.  Blocks, if the device does, only when there is
+ * nothing at all.  ts_option(ts, TS_COALESCE, 1) makes ts_read() do
+ * the same.
+ */
+TSAPI int ts_read_coalesced(struct tsdev *, struct ts_coalesced *, int);
+
 /*
  * Returns a raw, unscaled sample from the touchscreen.
  */
 TSAPI int ts_read_raw(struct tsdev *, struct ts_sample *, int);
 
+/*
+ * Wait on several touchscreens from one thread.  ts_reactor_add() takes
+ * over a configured device, makes it non-blocking and returns its index.
+ * ts_reactor_wait() runs the filter chain of every device that became
+ * readable within timeout milliseconds (-1 waits for ever) and hands the
+ * samples to fn; ts_reactor_read() returns them instead, tagged, up to nr
+ * at a time.  Both return the number of samples, or -1.  A device that
+ * fails is no longer waited on, until ts_reactor_remove() gives it back.
+ * ts_reactor_fd() is readable whenever a device is, for applications
+ * with a main loop of their own.  ts_reactor_free() closes the devices
+ * still in the reactor.
+ */
+TSAPI struct ts_reactor *ts_reactor_new(void);
+TSAPI int ts_reactor_add(struct ts_reactor *, struct tsdev *);
+TSAPI struct tsdev *ts_reactor_remove(struct ts_reactor *, int index);
+TSAPI int ts_reactor_wait(struct ts_reactor *, int timeout,
+			  ts_reactor_fn fn, void *data);
+TSAPI int ts_reactor_read(struct ts_reactor *, struct ts_reactor_sample *,
+			  int nr, int timeout);
+TSAPI int ts_reactor_fd(struct ts_reactor *);
+TSAPI void ts_reactor_free(struct ts_reactor *);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
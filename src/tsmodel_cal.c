@@ -0,0 +1,677 @@
+/*
+ *  tslib/src/tsmodel_cal.c
+ *
+ * This file is placed under the LGPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Fit affine, quadrant, quadratic and cubic calibrations to a set of
+ * points.  Each model is scored with k-fold cross validation on its
+ * own thread, and the one that best predicts the held out points wins.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "tsmodel_cal.h"
+
+/*
+ * Terms are evaluated on readings normalized to 0..1, in this order:
+ *	1 i j ij i2 j2 i3 i2j ij2 j3
+ * The first six match perform_n_point_calibration(), so a quadratic
+ * result can be printed in the same coefficient order.
+ */
+static const char * const model_names[CAL_NR_MODELS] = {
+	"affine", "quadrant", "quadratic", "cubic",
+};
+
+static const int model_terms[CAL_NR_MODELS] = { 3, 3, 6, 10 };
+
+/* Points within this (normalized) distance of a diagonal are fitted
+ * into both quadrants that share it, the corners and the center in
+ * particular.
+ */
+#define QUAD_EDGE	0.02
+
+#define ABSL(v)		((v) < 0 ? -(v) : (v))
+
+struct cal_scale {
+	double xmax;
+	double ymax;
+	double imax;
+	double jmax;
+};
+
+struct model_fit {
+	int nregions;
+	double cx[CAL_MAX_REGIONS][CAL_MAX_TERMS];
+	double cy[CAL_MAX_REGIONS][CAL_MAX_TERMS];
+};
+
+const char *model_calibration_name(int model)
+{
+	if (model < 0 || model >= CAL_NR_MODELS)
+		return NULL;
+	return model_names[model];
+}
+
+int model_calibration_lookup(const char *name)
+{
+	int model;
+
+	for (model = 0; model < CAL_NR_MODELS; model++)
+		if (!strcmp(model_names[model], name))
+			return model;
+	return -1;
+}
+
+int model_calibration_terms(int model)
+{
+	if (model < 0 || model >= CAL_NR_MODELS)
+		return 0;
+	return model_terms[model];
+}
+
+static void get_terms(double i, double j, long double *t)
+{
+	t[0] = 1;
+	t[1] = i;
+	t[2] = j;
+	t[3] = i * j;
+	t[4] = i * i;
+	t[5] = j * j;
+	t[6] = t[4] * i;
+	t[7] = t[4] * j;
+	t[8] = t[5] * i;
+	t[9] = t[5] * j;
+}
+
+void cal_sums_init(struct cal_sums *sums, int nterms)
+{
+	memset(sums, 0, sizeof(*sums));
+	sums->nterms = nterms;
+}
+
+/* Symmetrical matrix, only the upper half is accumulated */
+void cal_sums_add(struct cal_sums *sums, double i, double j,
+		double x, double y)
+{
+	long double t[CAL_MAX_TERMS];
+	int n = sums->nterms;
+	int row, col;
+
+	get_terms(i, j, t);
+	for (row = 0; row < n; row++) {
+		for (col = row; col < n; col++)
+			sums->s[row * CAL_MAX_TERMS + col] += t[row] * t[col];
+		sums->rx[row] += x * t[row];
+		sums->ry[row] += y * t[row];
+	}
+	sums->xx += x * x;
+	sums->yy += y * y;
+	sums->n++;
+}
+
+static void cal_sums_combine(struct cal_sums *dst,
+		const struct cal_sums *src, int sign)
+{
+	int k;
+
+	for (k = 0; k < CAL_MAX_TERMS * CAL_MAX_TERMS; k++)
+		dst->s[k] += sign * src->s[k];
+	for (k = 0; k < CAL_MAX_TERMS; k++) {
+		dst->rx[k] += sign * src->rx[k];
+		dst->ry[k] += sign * src->ry[k];
+	}
+	dst->xx += sign * src->xx;
+	dst->yy += sign * src->yy;
+	if (sign > 0)
+		dst->n += src->n;
+	else
+		dst->n -= src->n;
+}
+
+void cal_sums_merge(struct cal_sums *dst, const struct cal_sums *src)
+{
+	cal_sums_combine(dst, src, 1);
+}
+
+void cal_sums_subtract(struct cal_sums *dst, const struct cal_sums *src)
+{
+	cal_sums_combine(dst, src, -1);
+}
+
+/*
+ * Sum of squared distances, in pixels, between the points behind the
+ * sums and a fit of sums->nterms terms:
+ *	sum (x - c.t)^2 = xx - 2 c.rx + c'Sc
+ */
+double cal_sums_residual(const struct cal_sums *sums,
+		const double *cx, const double *cy, double xmax, double ymax)
+{
+	long double ex = sums->xx, ey = sums->yy;
+	int n = sums->nterms;
+	int row, col;
+
+	for (row = 0; row < n; row++) {
+		ex -= 2 * cx[row] * sums->rx[row];
+		ey -= 2 * cy[row] * sums->ry[row];
+		for (col = row; col < n; col++) {
+			long double s = sums->s[row * CAL_MAX_TERMS + col];
+
+			if (col != row)
+				s *= 2;
+			ex += s * cx[row] * cx[col];
+			ey += s * cy[row] * cy[col];
+		}
+	}
+	/* rounding can take an exact fit slightly negative */
+	if (ex < 0)
+		ex = 0;
+	if (ey < 0)
+		ey = 0;
+	return ex * xmax * xmax + ey * ymax * ymax;
+}
+
+/*
+ * Gaussian elimination with partial pivoting, solving for the x and y
+ * coefficients at the same time.  Terms past nterms are left alone.
+ */
+int cal_sums_solve(const struct cal_sums *sums, double *cx, double *cy)
+{
+	long double a[CAL_MAX_TERMS][CAL_MAX_TERMS + 2];
+	int n = sums->nterms;
+	int row, col, k;
+
+	if (sums->n < (unsigned long)n)
+		return -1;
+
+	for (row = 0; row < n; row++) {
+		for (col = 0; col < n; col++)
+			a[row][col] = (row <= col) ?
+				sums->s[row * CAL_MAX_TERMS + col] :
+				sums->s[col * CAL_MAX_TERMS + row];
+		a[row][n] = sums->rx[row];
+		a[row][n + 1] = sums->ry[row];
+	}
+
+	for (col = 0; col < n; col++) {
+		int pivot = col;
+
+		for (row = col + 1; row < n; row++)
+			if (ABSL(a[row][col]) > ABSL(a[pivot][col]))
+				pivot = row;
+		if (ABSL(a[pivot][col]) < 1e-12L * sums->n)
+			return -1;
+		if (pivot != col) {
+			for (k = col; k < n + 2; k++) {
+				long double t = a[col][k];
+				a[col][k] = a[pivot][k];
+				a[pivot][k] = t;
+			}
+		}
+		for (row = col + 1; row < n; row++) {
+			long double f = a[row][col] / a[col][col];
+
+			for (k = col; k < n + 2; k++)
+				a[row][k] -= f * a[col][k];
+		}
+	}
+
+	for (row = n - 1; row >= 0; row--) {
+		long double sx = a[row][n];
+		long double sy = a[row][n + 1];
+
+		for (k = row + 1; k < n; k++) {
+			sx -= a[row][k] * cx[k];
+			sy -= a[row][k] * cy[k];
+		}
+		cx[row] = sx / a[row][row];
+		cy[row] = sy / a[row][row];
+	}
+	return 0;
+}
+
+/* Same split as transform() in linear_quad, on normalized screen positions */
+static int quadrant_of(double u, double v)
+{
+	if (v >= u)
+		return (1 - v >= u) ? QUAD_LEFT : QUAD_BOTTOM;
+	return (1 - v >= u) ? QUAD_TOP : QUAD_RIGHT;
+}
+
+static int near_quadrant(int q, double u, double v)
+{
+	double d1 = v - u;
+	double d2 = v - (1 - u);
+
+	switch (q) {
+	case QUAD_TOP:
+		return d1 <= QUAD_EDGE && d2 <= QUAD_EDGE;
+	case QUAD_LEFT:
+		return d1 >= -QUAD_EDGE && d2 <= QUAD_EDGE;
+	case QUAD_BOTTOM:
+		return d1 >= -QUAD_EDGE && d2 >= -QUAD_EDGE;
+	case QUAD_RIGHT:
+		return d1 <= QUAD_EDGE && d2 >= -QUAD_EDGE;
+	}
+	return 0;
+}
+
+static int fit_points(const struct cal_data *cal, const int *use, int n,
+		const struct cal_scale *sc, int model, struct model_fit *fit)
+{
+	struct cal_sums sums;
+	int nterms = model_terms[model];
+	int p, q;
+
+	memset(fit, 0, sizeof(*fit));
+	cal_sums_init(&sums, nterms);
+	for (p = 0; p < n; p++) {
+		const struct cal_data *d = &cal[use[p]];
+
+		cal_sums_add(&sums, d->i / sc->imax, d->j / sc->jmax,
+			     d->x / sc->xmax, d->y / sc->ymax);
+	}
+	if (cal_sums_solve(&sums, fit->cx[QUAD_MAIN], fit->cy[QUAD_MAIN]))
+		return -1;
+
+	fit->nregions = 1;
+	if (model != CAL_MODEL_QUADRANT)
+		return 0;
+
+	/*
+	 * A quadrant without enough points of its own keeps using the
+	 * main fit, which is what the missing points would have voted for.
+	 */
+	fit->nregions = CAL_MAX_REGIONS;
+	for (q = QUAD_TOP; q <= QUAD_RIGHT; q++) {
+		cal_sums_init(&sums, nterms);
+		for (p = 0; p < n; p++) {
+			const struct cal_data *d = &cal[use[p]];
+
+			if (near_quadrant(q, d->x / sc->xmax, d->y / sc->ymax))
+				cal_sums_add(&sums, d->i / sc->imax,
+					     d->j / sc->jmax, d->x / sc->xmax,
+					     d->y / sc->ymax);
+		}
+		if (cal_sums_solve(&sums, fit->cx[q], fit->cy[q])) {
+			memcpy(fit->cx[q], fit->cx[QUAD_MAIN], sizeof(fit->cx[q]));
+			memcpy(fit->cy[q], fit->cy[QUAD_MAIN], sizeof(fit->cy[q]));
+		}
+	}
+	return 0;
+}
+
+static void eval_fit(const struct model_fit *fit, int nterms,
+		double i, double j, double *x, double *y)
+{
+	long double t[CAL_MAX_TERMS];
+	int q = QUAD_MAIN;
+	int k;
+
+	get_terms(i, j, t);
+	for (;;) {
+		long double sx = 0, sy = 0;
+
+		for (k = 0; k < nterms; k++) {
+			sx += fit->cx[q][k] * t[k];
+			sy += fit->cy[q][k] * t[k];
+		}
+		*x = sx;
+		*y = sy;
+		if (fit->nregions == 1 || q != QUAD_MAIN)
+			break;
+		q = quadrant_of(*x, *y);
+	}
+}
+
+/* rms distance in pixels between the fit and a set of points */
+static double fit_error(const struct model_fit *fit, int model,
+		const struct cal_data *cal, const int *use, int n,
+		const struct cal_scale *sc)
+{
+	double err = 0;
+	int p;
+
+	for (p = 0; p < n; p++) {
+		const struct cal_data *d = &cal[use[p]];
+		double x, y, dx, dy;
+
+		eval_fit(fit, model_terms[model], d->i / sc->imax,
+			 d->j / sc->jmax, &x, &y);
+		dx = x * sc->xmax - d->x;
+		dy = y * sc->ymax - d->y;
+		err += dx * dx + dy * dy;
+	}
+	return err;
+}
+
+/*
+ * Point p goes into fold p % folds, so every fold spans the whole
+ * screen for the ordered point lists our calibration tools produce.
+ */
+static double cross_validate(const struct cal_data *cal, int num_points,
+		const struct cal_scale *sc, int model, int folds)
+{
+	struct model_fit fit;
+	int *train, *test;
+	double err = 0;
+	int f, p;
+
+	if (folds > num_points)
+		folds = num_points;
+	if (folds < 2)
+		return HUGE_VAL;
+
+	train = malloc(2 * num_points * sizeof(int));
+	if (!train)
+		return HUGE_VAL;
+	test = train + num_points;
+
+	for (f = 0; f < folds; f++) {
+		int ntrain = 0, ntest = 0;
+
+		for (p = 0; p < num_points; p++) {
+			if (p % folds == f)
+				test[ntest++] = p;
+			else
+				train[ntrain++] = p;
+		}
+		if (fit_points(cal, train, ntrain, sc, model, &fit)) {
+			err = HUGE_VAL;
+			break;
+		}
+		err += fit_error(&fit, model, cal, test, ntest, sc);
+	}
+	free(train);
+
+	if (err == HUGE_VAL)
+		return err;
+	return sqrt(err / num_points);
+}
+
+static int store_fit(const struct model_fit *fit, int model,
+		const struct cal_scale *sc, struct cal_model_result *res)
+{
+	int q, k;
+
+	memset(res, 0, sizeof(*res));
+	res->model = model;
+	res->nterms = model_terms[model];
+	res->nregions = fit->nregions;
+	res->xmax = sc->xmax;
+	res->ymax = sc->ymax;
+	res->imax = sc->imax;
+	res->jmax = sc->jmax;
+	for (q = 0; q < fit->nregions; q++) {
+		for (k = 0; k < res->nterms; k++) {
+			double vx = fit->cx[q][k] * 65536;
+			double vy = fit->cy[q][k] * 65536;
+
+			if (vx >= 2147483647.0 || vx <= -2147483647.0 ||
+			    vy >= 2147483647.0 || vy <= -2147483647.0)
+				return -1;
+			res->x[q][k] = (s32)floor(vx + 0.5);
+			res->y[q][k] = (s32)floor(vy + 0.5);
+		}
+	}
+	return 0;
+}
+
+static int fit_model(struct cal_data *cal, int num_points,
+		const struct cal_scale *sc, int model,
+		struct cal_model_result *res)
+{
+	struct model_fit fit;
+	int *use;
+	int p, ret;
+
+	if (model < 0 || model >= CAL_NR_MODELS ||
+	    num_points < model_terms[model])
+		return -1;
+
+	use = malloc(num_points * sizeof(int));
+	if (!use)
+		return -1;
+	for (p = 0; p < num_points; p++)
+		use[p] = p;
+
+	ret = fit_points(cal, use, num_points, sc, model, &fit);
+	if (!ret)
+		ret = store_fit(&fit, model, sc, res);
+	if (!ret)
+		res->rms_error = sqrt(fit_error(&fit, model, cal, use,
+						num_points, sc) / num_points);
+	free(use);
+	return ret;
+}
+
+int store_model_calibration(int model,
+		const double *cx, const double *cy,
+		u32 xmax, u32 ymax, u32 imax, u32 jmax,
+		struct cal_model_result *res)
+{
+	struct cal_scale sc = { xmax, ymax, imax, jmax };
+	struct model_fit fit;
+
+	if (model < 0 || model >= CAL_NR_MODELS || model == CAL_MODEL_QUADRANT)
+		return -1;
+
+	fit.nregions = 1;
+	memcpy(fit.cx[QUAD_MAIN], cx, model_terms[model] * sizeof(double));
+	memcpy(fit.cy[QUAD_MAIN], cy, model_terms[model] * sizeof(double));
+	return store_fit(&fit, model, &sc, res);
+}
+
+int perform_model_calibration(struct cal_data *cal,
+		int num_points, u32 xmax, u32 ymax, u32 imax, u32 jmax,
+		int model, struct cal_model_result *res)
+{
+	struct cal_scale sc = { xmax, ymax, imax, jmax };
+
+	if (!xmax || !ymax || !imax || !jmax)
+		return -1;
+	return fit_model(cal, num_points, &sc, model, res);
+}
+
+struct model_job {
+	pthread_t thread;
+	struct cal_data *cal;
+	int num_points;
+	const struct cal_scale *sc;
+	int folds;
+	int model;
+	struct cal_model_result res;
+	int ret;
+};
+
+static void *model_job_run(void *arg)
+{
+	struct model_job *job = arg;
+	double err;
+
+	job->ret = -1;
+	if (job->num_points < model_terms[job->model])
+		return NULL;
+
+	err = cross_validate(job->cal, job->num_points, job->sc,
+			     job->model, job->folds);
+	if (err == HUGE_VAL)
+		return NULL;
+
+	job->ret = fit_model(job->cal, job->num_points, job->sc,
+			     job->model, &job->res);
+	job->res.rms_error = err;
+	return NULL;
+}
+
+int select_model_calibration(struct cal_data *cal,
+		int num_points, u32 xmax, u32 ymax, u32 imax, u32 jmax,
+		int folds, struct cal_model_result *res)
+{
+	struct cal_scale sc = { xmax, ymax, imax, jmax };
+	struct model_job job[CAL_NR_MODELS];
+	int started[CAL_NR_MODELS];
+	int best = -1;
+	int m;
+
+	if (!xmax || !ymax || !imax || !jmax)
+		return -1;
+
+	for (m = 0; m < CAL_NR_MODELS; m++) {
+		job[m].cal = cal;
+		job[m].num_points = num_points;
+		job[m].sc = &sc;
+		job[m].folds = folds;
+		job[m].model = m;
+		started[m] = !pthread_create(&job[m].thread, NULL,
+					     model_job_run, &job[m]);
+		if (!started[m])
+			model_job_run(&job[m]);
+	}
+
+	for (m = 0; m < CAL_NR_MODELS; m++) {
+		if (started[m])
+			pthread_join(job[m].thread, NULL);
+		if (job[m].ret) {
+			printf("%s: not enough points\n", model_names[m]);
+			continue;
+		}
+		printf("%s: cross validated error %.3f pixels\n",
+		       model_names[m], job[m].res.rms_error);
+		/* ties go to the simpler model */
+		if (best < 0 || job[m].res.rms_error < job[best].res.rms_error)
+			best = m;
+	}
+	if (best < 0)
+		return -1;
+
+	*res = job[best].res;
+	return 0;
+}
+
+static int get_long(const char **pp, const char *eol, long *v)
+{
+	const char *p = *pp;
+	char *end;
+
+	while (p < eol && (*p == ' ' || *p == '\t'))
+		p++;
+	if (p >= eol)
+		return -1;
+	*v = strtol(p, &end, 10);
+	if (end == p || end > eol)
+		return -1;
+	*pp = end;
+	return 0;
+}
+
+static int get_word(const char **pp, const char *eol, char *word, int len)
+{
+	const char *p = *pp;
+	int n = 0;
+
+	while (p < eol && (*p == ' ' || *p == '\t'))
+		p++;
+	while (p < eol && *p != ' ' && *p != '\t' && *p != '\r') {
+		if (n < len - 1)
+			word[n++] = *p;
+		p++;
+	}
+	word[n] = 0;
+	*pp = p;
+	return n ? 0 : -1;
+}
+
+/*
+ * The file is what write_model_calibration() produces:
+ *	model <name>
+ *	size <xmax> <ymax> <imax> <jmax>
+ *	x <nterms coefficients>		one x and one y line per region
+ *	y <nterms coefficients>
+ * Blank lines and lines starting with '#' are ignored.
+ */
+int read_model_calibration(const char *buf, struct cal_model_result *res)
+{
+	const char *p = buf;
+	int xq = 0, yq = 0;
+
+	memset(res, 0, sizeof(*res));
+	res->model = -1;
+
+	while (*p) {
+		const char *eol = strchr(p, '\n');
+		char word[16];
+		long v[4];
+		int k;
+
+		if (!eol)
+			eol = p + strlen(p);
+
+		if (get_word(&p, eol, word, sizeof(word)) || word[0] == '#') {
+			/* blank line or comment */
+		} else if (!strcmp(word, "model")) {
+			if (get_word(&p, eol, word, sizeof(word)))
+				return -1;
+			res->model = model_calibration_lookup(word);
+			if (res->model < 0)
+				return -1;
+			res->nterms = model_terms[res->model];
+			res->nregions = (res->model == CAL_MODEL_QUADRANT) ?
+				CAL_MAX_REGIONS : 1;
+		} else if (!strcmp(word, "size")) {
+			for (k = 0; k < 4; k++)
+				if (get_long(&p, eol, &v[k]) || v[k] <= 0)
+					return -1;
+			res->xmax = v[0];
+			res->ymax = v[1];
+			res->imax = v[2];
+			res->jmax = v[3];
+		} else if (!strcmp(word, "x") || !strcmp(word, "y")) {
+			int *nq = (word[0] == 'x') ? &xq : &yq;
+			s32 *a;
+
+			if (res->model < 0 || *nq >= res->nregions)
+				return -1;
+			a = (word[0] == 'x') ? res->x[*nq] : res->y[*nq];
+			for (k = 0; k < res->nterms; k++) {
+				if (get_long(&p, eol, &v[0]))
+					return -1;
+				a[k] = v[0];
+			}
+			(*nq)++;
+		} else {
+			return -1;
+		}
+		p = *eol ? eol + 1 : eol;
+	}
+
+	if (res->model < 0 || !res->xmax ||
+	    xq != res->nregions || yq != res->nregions)
+		return -1;
+	return 0;
+}
+
+int write_model_calibration(FILE *f, const struct cal_model_result *res)
+{
+	int q, k;
+
+	fprintf(f, "# rms error %.3f pixels\n", res->rms_error);
+	fprintf(f, "model %s\n", model_names[res->model]);
+	fprintf(f, "size %u %u %u %u\n",
+		res->xmax, res->ymax, res->imax, res->jmax);
+	for (q = 0; q < res->nregions; q++) {
+		fprintf(f, "x");
+		for (k = 0; k < res->nterms; k++)
+			fprintf(f, " %d", res->x[q][k]);
+		fprintf(f, "\ny");
+		for (k = 0; k < res->nterms; k++)
+			fprintf(f, " %d", res->y[q][k]);
+		fprintf(f, "\n");
+	}
+	return ferror(f) ? -1 : 0;
+}
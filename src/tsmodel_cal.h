@@ -0,0 +1,101 @@
+#ifndef _TSMODEL_CAL_H_
+#define _TSMODEL_CAL_H_
+/*
+ *  tslib/src/tsmodel_cal.h
+ *
+ * This file is placed under the LGPL.
+ *
+ *
+ * Least squares calibration models of increasing order, with
+ * cross validated selection of the best one for a set of points.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdio.h>
+#include <tsquadrant_cal.h>
+
+enum cal_model {
+	CAL_MODEL_AFFINE = 0,		/* 1 i j */
+	CAL_MODEL_QUADRANT,		/* affine, one per screen quadrant */
+	CAL_MODEL_QUADRATIC,		/* 1 i j ij i2 j2 */
+	CAL_MODEL_CUBIC,		/* 1 i j ij i2 j2 i3 i2j ij2 j3 */
+	CAL_NR_MODELS
+};
+
+#define CAL_MAX_TERMS	10
+#define CAL_MAX_REGIONS	5	/* QUAD_MAIN .. QUAD_RIGHT */
+
+/*
+ * Coefficients are 16.16 fixed point and map touchscreen readings
+ * normalized to i/imax, j/jmax onto screen positions normalized to
+ * x/xmax, y/ymax.  The quadrant model uses region QUAD_MAIN to pick
+ * one of the four others, exactly like linear_quad does for the
+ * ts_calibrate_quadrant points.
+ */
+struct cal_model_result {
+	int	model;
+	int	nterms;
+	int	nregions;
+	u32	xmax;
+	u32	ymax;
+	u32	imax;
+	u32	jmax;
+	s32	x[CAL_MAX_REGIONS][CAL_MAX_TERMS];
+	s32	y[CAL_MAX_REGIONS][CAL_MAX_TERMS];
+	double	rms_error;	/* pixels, cross validated when selected */
+};
+
+/*
+ * Normal equations of one polynomial fit, built a point at a time
+ * so that the points themselves never have to be kept around.  The
+ * terms nest, so sums built for the cubic model can be solved as any
+ * of the simpler ones by lowering nterms.
+ */
+struct cal_sums {
+	int		nterms;
+	unsigned long	n;
+	long double	s[CAL_MAX_TERMS * CAL_MAX_TERMS];
+	long double	rx[CAL_MAX_TERMS];
+	long double	ry[CAL_MAX_TERMS];
+	long double	xx;		/* for residuals of a given fit */
+	long double	yy;
+};
+
+TSAPI extern const char *model_calibration_name(int model);
+TSAPI extern int model_calibration_lookup(const char *name);
+TSAPI extern int model_calibration_terms(int model);
+
+TSAPI extern void cal_sums_init(struct cal_sums *sums, int nterms);
+TSAPI extern void cal_sums_add(struct cal_sums *sums, double i, double j,
+		double x, double y);
+TSAPI extern int cal_sums_solve(const struct cal_sums *sums,
+		double *cx, double *cy);
+TSAPI extern void cal_sums_merge(struct cal_sums *dst,
+		const struct cal_sums *src);
+TSAPI extern void cal_sums_subtract(struct cal_sums *dst,
+		const struct cal_sums *src);
+TSAPI extern double cal_sums_residual(const struct cal_sums *sums,
+		const double *cx, const double *cy, double xmax, double ymax);
+
+TSAPI extern int perform_model_calibration(struct cal_data *cal,
+		int num_points, u32 xmax, u32 ymax, u32 imax, u32 jmax,
+		int model, struct cal_model_result *res);
+TSAPI extern int select_model_calibration(struct cal_data *cal,
+		int num_points, u32 xmax, u32 ymax, u32 imax, u32 jmax,
+		int folds, struct cal_model_result *res);
+TSAPI extern int store_model_calibration(int model,
+		const double *cx, const double *cy,
+		u32 xmax, u32 ymax, u32 imax, u32 jmax,
+		struct cal_model_result *res);
+
+TSAPI extern int read_model_calibration(const char *buf,
+		struct cal_model_result *res);
+TSAPI extern int write_model_calibration(FILE *f,
+		const struct cal_model_result *res);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _TSMODEL_CAL_H_ */
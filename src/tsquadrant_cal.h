@@ -1,3 +1,5 @@
+#ifndef _TSQUADRANT_CAL_H_
+#define _TSQUADRANT_CAL_H_
 #include <tslib.h>
 
 #define u64 unsigned long long
@@ -37,3 +39,4 @@ TSAPI extern int perform_q_calibration(struct cal_data *cal, struct cal_result *
 TSAPI extern int perform_n_point_calibration(struct cal_data *cal,
 		int num_points, u32 xmax, u32 ymax, u32 imax, u32 jmax,
 		struct cal_result *res);
+#endif /* _TSQUADRANT_CAL_H_ */
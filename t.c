@@ -0,0 +1,7 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "tslib.h"
+int main(int argc,char**argv){ int p[2]; pipe(p);
+ struct tsdev *ts=ts_open_fd(p[0]);
+ int r=ts_config(ts);
+ printf("config %d\n",r); return 0;}
@@ -0,0 +1,877 @@
+/*
+ *  tslib/tests/emulate.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Touchscreens without the hardware.  A generator thread writes what a
+ * driver would, to a pipe for the drivers that hand out event records
+ * and to a pty for the serial ones, and the raw module reads the other
+ * end as it would read the device.
+ */
+#define _GNU_SOURCE	/* posix_openpt(), ptsname() and cfmakeraw() */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <linux/input.h>
+
+#include "tslib-private.h"
+#include "emulate.h"
+
+/* the most bytes a protocol writes for one sample */
+#define EMU_MAX_RECORD	(5 * sizeof(struct input_event))
+
+#define EMU_STALL	2000	/* ms without a sample before giving up */
+
+/* what the drivers of the raw modules hand out */
+struct corgi_ts_event {
+	short pressure;
+	short x;
+	short y;
+	short millisecs;
+};
+
+struct ucb1x00_ts_event {
+	unsigned short pressure;
+	unsigned short x;
+	unsigned short y;
+	unsigned short pad;
+	struct timeval stamp;
+};
+
+struct collie_ts_event {
+	long y;
+	long x;
+	long pressure;
+	long long millisecs;
+};
+
+struct h3600_ts_event {
+	unsigned short pressure;
+	unsigned short x;
+	unsigned short y;
+	unsigned short pad;
+};
+
+struct mk712_ts_event {
+	unsigned int header;
+	unsigned int x;
+	unsigned int y;
+	unsigned int reserved;
+};
+
+struct arctic2_ts_event {
+	signed short pressure;
+	signed int x;
+	signed int y;
+	int millisecs;
+	int flags;
+};
+
+struct tatung_ts_event {
+	unsigned char x1;
+	unsigned char x2;
+	unsigned char y1;
+	unsigned char y2;
+};
+
+static long emu_ms(const struct timeval *tv)
+{
+	return tv->tv_sec * 1000 + tv->tv_usec / 1000;
+}
+
+static int input_event(struct emu_dev *d, unsigned char *buf,
+		       int type, int code, int value)
+{
+	struct input_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.time = d->now;
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static int input_encode(struct emu_dev *d, const struct ts_sample *s,
+			unsigned char *buf)
+{
+	int len = 0;
+
+	if (s->pressure) {
+		len += input_event(d, buf + len, EV_ABS, ABS_X, s->x);
+		len += input_event(d, buf + len, EV_ABS, ABS_Y, s->y);
+		len += input_event(d, buf + len, EV_ABS, ABS_PRESSURE, s->pressure);
+		if (!d->pressed)
+			len += input_event(d, buf + len, EV_KEY, BTN_TOUCH, 1);
+	} else {
+		len += input_event(d, buf + len, EV_ABS, ABS_PRESSURE, 0);
+		len += input_event(d, buf + len, EV_KEY, BTN_TOUCH, 0);
+	}
+	len += input_event(d, buf + len, EV_SYN, SYN_REPORT, 0);
+	d->pressed = s->pressure != 0;
+	return len;
+}
+
+static void input_expect(const struct ts_sample *in,
+			 const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	if (in->pressure) {
+		out->x = in->x;
+		out->y = in->y;
+		out->pressure = in->pressure;
+	}
+}
+
+static int corgi_encode(struct emu_dev *d, const struct ts_sample *s,
+			unsigned char *buf)
+{
+	struct corgi_ts_event ev;
+
+	ev.pressure = s->pressure;
+	ev.x = s->x;
+	ev.y = s->y;
+	ev.millisecs = emu_ms(&d->now);
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static void corgi_expect(const struct ts_sample *in,
+			 const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	out->x = (short)in->x;
+	out->y = (short)in->y;
+	out->pressure = (short)in->pressure;
+}
+
+static int ucb1x00_encode(struct emu_dev *d, const struct ts_sample *s,
+			  unsigned char *buf)
+{
+	struct ucb1x00_ts_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.pressure = s->pressure;
+	ev.x = s->x;
+	ev.y = s->y;
+	ev.stamp = d->now;
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static void ushort_expect(const struct ts_sample *in,
+			  const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	out->x = (unsigned short)in->x;
+	out->y = (unsigned short)in->y;
+	out->pressure = (unsigned short)in->pressure;
+}
+
+static int collie_encode(struct emu_dev *d, const struct ts_sample *s,
+			 unsigned char *buf)
+{
+	struct collie_ts_event ev;
+
+	ev.pressure = s->pressure;
+	ev.x = s->x;
+	ev.y = s->y;
+	ev.millisecs = emu_ms(&d->now);
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static void exact_expect(const struct ts_sample *in,
+			 const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	out->x = in->x;
+	out->y = in->y;
+	out->pressure = in->pressure;
+}
+
+static int h3600_encode(struct emu_dev *d, const struct ts_sample *s,
+			unsigned char *buf)
+{
+	struct h3600_ts_event ev;
+
+	(void)d;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.pressure = s->pressure;
+	ev.x = s->x;
+	ev.y = s->y;
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static int mk712_encode(struct emu_dev *d, const struct ts_sample *s,
+			unsigned char *buf)
+{
+	struct mk712_ts_event ev;
+
+	(void)d;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.header = s->pressure ? 0 : 1;
+	ev.x = s->x;
+	ev.y = s->y;
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static void mk712_expect(const struct ts_sample *in,
+			 const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	out->x = (short)in->x;
+	out->y = (short)in->y;
+	out->pressure = in->pressure != 0;
+}
+
+static int arctic2_encode(struct emu_dev *d, const struct ts_sample *s,
+			  unsigned char *buf)
+{
+	struct arctic2_ts_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.pressure = s->pressure;
+	ev.x = s->x;
+	ev.y = s->y;
+	ev.millisecs = emu_ms(&d->now);
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static void arctic2_expect(const struct ts_sample *in,
+			   const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	out->x = (short)in->x;
+	out->y = (short)in->y;
+	out->pressure = (short)in->pressure;
+}
+
+/* digits of base 31 with an offset; a 240 anywhere is the pen going up */
+static int tatung_encode(struct emu_dev *d, const struct ts_sample *s,
+			 unsigned char *buf)
+{
+	struct tatung_ts_event ev;
+
+	(void)d;
+
+	if (s->pressure) {
+		ev.x1 = (s->x + 64) / 31;
+		ev.x2 = (s->x + 64) % 31;
+		ev.y1 = (s->y + 192) / 31;
+		ev.y2 = (s->y + 192) % 31;
+	} else {
+		memset(&ev, 240, sizeof(ev));
+	}
+	memcpy(buf, &ev, sizeof(ev));
+	return sizeof(ev);
+}
+
+static void tatung_expect(const struct ts_sample *in,
+			  const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	if (in->pressure) {
+		out->x = in->x;
+		out->y = in->y;
+		out->pressure = 1;
+	}
+}
+
+/* 0x80 or 0x81 for up or down, then x and y in two 7 bit bytes each */
+static int touchkit_encode(struct emu_dev *d, const struct ts_sample *s,
+			   unsigned char *buf)
+{
+	(void)d;
+
+	buf[0] = s->pressure ? 0x81 : 0x80;
+	buf[1] = (s->x >> 7) & 0x0f;
+	buf[2] = s->x & 0x7f;
+	buf[3] = (s->y >> 7) & 0x0f;
+	buf[4] = s->y & 0x7f;
+	return 5;
+}
+
+static void touchkit_expect(const struct ts_sample *in,
+			    const struct ts_sample *last, struct ts_sample *out)
+{
+	(void)last;
+
+	out->x = in->x & 0x7ff;
+	out->y = in->y & 0x7ff;
+	out->pressure = in->pressure ? 200 : 0;
+}
+
+/* 0x11 and big endian x and y for a touch, a lone 0x10 for the release */
+static int dmc_encode(struct emu_dev *d, const struct ts_sample *s,
+		      unsigned char *buf)
+{
+	(void)d;
+
+	if (!s->pressure) {
+		buf[0] = 0x10;
+		return 1;
+	}
+	buf[0] = 0x11;
+	buf[1] = (s->x >> 8) & 0xff;
+	buf[2] = s->x & 0xff;
+	buf[3] = (s->y >> 8) & 0xff;
+	buf[4] = s->y & 0xff;
+	return 5;
+}
+
+static void dmc_expect(const struct ts_sample *in,
+		       const struct ts_sample *last, struct ts_sample *out)
+{
+	if (in->pressure) {
+		out->x = in->x & 0xffff;
+		out->y = in->y & 0xffff;
+		out->pressure = 100;
+	} else {
+		out->x = last->x;
+		out->y = last->y;
+	}
+}
+
+#define EMU_INPUT_CAPS	(TS_CAP_EVDEV | TS_CAP_SYN | TS_CAP_KEY | TS_CAP_ABS | \
+			 TS_CAP_ABS_XY | TS_CAP_PRESSURE | TS_CAP_BTN_TOUCH)
+
+const struct emu_proto emu_protos[] = {
+	{ "input",	0, EMU_INPUT_CAPS, NULL, input_encode, input_expect },
+	{ "corgi",	0, 0, NULL, corgi_encode, corgi_expect },
+	{ "ucb1x00",	0, 0, NULL, ucb1x00_encode, ushort_expect },
+	{ "collie",	0, 0, NULL, collie_encode, exact_expect },
+	{ "h3600",	0, 0, NULL, h3600_encode, ushort_expect },
+	{ "mk712",	0, 0, NULL, mk712_encode, mk712_expect },
+	{ "arctic2",	0, 0, NULL, arctic2_encode, arctic2_expect },
+	{ "tatung",	0, 0, NULL, tatung_encode, tatung_expect },
+	{ "touchkit",	1, 0, NULL, touchkit_encode, touchkit_expect },
+	/* acks the setup the module sends */
+	{ "dmc",	1, 0, "\x06", dmc_encode, dmc_expect },
+};
+
+const int emu_nr_protos = sizeof(emu_protos) / sizeof(emu_protos[0]);
+
+const struct emu_proto *emu_find(const char *name)
+{
+	int k;
+
+	for (k = 0; k < emu_nr_protos; k++)
+		if (!strcmp(emu_protos[k].name, name))
+			return &emu_protos[k];
+	return NULL;
+}
+
+/* Returns the slave end, in raw mode as a serial port would be */
+static int emu_pty(int *master)
+{
+	struct termios t;
+	int m, s;
+
+	m = posix_openpt(O_RDWR | O_NOCTTY);
+	if (m < 0) {
+		perror("posix_openpt");
+		return -1;
+	}
+	if (grantpt(m) || unlockpt(m) ||
+	    (s = open(ptsname(m), O_RDWR | O_NOCTTY)) < 0) {
+		perror("pty");
+		close(m);
+		return -1;
+	}
+	tcgetattr(s, &t);
+	cfmakeraw(&t);
+	tcsetattr(s, TCSANOW, &t);
+	*master = m;
+	return s;
+}
+
+static int emu_write(int fd, const unsigned char *buf, int len)
+{
+	while (len) {
+		int ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+struct emu_dev *emu_open(const struct emu_proto *proto, const char *params)
+{
+	struct emu_dev *d;
+	struct ts_sample samp;
+	int fds[2];
+	int fd, flags;
+
+	d = calloc(1, sizeof(struct emu_dev));
+	if (d == NULL)
+		return NULL;
+	d->proto = proto;
+	d->feed = -1;
+
+	if (proto->serial) {
+		fd = emu_pty(&d->feed);
+		if (fd < 0)
+			goto fail;
+	} else {
+		if (pipe(fds)) {
+			perror("pipe");
+			goto fail;
+		}
+		fd = fds[0];
+		d->feed = fds[1];
+	}
+
+	d->ts = ts_open_fd(fd);
+	if (!d->ts) {
+		close(fd);
+		goto fail;
+	}
+
+	/* a pipe has nothing to probe, so say what an event device would */
+	if (proto->caps) {
+		d->ts->caps.flags = proto->caps;
+		d->ts->caps.version = EV_VERSION;
+	}
+	if (proto->answer &&
+	    emu_write(d->feed, (const unsigned char *)proto->answer,
+		      strlen(proto->answer)))
+		goto fail;
+
+	if (ts_load_module(d->ts, proto->name, params))
+		goto fail;
+
+	if (proto->serial) {
+		/* drop what the module said, and let it set the line up */
+		tcflush(d->feed, TCIFLUSH);
+		flags = fcntl(fd, F_GETFL);
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+		ts_read(d->ts, &samp, 1);
+		fcntl(fd, F_SETFL, flags);
+	}
+	return d;
+
+fail:
+	emu_close(d);
+	return NULL;
+}
+
+/*
+ * Sample n is due n / rate seconds after the start.  Whatever is due
+ * goes out with one write, as a driver that fell behind would hand it
+ * out, but never more than PIPE_BUF so that a pipe has no records cut
+ * in two.
+ */
+static void *emu_thread(void *arg)
+{
+	struct emu_dev *d = arg;
+	unsigned char buf[PIPE_BUF];
+	struct timespec start, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (d->sent < d->nr) {
+		int due = d->nr, len = 0;
+
+		if (d->rate) {
+			long long ns;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			ns = (now.tv_sec - start.tv_sec) * 1000000000LL +
+			     now.tv_nsec - start.tv_nsec;
+			due = ns * d->rate / 1000000000LL + 1;
+			if (due > d->nr)
+				due = d->nr;
+			if (due <= d->sent) {
+				ns = d->sent * 1000000000LL / d->rate;
+				now.tv_sec = start.tv_sec + ns / 1000000000LL;
+				now.tv_nsec = start.tv_nsec + ns % 1000000000LL;
+				if (now.tv_nsec >= 1000000000L) {
+					now.tv_nsec -= 1000000000L;
+					now.tv_sec++;
+				}
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+						&now, NULL);
+				continue;
+			}
+		}
+
+		gettimeofday(&d->now, NULL);
+		while (d->sent < due && len + EMU_MAX_RECORD <= sizeof(buf))
+			len += d->proto->encode(d, &d->samp[d->sent++], buf + len);
+		if (emu_write(d->feed, buf, len))
+			break;
+	}
+
+	/* a pty drops what is left to read when the master goes */
+	if (!d->proto->serial) {
+		close(d->feed);
+		d->feed = -1;
+	}
+	return NULL;
+}
+
+int emu_start(struct emu_dev *d, const struct ts_sample *samp, int nr, int rate)
+{
+	d->samp = samp;
+	d->nr = nr;
+	d->rate = rate;
+	d->sent = 0;
+	d->pressed = 0;
+	if (pthread_create(&d->thread, NULL, emu_thread, d))
+		return -1;
+	d->running = 1;
+	return 0;
+}
+
+int emu_wait(struct emu_dev *d)
+{
+	if (d->running) {
+		pthread_join(d->thread, NULL);
+		d->running = 0;
+	}
+	return d->sent;
+}
+
+void emu_close(struct emu_dev *d)
+{
+	/* closing the device end first stops a generator nobody reads */
+	if (d->ts)
+		ts_close(d->ts);
+	emu_wait(d);
+	if (d->feed >= 0)
+		close(d->feed);
+	free(d);
+}
+
+int emu_read(struct emu_dev *d, struct ts_sample *samp, int nr, int batch)
+{
+	struct pollfd pfd;
+	int n = 0, ret = 0;
+
+	pfd.fd = ts_fd(d->ts);
+	pfd.events = POLLIN;
+	while (n < nr) {
+		int want = nr - n < batch ? nr - n : batch;
+
+		/*
+		 * A module keeps what it read beyond a full batch, so the
+		 * device is only waited for once it came up short.  Never
+		 * more than is to come is asked for, so that no read waits
+		 * for samples that will not be sent.
+		 */
+		if (ret < want && poll(&pfd, 1, EMU_STALL) <= 0)
+			break;
+		ret = ts_read(d->ts, samp + n, want);
+		if (ret < 0)
+			break;
+		n += ret;
+	}
+	return n;
+}
+
+void emu_synth(struct ts_sample *samp, int nr, int xmax, int ymax,
+	       unsigned int seed)
+{
+	int n = 0;
+
+	memset(samp, 0, nr * sizeof(struct ts_sample));
+	while (n < nr) {
+		int len = 8 + rand_r(&seed) % 120;
+		int x0 = rand_r(&seed) % xmax, y0 = rand_r(&seed) % ymax;
+		int x1 = rand_r(&seed) % xmax, y1 = rand_r(&seed) % ymax;
+		int k;
+
+		/* a straight stroke, the pressure rising and falling */
+		for (k = 0; k < len && n < nr - 1; k++, n++) {
+			samp[n].x = x0 + (x1 - x0) * k / len;
+			samp[n].y = y0 + (y1 - y0) * k / len;
+			samp[n].pressure = 1 + 254 * (k < len / 2 ? k : len - k) / len;
+		}
+		samp[n].x = x0 + (x1 - x0) * k / len;
+		samp[n].y = y0 + (y1 - y0) * k / len;
+		n++;
+	}
+}
+
+int emu_script(const char *path, struct ts_sample **samp)
+{
+	struct ts_sample *s = NULL, *more;
+	char line[256];
+	FILE *f;
+	int nr = 0, size = 0;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char *p = strchr(line, ':');
+		int x, y;
+		unsigned int pressure;
+
+		if (line[0] == '#')
+			continue;
+		if (sscanf(p ? p + 1 : line, "%d %d %u", &x, &y, &pressure) != 3)
+			continue;
+		if (nr == size) {
+			size = size ? 2 * size : 1024;
+			more = realloc(s, size * sizeof(struct ts_sample));
+			if (!more) {
+				free(s);
+				fclose(f);
+				return -1;
+			}
+			s = more;
+		}
+		memset(&s[nr], 0, sizeof(struct ts_sample));
+		s[nr].x = x;
+		s[nr].y = y;
+		s[nr].pressure = pressure;
+		nr++;
+	}
+	fclose(f);
+	*samp = s;
+	return nr;
+}
+
+#define EMU_TRACE_MAGIC	"tslibtr1"
+#define EMU_TRACE_RECORD	16
+
+static unsigned int emu_le32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static void emu_put_le32(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+int emu_trace(const char *path, struct ts_sample **samp)
+{
+	unsigned char rec[EMU_TRACE_RECORD];
+	struct ts_sample *s = NULL, *more;
+	struct timeval tv = { 0, 0 };
+	FILE *f;
+	int nr = 0, size = 0;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	if (fread(rec, 8, 1, f) != 1 || memcmp(rec, EMU_TRACE_MAGIC, 8)) {
+		fprintf(stderr, "%s: not a trace\n", path);
+		fclose(f);
+		return -1;
+	}
+	while (fread(rec, EMU_TRACE_RECORD, 1, f) == 1) {
+		if (nr == size) {
+			size = size ? 2 * size : 1024;
+			more = realloc(s, size * sizeof(struct ts_sample));
+			if (!more) {
+				free(s);
+				fclose(f);
+				return -1;
+			}
+			s = more;
+		}
+		tv.tv_usec += emu_le32(rec + 12);
+		tv.tv_sec += tv.tv_usec / 1000000;
+		tv.tv_usec %= 1000000;
+		s[nr].x = (int)emu_le32(rec);
+		s[nr].y = (int)emu_le32(rec + 4);
+		s[nr].pressure = emu_le32(rec + 8);
+		s[nr].tv = tv;
+		nr++;
+	}
+	fclose(f);
+	*samp = s;
+	return nr;
+}
+
+int emu_trace_write(const char *path, const struct ts_sample *samp, int nr)
+{
+	unsigned char rec[EMU_TRACE_RECORD];
+	FILE *f;
+	int n;
+
+	f = fopen(path, "wb");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	fwrite(EMU_TRACE_MAGIC, 8, 1, f);
+	for (n = 0; n < nr; n++) {
+		long usec = 0;
+
+		if (n)
+			usec = (samp[n].tv.tv_sec - samp[n - 1].tv.tv_sec) * 1000000 +
+			       samp[n].tv.tv_usec - samp[n - 1].tv.tv_usec;
+		emu_put_le32(rec, samp[n].x);
+		emu_put_le32(rec + 4, samp[n].y);
+		emu_put_le32(rec + 8, samp[n].pressure);
+		emu_put_le32(rec + 12, usec < 0 ? 0 : usec);
+		fwrite(rec, EMU_TRACE_RECORD, 1, f);
+	}
+	if (fclose(f)) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+/* The raw module of emu_source() */
+struct emu_source {
+	struct tslib_module_info module;
+	const struct ts_sample *samp;
+	int		nr;
+	long		period;
+	long		count;
+	struct timeval	tv;
+	int		rate;		/* as last set, 0 if never */
+	int		idle;
+};
+
+static int emu_source_read(struct tslib_module_info *inf,
+			   struct ts_sample *samp, int nr)
+{
+	struct emu_source *s = (struct emu_source *)inf;
+	int k;
+
+	if (!s->period) {
+		if (nr > s->nr - s->count)
+			nr = s->nr - s->count;
+		memcpy(samp, s->samp + s->count, nr * sizeof(struct ts_sample));
+		s->count += nr;
+		return nr;
+	}
+
+	for (k = 0; k < nr; k++, samp++) {
+		*samp = s->samp[s->count++ % s->nr];
+		samp->tv = s->tv;
+		s->tv.tv_usec += s->period;
+		if (s->tv.tv_usec >= 1000000) {
+			s->tv.tv_usec -= 1000000;
+			s->tv.tv_sec++;
+		}
+	}
+	return nr;
+}
+
+static int emu_source_fini(struct tslib_module_info *inf)
+{
+	free(inf);
+	return 0;
+}
+
+static int emu_source_set_rate(struct tslib_module_info *inf, int hz)
+{
+	((struct emu_source *)inf)->rate = hz;
+	return 0;
+}
+
+static int emu_source_set_idle(struct tslib_module_info *inf, int idle)
+{
+	((struct emu_source *)inf)->idle = idle;
+	return 0;
+}
+
+static const struct tslib_ops emu_source_ops = {
+	.read		= emu_source_read,
+	.fini		= emu_source_fini,
+	.set_rate	= emu_source_set_rate,
+	.set_idle	= emu_source_set_idle,
+};
+
+struct tsdev *emu_source(const struct ts_sample *samp, int nr, long period)
+{
+	struct emu_source *s;
+	struct tsdev *ts;
+	int fd;
+
+	fd = open("/dev/null", O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	ts = ts_open_fd(fd);
+	if (!ts) {
+		close(fd);
+		return NULL;
+	}
+	s = calloc(1, sizeof(struct emu_source));
+	if (!s) {
+		ts_close(ts);
+		return NULL;
+	}
+	s->module.ops = &emu_source_ops;
+	s->samp = samp;
+	s->nr = nr;
+	s->period = period;
+
+	/* what loading it with module_raw does, with nothing loaded yet */
+	s->module.dev = ts;
+	ts->list = ts->list_raw = &s->module;
+	return ts;
+}
+
+long emu_source_count(struct tsdev *ts)
+{
+	return ((struct emu_source *)ts->list_raw)->count;
+}
+
+void emu_source_power(struct tsdev *ts, int *rate, int *idle)
+{
+	const struct emu_source *s = (struct emu_source *)ts->list_raw;
+
+	*rate = s->rate;
+	*idle = s->idle;
+}
+
+void emu_expect(const struct emu_proto *proto, const struct ts_sample *in,
+		struct ts_sample *out, int nr)
+{
+	struct ts_sample last;
+	int n;
+
+	memset(&last, 0, sizeof(last));
+	for (n = 0; n < nr; n++) {
+		memset(&out[n], 0, sizeof(struct ts_sample));
+		proto->expect(&in[n], &last, &out[n]);
+		last = out[n];
+	}
+}
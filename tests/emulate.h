@@ -0,0 +1,114 @@
+#ifndef _EMULATE_H
+#define _EMULATE_H
+/*
+ *  tslib/tests/emulate.h
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Touchscreens without the hardware, for tests and benchmarks.
+ */
+
+#include <pthread.h>
+#include "tslib.h"
+
+struct emu_dev;
+
+/* What a driver puts on the wire, and what its raw module makes of it */
+struct emu_proto {
+	const char	*name;		/* of the raw module */
+	int		serial;		/* a byte stream on a tty, not records */
+	unsigned int	caps;		/* for a pipe to pass as an event device */
+	const char	*answer;	/* to the setup the module sends, if any */
+	/* writes the bytes for one sample to buf, returns how many */
+	int		(*encode)(struct emu_dev *d, const struct ts_sample *s,
+				  unsigned char *buf);
+	/* the sample the module should read for in, after last */
+	void		(*expect)(const struct ts_sample *in,
+				  const struct ts_sample *last,
+				  struct ts_sample *out);
+};
+
+struct emu_dev {
+	const struct emu_proto *proto;
+	struct tsdev	*ts;		/* the device end, with the raw module */
+	int		feed;		/* the end the generator writes to */
+	int		pressed;	/* as far as the generator told */
+
+	/* what the generator sends, rate per second or 0 for no pause */
+	const struct ts_sample *samp;
+	int		nr;
+	int		rate;
+	int		sent;
+	struct timeval	now;		/* when the samples being sent went out */
+	pthread_t	thread;
+	int		running;
+};
+
+extern const struct emu_proto emu_protos[];
+extern const int emu_nr_protos;
+
+const struct emu_proto *emu_find(const char *name);
+
+/*
+ * A pipe, or a pty for the serial protocols, with the device end
+ * opened by tslib and the raw module loaded.  NULL if the module is
+ * not there or does not take the device.
+ */
+struct emu_dev *emu_open(const struct emu_proto *proto, const char *params);
+
+/* Starts sending samp in a thread of its own; the feed is closed at the end */
+int emu_start(struct emu_dev *d, const struct ts_sample *samp, int nr, int rate);
+
+/* Waits for the generator; returns the number of samples it sent */
+int emu_wait(struct emu_dev *d);
+
+/*
+ * Reads what the generator sends, batch samples at a time, until nr
+ * came or the device stayed quiet for a while.  Returns how many came.
+ */
+int emu_read(struct emu_dev *d, struct ts_sample *samp, int nr, int batch);
+
+void emu_close(struct emu_dev *d);
+
+/*
+ * Strokes of presses over a xmax by ymax screen, each ended by a
+ * release.  The same seed gives the same strokes.
+ */
+void emu_synth(struct ts_sample *samp, int nr, int xmax, int ymax,
+	       unsigned int seed);
+
+/*
+ * Reads "x y pressure" lines, as ts_print_raw prints them (the
+ * timestamp is skipped).  Returns the number of samples, or -1.
+ */
+int emu_script(const char *path, struct ts_sample **samp);
+
+/*
+ * Binary traces: "tslibtr1", then x, y, pressure and the usec since
+ * the sample before, each 32 bit little endian.  Returns the number of
+ * samples read, their timestamps counted from 0, or -1.
+ */
+int emu_trace(const char *path, struct ts_sample **samp);
+int emu_trace_write(const char *path, const struct ts_sample *samp, int nr);
+
+/*
+ * A device whose raw module hands out samp from memory, so that filters
+ * can be run on their own.  With period 0 it is read once as it is,
+ * then reads return 0; else it is read over and over, the timestamps
+ * moving on by period usec a sample.
+ */
+struct tsdev *emu_source(const struct ts_sample *samp, int nr, long period);
+
+/* How many samples the filters took from it */
+long emu_source_count(struct tsdev *ts);
+
+/* The scan rate and idling the filters last set it to, 0 if never */
+void emu_source_power(struct tsdev *ts, int *rate, int *idle);
+
+/* What the module of proto should read for in */
+void emu_expect(const struct emu_proto *proto, const struct ts_sample *in,
+		struct ts_sample *out, int nr);
+
+#endif /* _EMULATE_H */
@@ -0,0 +1,499 @@
+/*
+ *  tslib/tests/ts_bench.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Times the modules, each on its own: a filter reads from an in-memory
+ * source that costs next to nothing, a raw module from an emulated
+ * device.  The stages that find contacts in sensor frames are timed on
+ * the small grid of the Palm Pre and on a large one.  For every batch size it tells the ns per sample, samples
+ * per second and the mallocs done while reading, and can write it all
+ * as JSON to compare with an older release.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include "tslib.h"
+#include "tslib-frame.h"
+#include "emulate.h"
+
+#define BENCH_RING	4096		/* synthetic samples, read over and over */
+#define BENCH_PERIOD	5000		/* usec between them, 200 Hz */
+#define BENCH_BATCHES	8
+#define BENCH_FRAMES	64		/* synthetic frames, read over and over */
+
+/*
+ * Every malloc goes through here, the modules' included, so that the
+ * reads can be checked to allocate nothing.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long mallocs;
+
+void *malloc(size_t size)
+{
+	mallocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	mallocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	mallocs++;
+	return __libc_realloc(ptr, size);
+}
+#define MALLOCS()	((long)mallocs)
+#else
+#define MALLOCS()	(-1L)		/* not counted */
+#endif
+
+struct bench_case {
+	const char	*name;
+	const char	*chain;		/* modules and parameters, ';' between */
+};
+
+/* the filters one at a time, then as the sample ts.conf has them */
+static const struct bench_case bench_cases[] = {
+	{ "source",		"" },
+	{ "linear",		"linear" },
+	{ "linear_quad",	"linear_quad" },
+	{ "dejitter",		"dejitter delta=100" },
+	{ "variance",		"variance delta=30" },
+	{ "pthres",		"pthres pmin=1" },
+	{ "linear_h2200",	"linear_h2200" },
+	{ "ts.conf",		"pthres pmin=1;variance delta=30;dejitter delta=100;linear" },
+};
+
+#define NR_CASES (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+/* a calibration that is not the identity, so that linear works for it */
+static const char bench_calib[] = "70000 -300 -2000000 200 68000 -1500000 65536 800 480\n";
+
+struct bench_result {
+	const char	*name;
+	const char	*kind;
+	int		batch;
+	long		samples;	/* read by the module */
+	long		out;		/* handed out by it */
+	long long	ns;
+	long		init_mallocs;
+	long		mallocs;
+};
+
+static long long now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* Loads "module params;module params..." on top of the source */
+static int bench_chain(struct tsdev *ts, const char *chain)
+{
+	char *copy, *mod, *next, *params;
+	int ret = 0;
+
+	copy = strdup(chain);
+	if (!copy)
+		return -1;
+	for (mod = copy; mod && *mod && !ret; mod = next) {
+		next = strchr(mod, ';');
+		if (next)
+			*next++ = '\0';
+		params = strchr(mod, ' ');
+		if (params)
+			*params++ = '\0';
+		ret = ts_load_module(ts, mod, params);
+	}
+	free(copy);
+	return ret;
+}
+
+static int bench_filter(const struct bench_case *c, const struct ts_sample *ring,
+			long nr, int batch, struct bench_result *r)
+{
+	struct ts_sample *samp;
+	struct tsdev *ts;
+	long long start;
+	long before;
+	int ret;
+
+	samp = malloc(batch * sizeof(struct ts_sample));
+	if (!samp) {
+		perror("ts_bench");
+		exit(1);
+	}
+
+	before = MALLOCS();
+	ts = emu_source(ring, BENCH_RING, BENCH_PERIOD);
+	if (!ts) {
+		free(samp);
+		return -1;
+	}
+
+	if (bench_chain(ts, c->chain)) {
+		ts_close(ts);
+		free(samp);
+		return -1;
+	}
+
+	memset(r, 0, sizeof(*r));
+	r->name = c->name;
+	r->kind = "filter";
+	r->batch = batch;
+	r->init_mallocs = MALLOCS() - before;
+
+	before = MALLOCS();
+	start = now_ns();
+	while (emu_source_count(ts) < nr) {
+		ret = ts_read(ts, samp, batch);
+		if (ret < 0)
+			break;
+		r->out += ret;
+	}
+	r->ns = now_ns() - start;
+	r->mallocs = MALLOCS() - before;
+	r->samples = emu_source_count(ts);
+
+	ts_close(ts);
+	free(samp);
+	return 0;
+}
+
+static int bench_raw(const struct emu_proto *proto, const struct ts_sample *samp,
+		     long nr, int batch, struct bench_result *r)
+{
+	struct ts_sample *got;
+	struct emu_dev *d;
+	struct timespec t, cpu;
+	long before;
+
+	got = malloc(nr * sizeof(struct ts_sample));
+	if (!got) {
+		perror("ts_bench");
+		exit(1);
+	}
+
+	before = MALLOCS();
+	d = emu_open(proto, NULL);
+	if (!d) {
+		free(got);
+		return -1;
+	}
+
+	memset(r, 0, sizeof(*r));
+	r->name = proto->name;
+	r->kind = "raw";
+	r->batch = batch;
+	r->init_mallocs = MALLOCS() - before;
+
+	/* the generator is another thread, only this one's time counts */
+	if (emu_start(d, samp, nr, 0)) {
+		perror("pthread_create");
+		exit(1);
+	}
+	before = MALLOCS();
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+	r->out = r->samples = emu_read(d, got, nr, batch);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	r->ns = (t.tv_sec - cpu.tv_sec) * 1000000000LL + t.tv_nsec - cpu.tv_nsec;
+	r->mallocs = MALLOCS() - before;
+
+	emu_close(d);
+	free(got);
+	return 0;
+}
+
+/* the grids the frame stages are timed on */
+static const struct bench_grid {
+	int		w, h;
+	const char	*names[4];
+} bench_grids[] = {
+	{ 7, 11, { "baseline_7x11", "threshold_7x11", "blobs_7x11", "centroid_7x11" } },
+	{ 20, 30, { "baseline_20x30", "threshold_20x30", "blobs_20x30", "centroid_20x30" } },
+};
+
+#define NR_GRIDS (sizeof(bench_grids) / sizeof(bench_grids[0]))
+
+/* Two fingers moving apart over an untouched reading of 1200 */
+static void frame_synth(uint16_t *cells, int w, int h, int k)
+{
+	int x, y, f, dx, dy, bump;
+	int fx[2], fy[2];
+
+	fx[0] = (w * 256) / 3 - k * 2;
+	fx[1] = (w * 256 * 2) / 3 + k * 2;
+	fy[0] = fy[1] = h * 128 + k * 3;
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			bump = 0;
+			for (f = 0; f < 2; f++) {
+				dx = x * 256 + 128 - fx[f];
+				dy = y * 256 + 128 - fy[f];
+				/* 1.5 cells across */
+				if (dx * dx + dy * dy < 384 * 384)
+					bump += 300 - 300 * (dx * dx + dy * dy) / (384 * 384);
+			}
+			cells[y * w + x] = 1200 - bump + ((x * 7 + y * 13 + k) % 9);
+		}
+	}
+}
+
+/*
+ * The stages run in a row, 1 to 4 of them, for every frame.  What each
+ * one costs is the difference to running one stage less.
+ */
+static long long frame_run(struct ts_frame_proc *p, const uint16_t *cells,
+			   long nr, int stages)
+{
+	struct ts_frame_blob blob[TS_FRAME_MAX_CONTACTS];
+	struct ts_sample samp;
+	long long start;
+	long k;
+	int n, b, cells_nr = p->width * p->height;
+
+	ts_frame_reset(p, cells);
+	start = now_ns();
+	for (k = 0; k < nr; k++) {
+		if (ts_frame_baseline(p, cells + (k % BENCH_FRAMES) * cells_nr) < 0 ||
+		    stages < 2)
+			continue;
+		if (!ts_frame_threshold(p) || stages < 3)
+			continue;
+		n = ts_frame_blobs(p, blob, TS_FRAME_MAX_CONTACTS);
+		if (stages < 4)
+			continue;
+		for (b = 0; b < n; b++)
+			ts_frame_centroid(p, &blob[b], &samp);
+	}
+	return now_ns() - start;
+}
+
+static int bench_frame(const struct bench_grid *g, long nr, struct bench_result *r)
+{
+	struct ts_frame_proc *p;
+	uint16_t *cells;
+	long long ns[5] = { 0 };
+	long before;
+	int k;
+
+	p = calloc(1, sizeof(*p));
+	cells = malloc(BENCH_FRAMES * g->w * g->h * sizeof(uint16_t));
+	if (!p || !cells) {
+		perror("ts_bench");
+		exit(1);
+	}
+	p->width = g->w;
+	p->height = g->h;
+	p->min_value = 700;
+	p->max_value = 1500;
+	p->noise = 25;
+	p->decay = 10;
+	p->pitch_x = p->pitch_y = 256;
+	for (k = 0; k < BENCH_FRAMES; k++)
+		frame_synth(cells + k * g->w * g->h, g->w, g->h, k);
+
+	before = MALLOCS();
+	for (k = 1; k <= 4; k++)
+		ns[k] = frame_run(p, cells, nr, k);
+	for (k = 0; k < 4; k++) {
+		memset(&r[k], 0, sizeof(r[k]));
+		r[k].name = g->names[k];
+		r[k].kind = "frame";
+		r[k].batch = 1;
+		r[k].samples = r[k].out = nr;
+		r[k].ns = ns[k + 1] > ns[k] ? ns[k + 1] - ns[k] : 0;
+		r[k].mallocs = MALLOCS() - before;
+	}
+
+	free(cells);
+	free(p);
+	return 0;
+}
+
+static double per_sample(const struct bench_result *r)
+{
+	return r->samples ? (double)r->ns / r->samples : 0.0;
+}
+
+static double per_second(const struct bench_result *r)
+{
+	return r->ns ? r->samples * 1e9 / r->ns : 0.0;
+}
+
+static void print_text(const struct bench_result *r)
+{
+	const char *unit = strcmp(r->kind, "frame") ? "sample" : "frame";
+
+	printf("%-6s %-15s batch %3d %9.1f ns/%-6s %12.0f %6ss/s %6ld mallocs\n",
+	       r->kind, r->name, r->batch, per_sample(r), unit, per_second(r),
+	       unit, r->mallocs);
+}
+
+static void print_json(FILE *f, const struct bench_result *r, int nr, long samples)
+{
+	int k;
+
+	fprintf(f, "{\n\t\"tslib\": \"%s\",\n\t\"samples\": %ld,\n\t\"results\": [",
+		PACKAGE_VERSION, samples);
+	for (k = 0; k < nr; k++, r++)
+		fprintf(f, "%s\n\t\t{ \"name\": \"%s\", \"kind\": \"%s\", \"batch\": %d, "
+			"\"samples\": %ld, \"out\": %ld, \"ns_per_sample\": %.2f, "
+			"\"samples_per_sec\": %.0f, \"init_mallocs\": %ld, \"mallocs\": %ld }",
+			k ? "," : "", r->name, r->kind, r->batch, r->samples,
+			r->out, per_sample(r), per_second(r), r->init_mallocs,
+			r->mallocs);
+	fprintf(f, "\n\t]\n}\n");
+}
+
+static int selected(int argc, char **argv, const char *name)
+{
+	int k;
+
+	if (optind == argc)
+		return 1;
+	for (k = optind; k < argc; k++)
+		if (!strcmp(argv[k], name))
+			return 1;
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n samples] [-b batch[,batch...]] [-R] [-j file] [module...|frame]\n"
+		"\t-R\tleave the raw modules out\n"
+		"\t-j\twrite the results to file as JSON too\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	int batch[BENCH_BATCHES] = { 1, 16, 256 };
+	int nr_batch = 3, raw = 1;
+	long nr = 1000000;
+	const char *json = NULL;
+	char calib[] = "/tmp/ts_bench.XXXXXX";
+	struct ts_sample *samp;
+	struct bench_result *result, *r;
+	FILE *f;
+	char *p;
+	int c, k, b, fd;
+
+	while ((c = getopt(argc, argv, "n:b:Rj:")) != -1) {
+		switch (c) {
+		case 'n':
+			nr = atol(optarg);
+			break;
+		case 'b':
+			nr_batch = 0;
+			for (p = optarg; p && nr_batch < BENCH_BATCHES; p = strchr(p, ',')) {
+				if (*p == ',')
+					p++;
+				batch[nr_batch] = atoi(p);
+				if (batch[nr_batch++] < 1) {
+					usage(argv[0]);
+					return 2;
+				}
+			}
+			break;
+		case 'R':
+			raw = 0;
+			break;
+		case 'j':
+			json = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (nr < BENCH_RING) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	fd = mkstemp(calib);
+	if (fd < 0 || write(fd, bench_calib, strlen(bench_calib)) !=
+		      (ssize_t)strlen(bench_calib)) {
+		perror(calib);
+		return 1;
+	}
+	close(fd);
+	setenv("TSLIB_CALIBFILE", calib, 1);
+	signal(SIGPIPE, SIG_IGN);
+
+	samp = malloc(nr * sizeof(struct ts_sample));
+	result = calloc(nr_batch * (NR_CASES + emu_nr_protos) + 4 * NR_GRIDS,
+			sizeof(struct bench_result));
+	if (!samp || !result) {
+		perror("ts_bench");
+		return 1;
+	}
+	/* the raw modules get all of them, the filters the first BENCH_RING */
+	emu_synth(samp, nr, 2000, 2000, 1);
+
+	r = result;
+	for (k = 0; k < (int)NR_CASES; k++) {
+		if (!selected(argc, argv, bench_cases[k].name))
+			continue;
+		for (b = 0; b < nr_batch; b++) {
+			if (bench_filter(&bench_cases[k], samp, nr, batch[b], r)) {
+				fprintf(stderr, "%s: cannot load %s\n", argv[0],
+					bench_cases[k].chain);
+				break;
+			}
+			print_text(r);
+			r++;
+		}
+	}
+	for (k = 0; k < (int)NR_GRIDS; k++) {
+		if (!selected(argc, argv, "frame"))
+			break;
+		/* a frame is many samples' worth of work */
+		bench_frame(&bench_grids[k], nr / 16, r);
+		for (b = 0; b < 4; b++)
+			print_text(r++);
+	}
+	for (k = 0; raw && k < emu_nr_protos; k++) {
+		if (!selected(argc, argv, emu_protos[k].name))
+			continue;
+		for (b = 0; b < nr_batch; b++) {
+			if (bench_raw(&emu_protos[k], samp, nr, batch[b], r))
+				break;
+			print_text(r);
+			r++;
+		}
+	}
+	unlink(calib);
+
+	if (json) {
+		f = fopen(json, "w");
+		if (!f) {
+			perror(json);
+			return 1;
+		}
+		print_json(f, result, r - result, nr);
+		fclose(f);
+	}
+
+	free(samp);
+	free(result);
+	return 0;
+}
@@ -34,6 +34,7 @@
 #include "fbutils.h"
 #include "testutils.h"
 #include "tsquadrant_cal.h"
+#include "tsmodel_cal.h"
 
 static int palette [] =
 {
@@ -83,6 +84,9 @@ static void get_sample (struct tsdev *ts, struct cal_data *cal,
 
 struct opts {
 	int xinput_format;
+	int auto_model;
+	int folds;
+	const char *harvest;
 };
 
 void print_usage(void)
@@ -96,6 +100,11 @@ void print_usage(void)
 		"   -L --rotate_left	rotate 90 degrees left(ccw)\n"
 		"   -m --rotate_mode n	0 - normal, 1 - vflip, 2 - hflip, 3 - 180,\n"
 		"\t\t4 - swap x/y, 5 - right 90(cw), 6 - left 90(ccw), 7 - swap x/y 180\n"
+		"   -a --auto		fit affine, quadrant, quadratic and cubic models,\n"
+		"\t\tkeep the one with the lowest cross validated error\n"
+		"   -k --folds n	cross validation folds for --auto (default 5)\n"
+		"   -f --harvest file	fit the points of a ts_harvest output file\n"
+		"\t\tinstead of touching the screen, implies --auto\n"
 		"\n");
 }
 
@@ -110,10 +119,13 @@ int parse_opts(int argc, char * const *argv, struct opts *opts)
 		{"rotate_right", no_argument,		0, 'R' },
 		{"rotate_left", no_argument,		0, 'L' },
 		{"rotate_mode", required_argument,	0, 'm' },
+		{"auto",	no_argument,		0, 'a' },
+		{"folds",	required_argument,	0, 'k' },
+		{"harvest",	required_argument,	0, 'f' },
 		{0,		0,			0, 0 },
 	};
 
-	while ((c = getopt_long(argc, argv, "+hxrRLm:", long_options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "+hxrRLm:ak:f:", long_options, NULL)) != -1) {
 		switch (c)
 		{
 		case 'x':
@@ -133,6 +145,16 @@ int parse_opts(int argc, char * const *argv, struct opts *opts)
 			if (rotate_mode > 7)
 				rotate_mode = 0;
 			break;
+		case 'a':
+			opts->auto_model = 1;
+			break;
+		case 'k':
+			opts->folds = atoi(optarg);
+			break;
+		case 'f':
+			opts->harvest = optarg;
+			opts->auto_model = 1;
+			break;
 		case 'h':
 		case '?':
 		default:
@@ -143,6 +165,107 @@ int parse_opts(int argc, char * const *argv, struct opts *opts)
 	return 0;
 }
 
+/*
+ * ts_harvest.out is a header line followed by
+ * X_expected Y_expected X_measured Y_measured, tab separated.
+ * The touchscreen range is rounded up to a power of 2 of at least 2048,
+ * the screen size is taken from the outermost expected positions.
+ */
+static int read_harvest(const char *name, struct cal_data **pcal,
+		u32 *xmax, u32 *ymax, u32 *imax, u32 *jmax)
+{
+	struct cal_data *cal = NULL;
+	char line[128];
+	int n = 0, size = 0;
+	FILE *f;
+
+	f = fopen(name, "r");
+	if (!f) {
+		perror(name);
+		return -1;
+	}
+	*xmax = *ymax = 0;
+	*imax = *jmax = 2048;
+	while (fgets(line, sizeof(line), f)) {
+		struct cal_data d;
+
+		if (sscanf(line, "%u %u %u %u", &d.x, &d.y, &d.i, &d.j) != 4)
+			continue;
+		if (n == size) {
+			struct cal_data *c;
+
+			size = size ? size * 2 : 256;
+			c = realloc(cal, size * sizeof(*cal));
+			if (!c) {
+				n = -1;
+				break;
+			}
+			cal = c;
+		}
+		cal[n++] = d;
+		if (d.x >= *xmax)
+			*xmax = d.x + 1;
+		if (d.y >= *ymax)
+			*ymax = d.y + 1;
+		while (d.i >= *imax)
+			*imax <<= 1;
+		while (d.j >= *jmax)
+			*jmax <<= 1;
+	}
+	fclose(f);
+	if (n < 0)
+		free(cal);
+	else
+		*pcal = cal;
+	return n;
+}
+
+static int write_model(const struct cal_model_result *res)
+{
+	char *calfile;
+	FILE *f;
+	int ret;
+
+	printf("Selected %s model\n", model_calibration_name(res->model));
+	calfile = getenv("TSLIB_CALIBFILE");
+	if (!calfile)
+		calfile = TS_POINTERCAL;
+	f = fopen(calfile, "w");
+	if (!f) {
+		perror(calfile);
+		return -1;
+	}
+	printf("calibrate file: %s\n", calfile);
+	ret = write_model_calibration(f, res);
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+static int fit_harvest(struct opts *opts)
+{
+	struct cal_model_result model;
+	struct cal_data *cal;
+	u32 xmax, ymax, imax, jmax;
+	int n, r;
+
+	n = read_harvest(opts->harvest, &cal, &xmax, &ymax, &imax, &jmax);
+	if (n <= 0) {
+		printf("No points in %s\n", opts->harvest);
+		return -1;
+	}
+	printf("%d points, screen %ux%u, touchscreen %ux%u\n",
+	       n, xmax, ymax, imax, jmax);
+	r = select_model_calibration(cal, n, xmax, ymax, imax, jmax,
+				     opts->folds, &model);
+	free(cal);
+	if (r < 0) {
+		printf("Calibration failed.\n");
+		return -1;
+	}
+	return write_model(&model);
+}
+
 int main(int argc, char * const argv[])
 {
 	struct tsdev *ts;
@@ -165,10 +288,14 @@ int main(int argc, char * const argv[])
 	int err;
 
 	memset(&opts, 0, sizeof(struct opts));
+	opts.folds = 5;
 	err = parse_opts(argc, argv, &opts);
 	if (err)
 		exit(1);
 
+	if (opts.harvest)
+		return fit_harvest(&opts);
+
 	signal(SIGSEGV, sig);
 	signal(SIGINT, sig);
 	signal(SIGTERM, sig);
@@ -244,6 +371,19 @@ int main(int argc, char * const argv[])
 	if (PT_RB < npoints)
 		get_sample(ts, &cal[PT_RB], xres - 1 - dx, yres - 1 - dy, "right bottom");
 
+	if (opts.auto_model) {
+		struct cal_model_result model;
+
+		r = select_model_calibration(cal, npoints, xres, yres, iMax, jMax,
+					     opts.folds, &model);
+		if (r >= 0)
+			r = write_model(&model);
+		if (r < 0)
+			printf("Calibration failed.\n");
+		close_framebuffer();
+		return r;
+	}
+
 	r = perform_n_point_calibration(cal, npoints, xres, yres, iMax, jMax, res);
 	if (r >= 0) {
 		int ret;
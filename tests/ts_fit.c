@@ -0,0 +1,530 @@
+/*
+ *  tslib/tests/ts_fit.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Fit calibrations to ts_harvest output files, one panel per file or
+ * a whole lot of them together, and write a pointercal for linear_quad
+ * and a coefficient file for polycorrect.  Files are streamed: only the
+ * normal equations of each cross validation fold are kept in memory.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "tslib.h"
+#include "tsmodel_cal.h"
+
+#define MAX_FOLDS	16
+
+struct fit_range {
+	u32 xmax;
+	u32 ymax;
+	u32 imax;
+	u32 jmax;
+};
+
+struct panel {
+	const char *file;
+	struct fit_range range;
+	struct cal_sums fold[MAX_FOLDS];
+	int ret;
+};
+
+struct opts {
+	int model;		/* -1 to select one */
+	int folds;
+	int jobs;
+	int combine;
+	const char *prefix;
+	struct fit_range range;	/* zero fields are taken from the files */
+};
+
+static struct opts opts;
+
+/* the polynomial models polycorrect can evaluate, and their order */
+static const int fit_models[] = {
+	CAL_MODEL_AFFINE, CAL_MODEL_QUADRATIC, CAL_MODEL_CUBIC,
+};
+static const int fit_order[] = { 1, 2, 3 };
+
+/* powers of i and j of the tsmodel_cal terms 1 i j ij i2 j2 i3 i2j ij2 j3 */
+static const int term_pow[CAL_MAX_TERMS][2] = {
+	{ 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 }, { 2, 0 },
+	{ 0, 2 }, { 3, 0 }, { 2, 1 }, { 1, 2 }, { 0, 3 },
+};
+
+#define countof(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static void print_usage(void)
+{
+	printf("Usage: ts_fit [OPTIONS...] harvest-file...\n"
+		"Where OPTIONS are\n"
+		"   -h --help		Show this help\n"
+		"   -m --model name	fit affine, quadratic or cubic only\n"
+		"\t\t(default: the lowest cross validated error)\n"
+		"   -k --folds n	cross validation folds (default 5)\n"
+		"   -j --jobs n		worker threads (default: online cpus)\n"
+		"   -c --combine	fit all files together\n"
+		"   -o --output prefix	output prefix for --combine (default ts_fit)\n"
+		"   -s --screen WxH	screen size (default: from the points)\n"
+		"   -t --touch WxH	touchscreen range (default: from the points)\n"
+		"\n"
+		"Writes <prefix>.pointercal and <prefix>.polycorrect, where prefix\n"
+		"is the harvest file name unless --combine is given.\n"
+		"\n");
+}
+
+static int parse_size(const char *arg, u32 *w, u32 *h)
+{
+	return sscanf(arg, "%ux%u", w, h) == 2 && *w && *h ? 0 : -1;
+}
+
+static int parse_opts(int argc, char * const *argv)
+{
+	int c;
+
+	static struct option long_options[] = {
+		{"help",	no_argument,		0, 'h' },
+		{"model",	required_argument,	0, 'm' },
+		{"folds",	required_argument,	0, 'k' },
+		{"jobs",	required_argument,	0, 'j' },
+		{"combine",	no_argument,		0, 'c' },
+		{"output",	required_argument,	0, 'o' },
+		{"screen",	required_argument,	0, 's' },
+		{"touch",	required_argument,	0, 't' },
+		{0,		0,			0, 0 },
+	};
+
+	opts.model = -1;
+	opts.folds = 5;
+	opts.jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	opts.prefix = "ts_fit";
+
+	while ((c = getopt_long(argc, argv, "hm:k:j:co:s:t:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'm':
+			opts.model = model_calibration_lookup(optarg);
+			if (opts.model < 0 || opts.model == CAL_MODEL_QUADRANT) {
+				fprintf(stderr, "ts_fit: unknown model %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 'k':
+			opts.folds = atoi(optarg);
+			if (opts.folds < 2 || opts.folds > MAX_FOLDS) {
+				fprintf(stderr, "ts_fit: folds must be 2..%d\n", MAX_FOLDS);
+				return -1;
+			}
+			break;
+		case 'j':
+			opts.jobs = atoi(optarg);
+			break;
+		case 'c':
+			opts.combine = 1;
+			break;
+		case 'o':
+			opts.prefix = optarg;
+			break;
+		case 's':
+			if (parse_size(optarg, &opts.range.xmax, &opts.range.ymax)) {
+				print_usage();
+				return -1;
+			}
+			break;
+		case 't':
+			if (parse_size(optarg, &opts.range.imax, &opts.range.jmax)) {
+				print_usage();
+				return -1;
+			}
+			break;
+		case 'h':
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+	if (optind >= argc) {
+		print_usage();
+		return -1;
+	}
+	if (opts.jobs < 1)
+		opts.jobs = 1;
+	return 0;
+}
+
+/* "X_expected Y_expected X_measured Y_measured", anything else is skipped */
+static int parse_point(const char *line, long *v)
+{
+	char *end;
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		v[k] = strtol(line, &end, 10);
+		if (end == line || v[k] < 0)
+			return -1;
+		line = end;
+	}
+	return 0;
+}
+
+static FILE *open_harvest(const char *file)
+{
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return NULL;
+	}
+	setvbuf(f, NULL, _IOFBF, 1 << 16);
+	return f;
+}
+
+/* Same rules as ts_calibrate_quadrant -f */
+static int scan_range(struct panel *p)
+{
+	struct fit_range *r = &p->range;
+	char line[128];
+	long v[4];
+	FILE *f;
+
+	f = open_harvest(p->file);
+	if (!f)
+		return -1;
+	r->xmax = r->ymax = 0;
+	r->imax = r->jmax = 2048;
+	while (fgets(line, sizeof(line), f)) {
+		if (parse_point(line, v))
+			continue;
+		if (v[0] >= r->xmax)
+			r->xmax = v[0] + 1;
+		if (v[1] >= r->ymax)
+			r->ymax = v[1] + 1;
+		while (v[2] >= r->imax)
+			r->imax <<= 1;
+		while (v[3] >= r->jmax)
+			r->jmax <<= 1;
+	}
+	fclose(f);
+	return 0;
+}
+
+static int accumulate(struct panel *p)
+{
+	const struct fit_range *r = &p->range;
+	unsigned long n = 0;
+	char line[128];
+	long v[4];
+	FILE *f;
+	int k;
+
+	for (k = 0; k < opts.folds; k++)
+		cal_sums_init(&p->fold[k], CAL_MAX_TERMS);
+
+	f = open_harvest(p->file);
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (parse_point(line, v))
+			continue;
+		cal_sums_add(&p->fold[n++ % opts.folds],
+			     (double)v[2] / r->imax, (double)v[3] / r->jmax,
+			     (double)v[0] / r->xmax, (double)v[1] / r->ymax);
+	}
+	fclose(f);
+	return 0;
+}
+
+static void set_range(struct panel *p, const struct fit_range *r)
+{
+	if (opts.range.xmax) {
+		p->range.xmax = opts.range.xmax;
+		p->range.ymax = opts.range.ymax;
+	} else {
+		p->range.xmax = r->xmax;
+		p->range.ymax = r->ymax;
+	}
+	if (opts.range.imax) {
+		p->range.imax = opts.range.imax;
+		p->range.jmax = opts.range.jmax;
+	} else {
+		p->range.imax = r->imax;
+		p->range.jmax = r->jmax;
+	}
+}
+
+/*
+ * Every model is solved from the same cubic sums.  Cross validation
+ * trains on the total less one fold and scores on that fold's sums.
+ */
+static int fit_panel(const char *name, const struct cal_sums *fold,
+		const struct fit_range *r, struct cal_model_result *res,
+		double *cx, double *cy)
+{
+	struct cal_sums total, sums;
+	double err[countof(fit_models)];
+	double fx[CAL_MAX_TERMS], fy[CAL_MAX_TERMS];
+	int best = -1;
+	int m, k;
+
+	total = fold[0];
+	for (k = 1; k < opts.folds; k++)
+		cal_sums_merge(&total, &fold[k]);
+
+	for (m = 0; m < (int)countof(fit_models); m++) {
+		int nterms = model_calibration_terms(fit_models[m]);
+
+		if (opts.model >= 0 && fit_models[m] != opts.model)
+			continue;
+
+		err[m] = 0;
+		for (k = 0; k < opts.folds; k++) {
+			sums = total;
+			cal_sums_subtract(&sums, &fold[k]);
+			sums.nterms = nterms;
+			if (cal_sums_solve(&sums, fx, fy)) {
+				err[m] = HUGE_VAL;
+				break;
+			}
+			sums = fold[k];
+			sums.nterms = nterms;
+			err[m] += cal_sums_residual(&sums, fx, fy,
+						    r->xmax, r->ymax);
+		}
+		if (err[m] == HUGE_VAL) {
+			printf("%s: %s: not enough points\n", name,
+			       model_calibration_name(fit_models[m]));
+			continue;
+		}
+		err[m] = sqrt(err[m] / total.n);
+		printf("%s: %s: cross validated error %.3f pixels\n", name,
+		       model_calibration_name(fit_models[m]), err[m]);
+		/* ties go to the simpler model */
+		if (best < 0 || err[m] < err[best])
+			best = m;
+	}
+	if (best < 0)
+		return -1;
+
+	total.nterms = model_calibration_terms(fit_models[best]);
+	if (cal_sums_solve(&total, cx, cy) ||
+	    store_model_calibration(fit_models[best], cx, cy, r->xmax,
+				    r->ymax, r->imax, r->jmax, res))
+		return -1;
+	res->rms_error = err[best];
+	return fit_order[best];
+}
+
+/* The fit in raw touchscreen units and screen pixels, for polycorrect */
+static int write_polycorrect(FILE *f, const struct cal_model_result *res,
+		int order, const double *cx, const double *cy)
+{
+	double px[CAL_MAX_TERMS], py[CAL_MAX_TERMS];
+	int k;
+
+	for (k = 0; k < res->nterms; k++) {
+		int a = term_pow[k][0], b = term_pow[k][1];
+		int deg = a + b;
+		double scale = pow(res->imax, a) * pow(res->jmax, b);
+
+		px[deg * (deg + 1) / 2 + b] = cx[k] * res->xmax / scale;
+		py[deg * (deg + 1) / 2 + b] = cy[k] * res->ymax / scale;
+	}
+
+	fprintf(f, "# rms error %.3f pixels\n", res->rms_error);
+	fprintf(f, "order %d\n", order);
+	fprintf(f, "range %u %u\n", res->imax, res->jmax);
+	fprintf(f, "x");
+	for (k = 0; k < res->nterms; k++)
+		fprintf(f, " %.17g", px[k]);
+	fprintf(f, "\ny");
+	for (k = 0; k < res->nterms; k++)
+		fprintf(f, " %.17g", py[k]);
+	fprintf(f, "\n");
+	return ferror(f) ? -1 : 0;
+}
+
+static int write_file(const char *prefix, const char *suffix,
+		const struct cal_model_result *res, int order,
+		const double *cx, const double *cy)
+{
+	char *name;
+	FILE *f;
+	int ret;
+
+	name = malloc(strlen(prefix) + strlen(suffix) + 1);
+	if (!name)
+		return -1;
+	strcpy(name, prefix);
+	strcat(name, suffix);
+
+	f = fopen(name, "w");
+	if (!f) {
+		perror(name);
+		free(name);
+		return -1;
+	}
+	if (order)
+		ret = write_polycorrect(f, res, order, cx, cy);
+	else
+		ret = write_model_calibration(f, res);
+	if (fclose(f))
+		ret = -1;
+	free(name);
+	return ret;
+}
+
+static int write_fit(const char *prefix, const struct fit_range *r,
+		const struct cal_sums *fold)
+{
+	struct cal_model_result res;
+	double cx[CAL_MAX_TERMS], cy[CAL_MAX_TERMS];
+	int order;
+
+	order = fit_panel(prefix, fold, r, &res, cx, cy);
+	if (order < 0) {
+		printf("%s: calibration failed\n", prefix);
+		return -1;
+	}
+	printf("%s: selected %s model\n", prefix,
+	       model_calibration_name(res.model));
+	if (write_file(prefix, ".pointercal", &res, 0, NULL, NULL) ||
+	    write_file(prefix, ".polycorrect", &res, order, cx, cy))
+		return -1;
+	return 0;
+}
+
+/*
+ * A fixed pool of workers takes the panels in turn.  Output is
+ * written by the main thread afterwards, in command line order.
+ */
+struct pool {
+	pthread_mutex_t lock;
+	struct panel *panel;
+	int npanels;
+	int next;
+	int (*work)(struct panel *p);
+};
+
+static void *pool_run(void *arg)
+{
+	struct pool *pool = arg;
+
+	for (;;) {
+		struct panel *p;
+
+		pthread_mutex_lock(&pool->lock);
+		p = pool->next < pool->npanels ? &pool->panel[pool->next++] : NULL;
+		pthread_mutex_unlock(&pool->lock);
+		if (!p)
+			break;
+		if (!p->ret)
+			p->ret = pool->work(p);
+	}
+	return NULL;
+}
+
+static void run_pool(struct panel *panel, int npanels,
+		int (*work)(struct panel *p))
+{
+	struct pool pool;
+	pthread_t *thread;
+	int nthreads = opts.jobs < npanels ? opts.jobs : npanels;
+	int started = 0;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pool.panel = panel;
+	pool.npanels = npanels;
+	pool.next = 0;
+	pool.work = work;
+
+	thread = malloc(nthreads * sizeof(*thread));
+	if (thread)
+		while (started < nthreads &&
+		       !pthread_create(&thread[started], NULL, pool_run, &pool))
+			started++;
+	if (!started)
+		pool_run(&pool);
+	while (started--)
+		pthread_join(thread[started], NULL);
+	free(thread);
+	pthread_mutex_destroy(&pool.lock);
+}
+
+int main(int argc, char **argv)
+{
+	struct panel *panel;
+	struct fit_range all = { 0, 0, 2048, 2048 };
+	int npanels, k, ret = 0;
+
+	if (parse_opts(argc, argv))
+		return 1;
+
+	npanels = argc - optind;
+	panel = calloc(npanels, sizeof(*panel));
+	if (!panel) {
+		perror("ts_fit");
+		return 1;
+	}
+	for (k = 0; k < npanels; k++)
+		panel[k].file = argv[optind + k];
+
+	if (!opts.range.xmax || !opts.range.imax) {
+		run_pool(panel, npanels, scan_range);
+		for (k = 0; k < npanels; k++) {
+			const struct fit_range *r = &panel[k].range;
+
+			if (panel[k].ret)
+				continue;
+			if (r->xmax > all.xmax)
+				all.xmax = r->xmax;
+			if (r->ymax > all.ymax)
+				all.ymax = r->ymax;
+			if (r->imax > all.imax)
+				all.imax = r->imax;
+			if (r->jmax > all.jmax)
+				all.jmax = r->jmax;
+		}
+	}
+	for (k = 0; k < npanels; k++)
+		set_range(&panel[k], opts.combine ? &all : &panel[k].range);
+
+	run_pool(panel, npanels, accumulate);
+
+	if (opts.combine) {
+		struct cal_sums fold[MAX_FOLDS];
+		int f;
+
+		for (f = 0; f < opts.folds; f++)
+			cal_sums_init(&fold[f], CAL_MAX_TERMS);
+		for (k = 0; k < npanels; k++) {
+			if (panel[k].ret) {
+				ret = 1;
+				continue;
+			}
+			for (f = 0; f < opts.folds; f++)
+				cal_sums_merge(&fold[f], &panel[k].fold[f]);
+		}
+		if (write_fit(opts.prefix, &panel[0].range, fold))
+			ret = 1;
+	} else {
+		for (k = 0; k < npanels; k++)
+			if (panel[k].ret ||
+			    write_fit(panel[k].file, &panel[k].range,
+				      panel[k].fold))
+				ret = 1;
+	}
+
+	free(panel);
+	return ret;
+}
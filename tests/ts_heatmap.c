@@ -0,0 +1,228 @@
+/*
+ *  tslib/tests/ts_heatmap.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Checks the stages that turn a heatmap into contacts: a frame with two
+ * peaks and a plateau gives three contacts at known centroids, and the
+ * baseline of the library, SIMD where it is built with it, is the same
+ * as that of the plain loop below over random frames in the whole
+ * 16 bit range.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tslib-frame.h"
+
+#define HM_W		10
+#define HM_H		8
+#define HM_BASE		40000		/* above 32767 on purpose */
+#define HM_ROUNDS	2000
+
+/* The baseline stage as a plain loop, cell by cell */
+static int ref_baseline(const struct ts_frame_proc *p, const uint16_t *cells,
+			uint32_t *next, uint16_t *delta)
+{
+	const uint32_t *base = p->baseline[p->cur];
+	uint32_t quiet = p->decay ? p->noise + 1 : 0;
+	uint32_t raw, r, b, d, max = 0;
+	int i, bad = 0;
+
+	for (i = 0; i < p->width * p->height; i++) {
+		raw = cells[i];
+		bad |= raw < (uint32_t)p->min_value || raw > (uint32_t)p->max_value;
+		r = raw << TS_FRAME_SHIFT;
+		b = base[i];
+		if (r > b) {
+			d = 0;
+			next[i] = r;
+		} else {
+			d = (b - r) >> TS_FRAME_SHIFT;
+			next[i] = d < quiet ? b - ((b - r) >> p->decay) : b;
+		}
+		delta[i] = d;
+		if (d > max)
+			max = d;
+	}
+	return bad ? -1 : (int)max;
+}
+
+static void hm_touch(uint16_t *cells, int cx, int cy, int peak, int side)
+{
+	int dx, dy;
+
+	for (dy = -1; dy <= 1; dy++)
+		for (dx = -1; dx <= 1; dx++)
+			cells[(cy + dy) * HM_W + cx + dx] = HM_BASE -
+				(dx || dy ? side : peak);
+}
+
+/*
+ * Two fingers, each a peak with lower cells around it, and a plateau of
+ * three equal cells along the bottom edge, as a palm there gives.
+ */
+static int hm_contacts(void)
+{
+	static struct ts_frame_proc p;
+	static const struct ts_sample want[] = {
+		{ 250, 250, 1500 },
+		{ 750, 550, 1000 },
+		{ 250, 750, 240 },
+	};
+	uint16_t cells[HM_W * HM_H];
+	struct ts_frame_blob blob[TS_FRAME_MAX_CONTACTS];
+	struct ts_sample got;
+	int k, n, max, left, wrong = 0;
+
+	memset(&p, 0, sizeof(p));
+	p.width = HM_W;
+	p.height = HM_H;
+	p.min_value = 0;
+	p.max_value = 65535;
+	p.noise = 20;
+	p.decay = 4;
+	p.pitch_x = p.pitch_y = 100;
+	p.offset_x = p.offset_y = 50;
+
+	for (k = 0; k < HM_W * HM_H; k++)
+		cells[k] = HM_BASE;
+	ts_frame_reset(&p, cells);
+
+	hm_touch(cells, 2, 2, 300, 150);
+	hm_touch(cells, 7, 5, 200, 100);
+	for (k = 1; k <= 3; k++)
+		cells[7 * HM_W + k] = HM_BASE - 80;
+	/* within the noise, no contact */
+	cells[5 * HM_W + 2] = HM_BASE - 20;
+
+	max = ts_frame_baseline(&p, cells);
+	left = ts_frame_threshold(&p);
+	n = ts_frame_blobs(&p, blob, TS_FRAME_MAX_CONTACTS);
+	if (max != 300 || left != 21 || n != 3) {
+		printf("heatmap   max %d, %d cells, %d contacts, want 300, 21, 3\n",
+		       max, left, n);
+		return 1;
+	}
+	for (k = 0; k < n; k++) {
+		ts_frame_centroid(&p, &blob[k], &got);
+		if (got.x == want[k].x && got.y == want[k].y &&
+		    got.pressure == want[k].pressure)
+			continue;
+		printf("heatmap   contact %d at %d,%d %d, want %d,%d %d\n", k,
+		       got.x, got.y, got.pressure, want[k].x, want[k].y,
+		       want[k].pressure);
+		wrong = 1;
+	}
+	if (!wrong)
+		printf("heatmap   3 contacts where they should be\n");
+	return wrong;
+}
+
+/*
+ * A palm over the whole frame with a coarse pitch, whose moments times
+ * the pitch are past what an int holds.
+ */
+static int hm_large(void)
+{
+	static struct ts_frame_proc p;
+	uint16_t cells[HM_W * HM_H];
+	struct ts_frame_blob blob[TS_FRAME_MAX_CONTACTS];
+	struct ts_sample got;
+	int k, n;
+
+	memset(&p, 0, sizeof(p));
+	p.width = HM_W;
+	p.height = HM_H;
+	p.min_value = 0;
+	p.max_value = 65535;
+	p.noise = 20;
+	p.pitch_x = p.pitch_y = 1000;
+	p.offset_x = p.offset_y = 500;
+
+	for (k = 0; k < HM_W * HM_H; k++)
+		cells[k] = HM_BASE;
+	ts_frame_reset(&p, cells);
+	for (k = 0; k < HM_W * HM_H; k++)
+		cells[k] = HM_BASE - 30000;
+
+	ts_frame_baseline(&p, cells);
+	ts_frame_threshold(&p);
+	n = ts_frame_blobs(&p, blob, TS_FRAME_MAX_CONTACTS);
+	if (n == 1)
+		ts_frame_centroid(&p, &blob[0], &got);
+	if (n != 1 || got.x != 5000 || got.y != 4000) {
+		printf("heatmap   palm gives %d contacts, at %d,%d, want 1 at 5000,4000\n",
+		       n, n == 1 ? got.x : 0, n == 1 ? got.y : 0);
+		return 1;
+	}
+	printf("heatmap   palm over the whole frame in the middle of it\n");
+	return 0;
+}
+
+/*
+ * Random grids, baselines and frames, with readings anywhere in 16 bits
+ * and now and then out of range.
+ */
+static int hm_baseline(void)
+{
+	static struct ts_frame_proc p;
+	static uint32_t next[TS_FRAME_MAX_CELLS];
+	static uint16_t delta[TS_FRAME_MAX_CELLS];
+	uint16_t cells[TS_FRAME_MAX_CELLS];
+	unsigned int seed = 1;
+	int round, i, n, want, got;
+
+	for (round = 0; round < HM_ROUNDS; round++) {
+		memset(&p, 0, sizeof(p));
+		p.width = 1 + rand_r(&seed) % TS_FRAME_MAX_W;
+		p.height = 1 + rand_r(&seed) % TS_FRAME_MAX_H;
+		p.noise = rand_r(&seed) % 64;
+		p.decay = rand_r(&seed) % 9;
+		if (rand_r(&seed) % 8) {
+			p.min_value = 0;
+			p.max_value = 65535;
+		} else {
+			p.min_value = rand_r(&seed) % 1000;
+			p.max_value = 64535 + rand_r(&seed) % 1001;
+		}
+		p.cur = rand_r(&seed) % 2;
+		n = p.width * p.height;
+		for (i = 0; i < n; i++) {
+			cells[i] = rand_r(&seed);
+			p.baseline[p.cur][i] = (uint32_t)rand_r(&seed) << 1 ^ rand_r(&seed);
+			/* mostly near the baseline, as real frames are */
+			if (rand_r(&seed) % 4)
+				cells[i] = (p.baseline[p.cur][i] >> TS_FRAME_SHIFT) -
+					   rand_r(&seed) % 128;
+		}
+
+		want = ref_baseline(&p, cells, next, delta);
+		got = ts_frame_baseline(&p, cells);
+		if (got != want ||
+		    (want >= 0 && (memcmp(p.baseline[p.cur], next, n * sizeof(next[0])) ||
+				   memcmp(p.delta, delta, n * sizeof(delta[0]))))) {
+			printf("heatmap   baseline of round %d (%dx%d) differs, "
+			       "max %d, want %d\n", round, p.width, p.height,
+			       got, want);
+			return 1;
+		}
+	}
+	printf("heatmap   baseline the same as the plain loop in %d rounds\n",
+	       HM_ROUNDS);
+	return 0;
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed += hm_contacts();
+	failed += hm_large();
+	failed += hm_baseline();
+	return failed ? 1 : 0;
+}
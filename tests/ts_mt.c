@@ -0,0 +1,360 @@
+/*
+ *  tslib/tests/ts_mt.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Runs scripted frames of several contacts through the filters that
+ * keep contacts apart, and checks the ids and states that come out:
+ * fingers crossing, coming and going, and jumping out of the gate, and
+ * that filters holding samples back keep them in order.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tslib-private.h"
+#include "emulate.h"
+
+#define MT_MAX		64
+
+/* A contact as fed in, all those of a frame with the same t */
+struct mt_in {
+	int	t;
+	int	x;
+	int	y;
+	int	pressure;
+};
+
+/* A contact as it should come out */
+struct mt_out {
+	int	t;
+	int	id;
+	int	state;
+	int	x;
+};
+
+static const char *mt_state[] = { "none", "down", "move", "up" };
+
+static struct tsdev *mt_open(const struct mt_in *in, int nr,
+			     struct ts_sample *samp, const char *const *chain)
+{
+	struct tsdev *ts;
+	int k;
+
+	memset(samp, 0, nr * sizeof(struct ts_sample));
+	for (k = 0; k < nr; k++) {
+		samp[k].x = in[k].x;
+		samp[k].y = in[k].y;
+		samp[k].pressure = in[k].pressure;
+		samp[k].tv.tv_sec = in[k].t;
+	}
+	ts = emu_source(samp, nr, 0);
+	if (!ts)
+		return NULL;
+	/* each module goes on top of the ones before */
+	for (k = 0; chain[k]; k += 2) {
+		if (ts_load_module(ts, chain[k], chain[k + 1])) {
+			fprintf(stderr, "module %s %s not loaded\n", chain[k],
+				chain[k + 1]);
+			ts_close(ts);
+			return NULL;
+		}
+	}
+	return ts;
+}
+
+/*
+ * Feeds in through chain, a module name and its parameters after
+ * another, and compares what ts_read_mt() hands out, batch contacts a
+ * read, with want.  Returns 0 if they are the same, 1 if not.
+ */
+static int mt_check(const char *name, const struct mt_in *in, int nr,
+		    const char *const *chain, int batch,
+		    const struct mt_out *want, int nr_want)
+{
+	struct ts_sample samp[MT_MAX];
+	struct ts_contact got[MT_MAX];
+	struct tsdev *ts;
+	int n = 0, k, ret, wrong = 0;
+
+	ts = mt_open(in, nr, samp, chain);
+	if (!ts)
+		return 1;
+	while (n < MT_MAX) {
+		ret = ts_read_mt(ts, got + n,
+				 MT_MAX - n < batch ? MT_MAX - n : batch);
+		if (ret <= 0)
+			break;
+		n += ret;
+	}
+	ts_close(ts);
+
+	for (k = 0; k < n || k < nr_want; k++) {
+		if (k < n && k < nr_want &&
+		    got[k].samp.tv.tv_sec == want[k].t && got[k].id == want[k].id &&
+		    got[k].state == want[k].state &&
+		    (want[k].state == TS_CONTACT_UP || got[k].samp.x == want[k].x))
+			continue;
+		if (!wrong++)
+			printf("%-24s wrong from contact %d:\n", name, k);
+		if (k < n)
+			printf("\tgot  t=%ld id %d %-4s x=%d\n",
+			       (long)got[k].samp.tv.tv_sec, got[k].id,
+			       mt_state[got[k].state], got[k].samp.x);
+		if (k < nr_want)
+			printf("\twant t=%d id %d %-4s x=%d\n", want[k].t,
+			       want[k].id, mt_state[want[k].state], want[k].x);
+	}
+	if (!wrong)
+		printf("%-24s %d contacts as they should be\n", name, n);
+	return wrong != 0;
+}
+
+#define NR(a)	(int)(sizeof(a) / sizeof(a[0]))
+#define D	TS_CONTACT_DOWN
+#define M	TS_CONTACT_MOVE
+#define U	TS_CONTACT_UP
+
+/*
+ * Two fingers crossing, handed in the other order once they have: each
+ * keeps its id, matched greedily or not.
+ */
+static const struct mt_in cross_in[] = {
+	{ 1, 100, 100, 50 }, { 1, 400, 130, 50 },
+	{ 2, 150, 100, 50 }, { 2, 350, 130, 50 },
+	{ 3, 200, 100, 50 }, { 3, 300, 130, 50 },
+	{ 4, 250, 130, 50 }, { 4, 250, 100, 50 },
+	{ 5, 200, 130, 50 }, { 5, 300, 100, 50 },
+	{ 6, 150, 130, 50 }, { 6, 350, 100, 50 },
+	{ 7, 0, 0, 0 },
+};
+
+static const struct mt_out cross_out[] = {
+	{ 1, 0, D, 100 }, { 1, 1, D, 400 },
+	{ 2, 0, M, 150 }, { 2, 1, M, 350 },
+	{ 3, 0, M, 200 }, { 3, 1, M, 300 },
+	{ 4, 0, M, 250 }, { 4, 1, M, 250 },
+	{ 5, 0, M, 300 }, { 5, 1, M, 200 },
+	{ 6, 0, M, 350 }, { 6, 1, M, 150 },
+	{ 7, 0, U, 0 }, { 7, 1, U, 0 },
+};
+
+/*
+ * Both move right: greedily, the nearest pair is taken first and the
+ * other finger is left outside the gate; the Hungarian method moves
+ * them both.
+ */
+static const struct mt_in shift_in[] = {
+	{ 1, 0, 0, 50 }, { 1, 100, 0, 50 },
+	{ 2, 60, 0, 50 }, { 2, 160, 0, 50 },
+	{ 3, 0, 0, 0 },
+};
+
+static const struct mt_out shift_greedy_out[] = {
+	{ 1, 0, D, 0 }, { 1, 1, D, 100 },
+	{ 2, 0, U, 0 }, { 2, 1, M, 60 }, { 2, 0, D, 160 },
+	{ 3, 0, U, 0 }, { 3, 1, U, 0 },
+};
+
+static const struct mt_out shift_hungarian_out[] = {
+	{ 1, 0, D, 0 }, { 1, 1, D, 100 },
+	{ 2, 0, M, 60 }, { 2, 1, M, 160 },
+	{ 3, 0, U, 0 }, { 3, 1, U, 0 },
+};
+
+/* A jump out of the gate is a new contact, within it a move */
+static const struct mt_in jump_in[] = {
+	{ 1, 100, 100, 50 },
+	{ 2, 400, 100, 50 },
+	{ 3, 0, 0, 0 },
+};
+
+static const struct mt_out jump_gate_out[] = {
+	{ 1, 0, D, 100 },
+	{ 2, 0, U, 0 }, { 2, 0, D, 400 },
+	{ 3, 0, U, 0 },
+};
+
+static const struct mt_out jump_wide_out[] = {
+	{ 1, 0, D, 100 },
+	{ 2, 0, M, 400 },
+	{ 3, 0, U, 0 },
+};
+
+/*
+ * Three fingers, the middle one lifts and another comes down far away:
+ * it takes the free id.
+ */
+static const struct mt_in come_go_in[] = {
+	{ 1, 100, 100, 50 }, { 1, 500, 100, 50 }, { 1, 900, 100, 50 },
+	{ 2, 100, 100, 50 }, { 2, 900, 100, 50 },
+	{ 3, 100, 100, 50 }, { 3, 900, 100, 50 }, { 3, 500, 800, 50 },
+	{ 4, 0, 0, 0 },
+};
+
+static const struct mt_out come_go_out[] = {
+	{ 1, 0, D, 100 }, { 1, 1, D, 500 }, { 1, 2, D, 900 },
+	{ 2, 1, U, 0 }, { 2, 0, M, 100 }, { 2, 2, M, 900 },
+	{ 3, 0, M, 100 }, { 3, 2, M, 900 }, { 3, 1, D, 500 },
+	{ 4, 0, U, 0 }, { 4, 1, U, 0 }, { 4, 2, U, 0 },
+};
+
+/*
+ * Through variance, which holds a sample of each contact back: a jump
+ * out of the gate lifts id 0 and puts it down again in one frame, and
+ * the up still comes before the down.
+ */
+static const struct mt_in reuse_in[] = {
+	{ 1, 100, 100, 50 },
+	{ 2, 105, 100, 50 },
+	{ 3, 400, 100, 50 },
+	{ 4, 405, 100, 50 },
+	{ 5, 0, 0, 0 },
+};
+
+static const struct mt_out reuse_out[] = {
+	{ 1, 0, D, 100 },
+	{ 2, 0, M, 105 },
+	{ 3, 0, U, 0 },
+	{ 3, 0, D, 400 },
+	{ 4, 0, M, 405 },
+	{ 5, 0, U, 0 },
+};
+
+/*
+ * The release of id 1 comes out before the later frames of id 0, as
+ * long as the frames are read whole.
+ */
+static const struct mt_in lift_in[] = {
+	{ 1, 110, 100, 50 }, { 1, 900, 100, 50 },
+	{ 2, 120, 100, 50 }, { 2, 900, 100, 50 },
+	{ 3, 130, 100, 50 }, { 3, 900, 100, 50 },
+	{ 4, 140, 100, 50 }, { 4, 900, 100, 50 },
+	{ 5, 150, 100, 50 },
+	{ 6, 160, 100, 50 },
+	{ 7, 170, 100, 50 },
+	{ 8, 180, 100, 50 },
+	{ 9, 0, 0, 0 },
+};
+
+static const struct mt_out lift_out[] = {
+	{ 1, 0, D, 110 }, { 1, 1, D, 900 },
+	{ 2, 0, M, 120 }, { 2, 1, M, 900 },
+	{ 3, 0, M, 130 }, { 3, 1, M, 900 },
+	{ 4, 1, M, 900 }, { 4, 0, M, 140 },
+	{ 5, 1, U, 0 },
+	{ 5, 0, M, 150 },
+	{ 6, 0, M, 160 },
+	{ 7, 0, M, 170 },
+	{ 8, 0, M, 180 },
+	{ 9, 0, U, 0 },
+};
+
+/*
+ * Through dejitter, two fingers close enough to be averaged together
+ * are each smoothed with their own history, and id 1 lifting and coming
+ * down again starts over while id 0 goes on with its own.
+ */
+static const struct mt_in smooth_in[] = {
+	{ 1, 100, 100, 50 }, { 1, 150, 100, 50 },
+	{ 2, 110, 100, 50 }, { 2, 160, 100, 50 },
+	{ 3, 120, 100, 50 }, { 3, 170, 100, 50 },
+	{ 4, 130, 100, 50 },
+	{ 5, 140, 100, 50 }, { 5, 180, 100, 50 },
+	{ 6, 150, 100, 50 }, { 6, 190, 100, 50 },
+	{ 7, 0, 0, 0 },
+};
+
+static const struct mt_out smooth_out[] = {
+	{ 1, 0, D, 100 }, { 1, 1, D, 150 },
+	{ 2, 0, M, 106 }, { 2, 1, M, 156 },
+	{ 3, 0, M, 113 }, { 3, 1, M, 163 },
+	{ 4, 1, U, 0 }, { 4, 0, M, 118 },
+	{ 5, 0, M, 128 }, { 5, 1, D, 180 },
+	{ 6, 0, M, 138 }, { 6, 1, M, 186 },
+	{ 7, 0, U, 0 }, { 7, 1, U, 0 },
+};
+
+/*
+ * Without ids only the last contact to lift is a release: what
+ * ts_read() hands out of come_go_in has one, at the end.
+ */
+static int mt_release(void)
+{
+	static const char *const chain[] = { "track", "", NULL };
+	struct ts_sample samp[MT_MAX], got[MT_MAX];
+	struct tsdev *ts;
+	int n = 0, k, ret, ups = 0;
+
+	ts = mt_open(come_go_in, NR(come_go_in), samp, chain);
+	if (!ts)
+		return 1;
+	while (n < MT_MAX) {
+		ret = ts_read(ts, got + n, 4);
+		if (ret <= 0)
+			break;
+		n += ret;
+	}
+	ts_close(ts);
+
+	for (k = 0; k < n; k++)
+		ups += !got[k].pressure;
+	ret = n != 9 || ups != 1 || got[n - 1].pressure;
+	printf("%-24s %d samples, %d release%s\n", "track release",
+	       n, ups, ret ? ", wrong" : " at the end");
+	return ret;
+}
+
+int main(void)
+{
+	static const char *const greedy[] = { "track", "greedy=3", NULL };
+	static const char *const hungarian[] = { "track", "greedy=0", NULL };
+	static const char *const wide[] = { "track", "gate=1000", NULL };
+	static const char *const variance[] = { "track", "", "variance", "delta=30",
+						NULL };
+	static const char *const dejitter[] = { "track", "", "dejitter", "delta=100",
+						NULL };
+	struct ts_sample samp[MT_MAX];
+	struct tsdev *ts;
+	int failed = 0;
+
+	/* 77 tells automake to skip, for builds without the module */
+	ts = mt_open(jump_in, NR(jump_in), samp, greedy);
+	if (!ts) {
+		printf("track skipped, the module is not there\n");
+		return 77;
+	}
+	ts_close(ts);
+
+	failed += mt_check("track cross greedy", cross_in, NR(cross_in),
+			   greedy, MT_MAX, cross_out, NR(cross_out));
+	failed += mt_check("track cross hungarian", cross_in, NR(cross_in),
+			   hungarian, MT_MAX, cross_out, NR(cross_out));
+	failed += mt_check("track shift greedy", shift_in, NR(shift_in),
+			   greedy, MT_MAX, shift_greedy_out,
+			   NR(shift_greedy_out));
+	failed += mt_check("track shift hungarian", shift_in, NR(shift_in),
+			   hungarian, MT_MAX, shift_hungarian_out,
+			   NR(shift_hungarian_out));
+	failed += mt_check("track gate", jump_in, NR(jump_in),
+			   greedy, MT_MAX, jump_gate_out, NR(jump_gate_out));
+	failed += mt_check("track wide gate", jump_in, NR(jump_in),
+			   wide, MT_MAX, jump_wide_out, NR(jump_wide_out));
+	failed += mt_check("track come and go", come_go_in, NR(come_go_in),
+			   greedy, 1, come_go_out, NR(come_go_out));
+	failed += mt_release();
+	failed += mt_check("variance id reused", reuse_in, NR(reuse_in),
+			   variance, MT_MAX, reuse_out, NR(reuse_out));
+	failed += mt_check("variance id reused by 1", reuse_in, NR(reuse_in),
+			   variance, 1, reuse_out, NR(reuse_out));
+	failed += mt_check("variance lift", lift_in, NR(lift_in),
+			   variance, MT_MAX, lift_out, NR(lift_out));
+	failed += mt_check("dejitter two contacts", smooth_in, NR(smooth_in),
+			   dejitter, MT_MAX, smooth_out, NR(smooth_out));
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/*
+ *  tslib/tests/ts_power.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Runs the power module over a source that takes a scan rate and
+ * idling, and checks that it is set to the full rate on the first
+ * read, to the idle rate and then asleep as it is left untouched, and
+ * back to the full rate on a touch, with the wakeups and the wake
+ * counted in the stats.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tslib-private.h"
+#include "emulate.h"
+
+#define PW_RATE		120
+#define PW_IDLE_RATE	20
+#define PW_IDLE_MS	50
+#define PW_SLEEP_MS	150
+
+static const char *const pw_what[] = {
+	"pressed", "released", "idle", "asleep", "touched", "awake",
+};
+
+int main(void)
+{
+	static const struct ts_sample samp[] = {
+		{ 100, 100, 50 }, { 0, 0, 0 }, { 0, 0, 0 },
+		{ 0, 0, 0 }, { 110, 100, 50 }, { 110, 100, 50 },
+	};
+	/* before each read, ms to wait, then the rate and idling after it */
+	static const int want[][3] = {
+		{ 0, PW_RATE, 0 },
+		{ 0, PW_RATE, 0 },
+		{ PW_IDLE_MS + 30, PW_IDLE_RATE, 0 },
+		{ PW_SLEEP_MS - PW_IDLE_MS, PW_IDLE_RATE, 1 },
+		{ 0, PW_RATE, 0 },
+		{ 5, PW_RATE, 0 },
+	};
+	struct ts_sample got;
+	struct ts_stats stats;
+	struct tsdev *ts;
+	char params[64];
+	int k, rate, idle, ret = 0;
+
+	ts = emu_source(samp, sizeof(samp) / sizeof(samp[0]), 0);
+	if (!ts)
+		return 1;
+	snprintf(params, sizeof(params), "rate=%d idle_rate=%d idle=%d sleep=%d",
+		 PW_RATE, PW_IDLE_RATE, PW_IDLE_MS, PW_SLEEP_MS);
+	/* 77 tells automake to skip, for builds without the module */
+	if (ts_load_module(ts, "power", params)) {
+		printf("power     skipped, the module is not there\n");
+		ts_close(ts);
+		return 77;
+	}
+
+	for (k = 0; k < (int)(sizeof(want) / sizeof(want[0])) && !ret; k++) {
+		usleep(want[k][0] * 1000);
+		if (ts_read(ts, &got, 1) != 1) {
+			printf("power     read %d failed\n", k);
+			ret = 1;
+			break;
+		}
+		emu_source_power(ts, &rate, &idle);
+		ret = rate != want[k][1] || idle != want[k][2];
+		printf("power     %-8s at %3d Hz%s%s\n", pw_what[k], rate,
+		       idle ? ", asleep" : "", ret ? ", wrong" : "");
+	}
+
+	if (!ret) {
+		ts_get_stats(ts, &stats);
+		ret = stats.wakeups != 6 || stats.wakes != 1 ||
+		      stats.wake_ns < 5000000 || stats.wake_ns_max != stats.wake_ns ||
+		      stats.wakeup_ns < (PW_SLEEP_MS + 30) * 1000000ULL;
+		printf("power     %lu wakeups in %llu ms, %lu wake of %lu ms%s\n",
+		       stats.wakeups, stats.wakeup_ns / 1000000, stats.wakes,
+		       stats.wake_ns / 1000000, ret ? ", wrong" : "");
+	}
+	ts_close(ts);
+	return ret;
+}
@@ -0,0 +1,188 @@
+/*
+ *  tslib/tests/ts_reactor.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Runs two emulated touchscreens through one reactor, and checks that
+ * the samples come out tagged with the device they came from and in
+ * its order, that ts_reactor_read() hands out no more than asked for
+ * and carries the rest over, and that a device whose feed closes is
+ * dropped without stopping the other, and given back by
+ * ts_reactor_remove().
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tslib-private.h"
+#include "emulate.h"
+
+#define RE_BATCH	4
+#define RE_MAX		32
+
+/* nr samples on d's feed, x from x0 on */
+static int re_feed(struct emu_dev *d, int x0, int nr)
+{
+	struct ts_sample s;
+	unsigned char buf[256];
+	int k, len;
+
+	for (k = 0; k < nr; k++) {
+		memset(&s, 0, sizeof(s));
+		s.x = x0 + k;
+		s.y = 100;
+		s.pressure = 50;
+		len = d->proto->encode(d, &s, buf);
+		if (write(d->feed, buf, len) != len) {
+			perror("write");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Reads up to nr, RE_BATCH at a time, until a read comes back empty */
+static int re_read(struct ts_reactor *r, struct ts_reactor_sample *rs,
+		   int nr, int *first)
+{
+	int n = 0, ret;
+
+	*first = -1;
+	while (n < nr) {
+		ret = ts_reactor_read(r, rs + n, nr - n < RE_BATCH ?
+				      nr - n : RE_BATCH, 200);
+		if (ret < 0) {
+			perror("ts_reactor_read");
+			return -1;
+		}
+		if (*first < 0)
+			*first = ret;
+		if (!ret || ret > RE_BATCH)
+			return ret ? -1 : n;
+		n += ret;
+	}
+	return n;
+}
+
+/*
+ * Each sample is tagged with the device whose x range it is in, and
+ * comes after the one before it from that device.
+ */
+static int re_check(const struct ts_reactor_sample *rs, int n,
+		    const int *idx, const int *x0, int *count)
+{
+	int next[2], k, i;
+
+	for (i = 0; i < 2; i++) {
+		next[i] = x0[i];
+		count[i] = 0;
+	}
+	for (k = 0; k < n; k++) {
+		for (i = 0; i < 2; i++)
+			if (rs[k].index == idx[i])
+				break;
+		if (i == 2 || rs[k].samp.x != next[i]) {
+			printf("reactor   sample %d at %d tagged %d, want %d from %d or %d from %d\n",
+			       k, rs[k].samp.x, rs[k].index, next[0], idx[0],
+			       next[1], idx[1]);
+			return 1;
+		}
+		next[i]++;
+		count[i]++;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	const struct emu_proto *proto = emu_find("input");
+	static const int x0[2] = { 100, 200 }, more = 300;
+	struct ts_reactor_sample rs[RE_MAX];
+	struct emu_dev *d[2] = { NULL, NULL };
+	struct ts_reactor *r = NULL;
+	int idx[2], count[2], n, first, k, ret = 1;
+
+	/* 77 tells automake to skip, for builds without the module */
+	if (!proto)
+		return 77;
+	for (k = 0; k < 2; k++) {
+		d[k] = emu_open(proto, NULL);
+		if (!d[k]) {
+			printf("reactor   skipped, the module is not there\n");
+			ret = 77;
+			goto out;
+		}
+	}
+
+	r = ts_reactor_new();
+	if (!r) {
+		perror("ts_reactor_new");
+		goto out;
+	}
+	for (k = 0; k < 2; k++) {
+		idx[k] = ts_reactor_add(r, d[k]->ts);
+		if (idx[k] != k) {
+			printf("reactor   device %d added as %d\n", k, idx[k]);
+			goto out;
+		}
+	}
+
+	/* more than a batch from one, less from the other */
+	if (re_feed(d[0], x0[0], 6) || re_feed(d[1], x0[1], 3))
+		goto out;
+	n = re_read(r, rs, RE_MAX, &first);
+	if (n < 0 || re_check(rs, n, idx, x0, count))
+		goto out;
+	if (first != RE_BATCH || count[0] != 6 || count[1] != 3) {
+		printf("reactor   first read %d, %d and %d samples, want %d, 6 and 3\n",
+		       first, count[0], count[1], RE_BATCH);
+		goto out;
+	}
+	printf("reactor   2 devices, 9 samples tagged and in order, %d a read\n",
+	       RE_BATCH);
+
+	/* the first one goes away, the second goes on */
+	close(d[0]->feed);
+	d[0]->feed = -1;
+	if (re_feed(d[1], more, 2))
+		goto out;
+	n = re_read(r, rs, RE_MAX, &first);
+	if (n != 2 || rs[0].index != idx[1] || rs[0].samp.x != more ||
+	    rs[1].index != idx[1] || rs[1].samp.x != more + 1) {
+		printf("reactor   %d samples after a feed closed, want 2 from %d\n",
+		       n, idx[1]);
+		goto out;
+	}
+	/* dropped, so it is no longer reported */
+	n = ts_reactor_read(r, rs, RE_MAX, 0);
+	if (n != 0) {
+		printf("reactor   %d samples from a closed feed\n", n);
+		goto out;
+	}
+
+	if (ts_reactor_remove(r, idx[0]) != d[0]->ts ||
+	    ts_reactor_remove(r, idx[0]) != NULL ||
+	    ts_reactor_remove(r, idx[1]) != d[1]->ts) {
+		printf("reactor   the devices were not given back\n");
+		goto out;
+	}
+	printf("reactor   a closed feed dropped, the other read on, both given back\n");
+	ret = 0;
+
+out:
+	if (r) {
+		/* emu_close() closes them */
+		for (k = 0; k < 2; k++)
+			ts_reactor_remove(r, k);
+		ts_reactor_free(r);
+	}
+	for (k = 0; k < 2; k++)
+		if (d[k])
+			emu_close(d[k]);
+	return ret;
+}
@@ -0,0 +1,412 @@
+/*
+ *  tslib/tests/ts_replay.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Replays the recorded traces of a directory through each of the
+ * filter chains there, and checks that the samples coming out are
+ * still those kept in the golden files, and that no chain became much
+ * slower than when it was first timed on this machine.  With -r, it
+ * records a new trace from the touchscreen instead.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <glob.h>
+#include <time.h>
+
+#include "tslib.h"
+#include "emulate.h"
+
+#define REPLAY_BATCH	16		/* samples asked for with one ts_read() */
+#define REPLAY_PERF	200000		/* samples timed in a run */
+#define REPLAY_RUNS	5		/* of which the fastest counts */
+#define REPLAY_FLOOR	0.5		/* of the baseline throughput */
+
+static const char *trace_dir;
+static const char *baseline;
+static double perf_floor = REPLAY_FLOOR;
+static int update;
+
+/* The name of path, without its directory and extension */
+static char *replay_name(const char *path)
+{
+	const char *base = strrchr(path, '/');
+	const char *dot;
+	char *s;
+
+	base = base ? base + 1 : path;
+	s = strdup(base);
+	if (!s) {
+		perror("strdup");
+		exit(1);
+	}
+	dot = strrchr(s, '.');
+	if (dot)
+		s[dot - s] = '\0';
+	return s;
+}
+
+static struct tsdev *replay_open(const char *conf, const struct ts_sample *samp,
+				 int nr, long period)
+{
+	struct tsdev *ts;
+
+	ts = emu_source(samp, nr, period);
+	if (!ts)
+		return NULL;
+	setenv("TSLIB_CONFFILE", conf, 1);
+	if (ts_config(ts)) {
+		ts_close(ts);
+		return NULL;
+	}
+	return ts;
+}
+
+/* Returns the number of samples the chain handed out, or -1 */
+static int replay_chain(struct tsdev *ts, int nr, struct ts_sample *out, int max)
+{
+	int n = 0, ret;
+
+	while (n < max) {
+		ret = ts_read(ts, out + n,
+			      max - n < REPLAY_BATCH ? max - n : REPLAY_BATCH);
+		if (ret < 0)
+			return -1;
+		n += ret;
+		/* a filter may hand out nothing while it still has input */
+		if (!ret && emu_source_count(ts) == nr)
+			break;
+	}
+	return n;
+}
+
+static void replay_line(char *buf, int len, const struct ts_sample *s)
+{
+	snprintf(buf, len, "%ld.%06ld: %6d %6d %6d\n", (long)s->tv.tv_sec,
+		 (long)s->tv.tv_usec, s->x, s->y, s->pressure);
+}
+
+/* Returns 0 if out is what golden has, or it was written with -u */
+static int replay_golden(const char *golden, const struct ts_sample *out, int n)
+{
+	char want[128], got[128];
+	FILE *f;
+	int k;
+
+	f = fopen(golden, update ? "w" : "r");
+	if (!f) {
+		perror(golden);
+		return 1;
+	}
+	for (k = 0; k < n; k++) {
+		replay_line(got, sizeof(got), &out[k]);
+		if (update) {
+			fputs(got, f);
+			continue;
+		}
+		if (!fgets(want, sizeof(want), f) || strcmp(want, got)) {
+			printf("%s:%d: got %s", golden, k + 1, got);
+			fclose(f);
+			return 1;
+		}
+	}
+	if (!update && fgets(want, sizeof(want), f)) {
+		printf("%s:%d: missing %s", golden, k + 1, want);
+		fclose(f);
+		return 1;
+	}
+	if (fclose(f)) {
+		perror(golden);
+		return 1;
+	}
+	return 0;
+}
+
+/* The fewest ns a sample took the chain, looping over samp */
+static double replay_perf(const char *conf, const struct ts_sample *samp, int nr)
+{
+	struct ts_sample out[REPLAY_BATCH];
+	struct timespec t0, t1;
+	struct tsdev *ts;
+	double ns, best = 0;
+	long period = 1;
+	int run;
+
+	if (nr > 1)
+		period = ((samp[nr - 1].tv.tv_sec - samp[0].tv.tv_sec) * 1000000 +
+			  samp[nr - 1].tv.tv_usec - samp[0].tv.tv_usec) / (nr - 1);
+	if (period < 1)
+		period = 1;
+
+	for (run = 0; run < REPLAY_RUNS; run++) {
+		ts = replay_open(conf, samp, nr, period);
+		if (!ts)
+			return -1;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+		while (emu_source_count(ts) < REPLAY_PERF)
+			if (ts_read(ts, out, REPLAY_BATCH) < 0)
+				break;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+		ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + t1.tv_nsec - t0.tv_nsec) /
+		     emu_source_count(ts);
+		ts_close(ts);
+		if (!run || ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+/*
+ * Compares with the baseline of trace and chain, or makes ns the
+ * baseline if there is none yet.  Returns 1 if below the floor, 77 if
+ * there was nothing to compare with.
+ */
+static int replay_baseline(const char *trace, const char *chain, double ns)
+{
+	char t[64], c[64];
+	double v, base = 0;
+	FILE *f;
+
+	f = fopen(baseline, "r");
+	if (f) {
+		while (fscanf(f, "%63s %63s %lf", t, c, &v) == 3) {
+			if (!strcmp(t, trace) && !strcmp(c, chain)) {
+				base = v;
+				break;
+			}
+		}
+		fclose(f);
+	}
+
+	if (base <= 0) {
+		f = fopen(baseline, "a");
+		if (!f) {
+			perror(baseline);
+			return 1;
+		}
+		fprintf(f, "%s %s %.2f\n", trace, chain, ns);
+		fclose(f);
+		printf(", baseline now\n");
+		return 77;
+	}
+
+	printf(", baseline %.1f\n", base);
+	if (ns > base / perf_floor) {
+		printf("%s through %s: %.0f samples/s is below %.0f%% of the %.0f samples/s of the baseline\n",
+		       trace, chain, 1e9 / ns, perf_floor * 100, 1e9 / base);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Returns 0 if all went as it should, 1 if not, 77 if skipped, 78 if
+ * the output was right but there was no baseline yet.
+ */
+static int replay(const char *trace, const char *conf)
+{
+	struct ts_sample *samp, *out;
+	char *golden, *t, *c;
+	struct tsdev *ts;
+	double ns;
+	int nr, n, ret = 1;
+
+	nr = emu_trace(trace, &samp);
+	if (nr < 1)
+		return 1;
+	t = replay_name(trace);
+	c = replay_name(conf);
+	golden = malloc(strlen(trace_dir) + strlen(t) + strlen(c) + sizeof("/-.golden"));
+	out = malloc(2 * nr * sizeof(struct ts_sample));
+	if (!golden || !out) {
+		perror("malloc");
+		exit(1);
+	}
+	sprintf(golden, "%s/%s-%s.golden", trace_dir, t, c);
+
+	ts = replay_open(conf, samp, nr, 0);
+	if (!ts) {
+		printf("%-8s %-8s skipped, the modules are not there\n", t, c);
+		ret = 77;
+		goto out;
+	}
+	n = replay_chain(ts, nr, out, 2 * nr);
+	ts_close(ts);
+	if (n < 0) {
+		printf("%-8s %-8s read failed\n", t, c);
+		goto out;
+	}
+	if (replay_golden(golden, out, n))
+		goto out;
+
+	ns = replay_perf(conf, samp, nr);
+	printf("%-8s %-8s %6d in %6d out, %s, %.1f ns/sample", t, c, nr, n,
+	       update ? "written" : "as golden", ns);
+	ret = replay_baseline(t, c, ns);
+	if (ret == 77)
+		ret = 78;
+
+out:
+	free(t);
+	free(c);
+	free(golden);
+	free(out);
+	free(samp);
+	return ret;
+}
+
+static volatile sig_atomic_t stop;
+
+static void record_stop(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+/* Raw samples of the configured touchscreen, until nr or ^C */
+static int record(const char *path, int nr)
+{
+	struct ts_sample *samp;
+	struct sigaction sa;
+	struct tsdev *ts;
+	int n = 0, ret;
+
+	samp = malloc(nr * sizeof(struct ts_sample));
+	if (!samp) {
+		perror("malloc");
+		return 1;
+	}
+	ts = ts_open_config(0, 0, 0);
+	if (!ts) {
+		perror("ts_open_config");
+		free(samp);
+		return 1;
+	}
+
+	/* without SA_RESTART, so that ^C ends a read waiting for a touch */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = record_stop;
+	sigaction(SIGINT, &sa, NULL);
+	while (n < nr && !stop) {
+		ret = ts_read_raw(ts, samp + n, 1);
+		if (ret < 0)
+			break;
+		n += ret;
+	}
+	ts_close(ts);
+
+	ret = emu_trace_write(path, samp, n);
+	if (!ret)
+		printf("%d samples in %s\n", n, path);
+	free(samp);
+	return ret ? 1 : 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-d dir] [-u] [-b baseline] [-f floor]\n"
+		"       %s -r trace [-n samples]\n"
+		"\t-d\ttraces, chains and calibration, or $TSLIB_TRACEDIR\n"
+		"\t-u\twrite the golden files instead of checking them\n"
+		"\t-b\tthe baseline file, or $TSLIB_PERF_BASELINE\n"
+		"\t-f\tthe part of the baseline throughput to keep, %.2f\n"
+		"\t-r\trecord a trace from the touchscreen\n",
+		name, name, REPLAY_FLOOR);
+}
+
+int main(int argc, char **argv)
+{
+	const char *rec = NULL;
+	glob_t traces, chains;
+	char *path;
+	int nr = 100000;
+	int c, i, j, ret, ran = 0, failed = 0, unchecked = 0;
+
+	trace_dir = getenv("TSLIB_TRACEDIR");
+	if (!trace_dir)
+		trace_dir = "traces";
+	baseline = getenv("TSLIB_PERF_BASELINE");
+	if (!baseline)
+		baseline = "perf-baseline";
+
+	while ((c = getopt(argc, argv, "d:ub:f:r:n:")) != -1) {
+		switch (c) {
+		case 'd':
+			trace_dir = optarg;
+			break;
+		case 'u':
+			update = 1;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		case 'f':
+			perf_floor = atof(optarg);
+			break;
+		case 'r':
+			rec = optarg;
+			break;
+		case 'n':
+			nr = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (perf_floor <= 0 || perf_floor > 1 || nr < 1) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (rec)
+		return record(rec, nr);
+
+	path = malloc(strlen(trace_dir) + sizeof("/pointercal"));
+	if (!path) {
+		perror("malloc");
+		return 1;
+	}
+	sprintf(path, "%s/pointercal", trace_dir);
+	setenv("TSLIB_CALIBFILE", path, 1);
+	sprintf(path, "%s/*.trace", trace_dir);
+	glob(path, 0, NULL, &traces);
+	sprintf(path, "%s/*.conf", trace_dir);
+	glob(path, 0, NULL, &chains);
+
+	for (i = 0; i < (int)traces.gl_pathc; i++) {
+		for (j = 0; j < (int)chains.gl_pathc; j++) {
+			ret = replay(traces.gl_pathv[i], chains.gl_pathv[j]);
+			if (ret == 77)
+				continue;
+			ran++;
+			if (ret == 78)
+				unchecked++;
+			else
+				failed += ret;
+		}
+	}
+	globfree(&traces);
+	globfree(&chains);
+	free(path);
+
+	/* 77 tells automake to skip, for builds without the filters */
+	if (!ran)
+		return 77;
+	if (failed)
+		return 1;
+	/* the floor was not enforced, which should not pass unseen */
+	if (unchecked) {
+		printf("%d of %d chains had no baseline in %s, their throughput was not checked\n",
+		       unchecked, ran, baseline);
+		return 77;
+	}
+	return 0;
+}
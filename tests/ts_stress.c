@@ -0,0 +1,307 @@
+/*
+ *  tslib/tests/ts_stress.c
+ *
+ * This file is placed under the GPL.  Please see the file
+ * COPYING for more details.
+ *
+ *
+ * Open, configure, read and close many touchscreens at once, two per
+ * thread, each fed through a pipe with its own pattern of presses.
+ * Every thread checks that what comes out of its filter chain is what
+ * its own input should give, which fails if any library or module
+ * state is shared between devices.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+#include "tslib.h"
+
+/* what the corgi module reads */
+struct corgi_ts_event {
+	short pressure;
+	short x;
+	short y;
+	short millisecs;
+};
+
+#define STRESS_PMAX	1000
+
+static const char stress_conf[] =
+	"module_raw corgi\n"
+	"module pthres pmin=1 pmax=1000\n";
+
+static int nthreads = 8;
+static int rounds = 50;
+static int events = 256;
+static pthread_barrier_t start;
+
+/*
+ * Presses move diagonally from a corner of their own, every fifth
+ * event is a release and every seventh is too hard and dropped.
+ */
+static void make_event(int id, int n, struct corgi_ts_event *ev)
+{
+	ev->x = id * 64 + n % 64;
+	ev->y = id * 64 + n % 64 + 1;
+	ev->millisecs = n;
+	if (n % 5 == 4)
+		ev->pressure = 0;
+	else if (n % 7 == 6)
+		ev->pressure = STRESS_PMAX + 1;
+	else
+		ev->pressure = 100 + id;
+}
+
+/* what pthres should make of them; returns the number of samples */
+static int expect(int id, struct ts_sample *out)
+{
+	struct corgi_ts_event ev;
+	int x = 0, y = 0, press = 0;
+	int n, nr = 0;
+
+	for (n = 0; n < events; n++) {
+		make_event(id, n, &ev);
+		if (ev.pressure < 1) {
+			if (!press)
+				continue;
+			press = 0;
+			out[nr].x = x;
+			out[nr].y = y;
+			out[nr].pressure = 0;
+		} else if (ev.pressure > STRESS_PMAX) {
+			continue;
+		} else {
+			press = 1;
+			x = out[nr].x = ev.x;
+			y = out[nr].y = ev.y;
+			out[nr].pressure = ev.pressure;
+		}
+		nr++;
+	}
+	return nr;
+}
+
+struct stress_dev {
+	int id;
+	int fds[2];
+	struct tsdev *ts;
+	struct ts_sample *want;
+	int nwant;
+	struct ts_sample *got;
+	int nr;
+	int empty;		/* reads in a row that gave nothing */
+};
+
+static int stress_open(struct stress_dev *d)
+{
+	struct corgi_ts_event ev[events];
+	int n;
+
+	d->nr = 0;
+	d->empty = 0;
+	if (pipe(d->fds)) {
+		perror("pipe");
+		return -1;
+	}
+	d->ts = ts_open_fd(d->fds[0]);
+	if (!d->ts) {
+		close(d->fds[0]);
+		close(d->fds[1]);
+		return -1;
+	}
+
+	for (n = 0; n < events; n++)
+		make_event(d->id, n, &ev[n]);
+	n = write(d->fds[1], ev, sizeof(ev));
+	close(d->fds[1]);
+	if (n != (int)sizeof(ev)) {
+		perror("write");
+		return -1;
+	}
+	return ts_config(d->ts);
+}
+
+/*
+ * A few samples at a time, so that filters have to carry their state
+ * from one call to the next while the other device is read.
+ */
+static int stress_read(struct stress_dev *d)
+{
+	int n, left = 0;
+
+	if (d->nr == d->nwant)
+		return 0;
+	n = d->nwant - d->nr < 3 ? d->nwant - d->nr : 1 + d->nr % 3;
+	/*
+	 * pthres may drop everything it was given.  Each such read takes
+	 * at least one record, so once the pipe is empty and more reads
+	 * than records gave nothing, nothing more comes.
+	 */
+	n = ts_read(d->ts, d->got + d->nr, n);
+	d->empty = n ? 0 : d->empty + 1;
+	if (d->empty > events &&
+	    (ioctl(ts_fd(d->ts), FIONREAD, &left) || !left))
+		n = -1;
+	if (n < 0) {
+		fprintf(stderr, "device %d: %d of %d samples\n",
+			d->id, d->nr, d->nwant);
+		return -1;
+	}
+	d->nr += n;
+	return 0;
+}
+
+static int stress_check(struct stress_dev *d)
+{
+	const struct ts_sample *got = d->got, *want = d->want;
+	int n;
+
+	for (n = 0; n < d->nwant; n++) {
+		if (got[n].x != want[n].x || got[n].y != want[n].y ||
+		    got[n].pressure != want[n].pressure) {
+			fprintf(stderr,
+				"device %d: sample %d is %d,%d,%u, not %d,%d,%u\n",
+				d->id, n, got[n].x, got[n].y, got[n].pressure,
+				want[n].x, want[n].y, want[n].pressure);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* each thread drives two devices, alternating between them */
+static void *stress_thread(void *arg)
+{
+	struct ts_sample want[2][events], got[2][events];
+	struct stress_dev dev[2];
+	int id = (long)arg;
+	int k, r, ret = 0;
+
+	for (k = 0; k < 2; k++) {
+		dev[k].id = 2 * id + k;
+		dev[k].want = want[k];
+		dev[k].got = got[k];
+		dev[k].nwant = expect(dev[k].id, want[k]);
+	}
+
+	pthread_barrier_wait(&start);
+	for (r = 0; r < rounds && !ret; r++) {
+		for (k = 0; k < 2; k++)
+			dev[k].ts = NULL;
+		for (k = 0; k < 2 && !ret; k++)
+			ret = stress_open(&dev[k]);
+		while (!ret && (dev[0].nr < dev[0].nwant ||
+				dev[1].nr < dev[1].nwant))
+			ret = stress_read(&dev[0]) || stress_read(&dev[1]);
+		for (k = 0; k < 2 && !ret; k++)
+			ret = stress_check(&dev[k]);
+		for (k = 0; k < 2; k++)
+			if (dev[k].ts)
+				ts_close(dev[k].ts);
+	}
+	return ret ? (void *)1 : NULL;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-r rounds] [-n events]\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	char conf[] = "/tmp/ts_stress.XXXXXX";
+	pthread_t *threads;
+	struct tsdev *ts;
+	int fds[2];
+	int c, fd, i, failed = 0;
+
+	while ((c = getopt(argc, argv, "t:r:n:")) != -1) {
+		switch (c) {
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'n':
+			events = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	/* all of a round has to fit in the pipe */
+	if (nthreads < 1 || nthreads > 256 || rounds < 1 || events < 1 || events > 4096) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	fd = mkstemp(conf);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	if (write(fd, stress_conf, strlen(stress_conf)) !=
+	    (ssize_t)strlen(stress_conf)) {
+		perror("write");
+		close(fd);
+		unlink(conf);
+		return 1;
+	}
+	close(fd);
+	setenv("TSLIB_CONFFILE", conf, 1);
+
+	/* 77 tells automake to skip, for builds without these modules */
+	if (pipe(fds)) {
+		perror("pipe");
+		unlink(conf);
+		return 1;
+	}
+	close(fds[1]);
+	ts = ts_open_fd(fds[0]);
+	if (!ts || ts_config(ts)) {
+		fprintf(stderr, "corgi and pthres modules are needed\n");
+		if (ts)
+			ts_close(ts);
+		unlink(conf);
+		return 77;
+	}
+	ts_close(ts);
+
+	threads = calloc(nthreads, sizeof(pthread_t));
+	if (!threads) {
+		unlink(conf);
+		return 1;
+	}
+	pthread_barrier_init(&start, NULL, nthreads);
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, stress_thread,
+				   (void *)(long)i)) {
+			fprintf(stderr, "cannot start thread %d\n", i);
+			exit(1);
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		void *ret;
+
+		pthread_join(threads[i], &ret);
+		if (ret)
+			failed++;
+	}
+	pthread_barrier_destroy(&start);
+	free(threads);
+	unlink(conf);
+
+	printf("%d threads, %d rounds of %d events on 2 devices: %d failed\n",
+	       nthreads, rounds, events, failed);
+	return failed ? 1 : 0;
+}